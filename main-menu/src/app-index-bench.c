@@ -0,0 +1,247 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "app-index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Runs app_index_lookup () over N_ENTRIES synthetic applications, for keys of
+ * one byte, two bytes and three or more, which take different paths through
+ * the index.  Fails if a lookup answers differently from a scan of all the
+ * entries.  The mean time per query is printed, and only fails the run if
+ * BUDGET_ENV_VAR is set to a budget in microseconds, since wall-clock times
+ * mean little on a loaded or emulated builder.
+ */
+
+#define N_ENTRIES      5000
+#define N_ROUNDS       200
+#define BUDGET_ENV_VAR "APP_INDEX_BENCH_BUDGET_USEC"
+
+static const gchar *syllables [] = {
+	"ka", "lo", "mi", "ne", "ru", "sa", "te", "vo", "xi", "ba",
+	"do", "fe", "gu", "hi", "jo", "pa", "qi", "wu", "ze", "yo"
+};
+
+static const gchar *kinds [] = {
+	"Editor", "Viewer", "Player", "Browser", "Manager", "Terminal", "Monitor", "Settings"
+};
+
+static const gchar *short_keys  [] = { "k", "m", "s", "v", "e", "p", "z", "q" };
+static const gchar *medium_keys [] = { "ka", "mi", "sa", "vo", "ed", "pl", "ze", "qi" };
+static const gchar *long_keys   [] = {
+	"kal", "mine", "sate", "editor", "lomi", "play", "xiba", "nowhere"
+};
+
+static AppIndexEntry *
+make_entry (guint n)
+{
+	AppIndexEntry *entry;
+	GString       *name;
+	gchar         *text;
+	guint          i;
+
+
+	entry = g_new0 (AppIndexEntry, 1);
+	name  = g_string_new (NULL);
+
+	for (i = 0; i < 3; ++i) {
+		g_string_append (name, syllables [n % G_N_ELEMENTS (syllables)]);
+		n /= G_N_ELEMENTS (syllables);
+	}
+
+	g_string_append_printf (name, " %u", n);
+
+	entry->uri = g_strdup_printf ("file:///usr/share/applications/%s.desktop", name->str);
+
+	entry->keys [APP_INDEX_FIELD_NAME] = app_index_get_key (name->str);
+	entry->keys [APP_INDEX_FIELD_GENERIC_NAME] = app_index_get_key (
+		kinds [g_str_hash (name->str) % G_N_ELEMENTS (kinds)]);
+
+	text = g_strdup_printf ("%s tool utility", name->str);
+	entry->keys [APP_INDEX_FIELD_KEYWORDS] = app_index_get_key (text);
+	g_free (text);
+
+	entry->keys [APP_INDEX_FIELD_EXEC] = g_strdelimit (g_ascii_strdown (name->str, -1), " ", '-');
+
+	g_string_free (name, TRUE);
+
+	return entry;
+}
+
+/* Returns whether key starts a word of field, the way the index splits them */
+static gboolean
+starts_word (const gchar *field, const gchar *key)
+{
+	gsize len = strlen (key);
+	gsize i;
+
+
+	for (i = 0; field [i]; ++i) {
+		if (i > 0 && ((guchar) field [i - 1] >= 0x80 || g_ascii_isalnum (field [i - 1])))
+			continue;
+
+		if (! (g_ascii_isalnum (field [i]) || ((guchar) field [i] & 0xC0) == 0xC0))
+			continue;
+
+		if (! strncmp (field + i, key, len))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Returns whether the lookup of key gives what a scan of entries does, in
+ * entry order */
+static gboolean
+check_key (AppIndex *index, GPtrArray *entries, const gchar *key)
+{
+	GPtrArray     *matches;
+	GPtrArray     *expected;
+	AppIndexEntry *entry;
+	gboolean       same;
+	guint          i;
+	guint          j;
+
+
+	expected = g_ptr_array_new ();
+
+	for (i = 0; i < entries->len; ++i) {
+		entry = g_ptr_array_index (entries, i);
+
+		for (j = 0; j < APP_INDEX_N_FIELDS; ++j) {
+			if (! entry->keys [j])
+				continue;
+
+			if (strlen (key) < 3 ? starts_word (entry->keys [j], key) : strstr (entry->keys [j], key) != NULL) {
+				g_ptr_array_add (expected, entry);
+
+				break;
+			}
+		}
+	}
+
+	matches = app_index_lookup (index, key);
+
+	same = matches->len == expected->len &&
+		! memcmp (matches->pdata, expected->pdata, matches->len * sizeof (gpointer));
+
+	if (! same)
+		printf ("FAIL: [%s] gives %u matches, %u expected\n", key, matches->len, expected->len);
+
+	g_ptr_array_free (matches,  TRUE);
+	g_ptr_array_free (expected, TRUE);
+
+	return same;
+}
+
+/* Returns the mean time per query in microseconds */
+static gdouble
+time_keys (AppIndex *index, const gchar **keys, guint n_keys, const gchar *label)
+{
+	GPtrArray *matches;
+	gint64     start;
+	gint64     elapsed;
+	gint64     total   = 0;
+	gint64     longest = 0;
+	guint      n_found = 0;
+	guint      round;
+	guint      i;
+
+
+	for (round = 0; round < N_ROUNDS; ++round) {
+		for (i = 0; i < n_keys; ++i) {
+			start   = g_get_monotonic_time ();
+			matches = app_index_lookup (index, keys [i]);
+			elapsed = g_get_monotonic_time () - start;
+
+			total  += elapsed;
+			longest = MAX (longest, elapsed);
+
+			if (round == 0)
+				n_found += matches->len;
+
+			g_ptr_array_free (matches, TRUE);
+		}
+	}
+
+	printf (
+		"%-12s %8.1f us mean %8ld us max %6u matches per round\n", label,
+		(gdouble) total / (N_ROUNDS * n_keys), (glong) longest, n_found);
+
+	return (gdouble) total / (N_ROUNDS * n_keys);
+}
+
+int
+main (int argc, char **argv)
+{
+	AppIndex    *index;
+	GPtrArray   *entries;
+	GPtrArray   *order;
+	const gchar *budget;
+	gboolean     correct = TRUE;
+	gdouble      worst   = 0.0;
+	guint        i;
+
+
+	entries = g_ptr_array_sized_new (N_ENTRIES);
+
+	for (i = 0; i < N_ENTRIES; ++i)
+		g_ptr_array_add (entries, make_entry (i));
+
+	/* the index takes entries over, but keeps their order */
+	order = g_ptr_array_sized_new (N_ENTRIES);
+
+	for (i = 0; i < N_ENTRIES; ++i)
+		g_ptr_array_add (order, g_ptr_array_index (entries, i));
+
+	index = app_index_new_for_entries (entries);
+
+	for (i = 0; i < G_N_ELEMENTS (short_keys); ++i)
+		correct &= check_key (index, order, short_keys [i]);
+
+	for (i = 0; i < G_N_ELEMENTS (medium_keys); ++i)
+		correct &= check_key (index, order, medium_keys [i]);
+
+	for (i = 0; i < G_N_ELEMENTS (long_keys); ++i)
+		correct &= check_key (index, order, long_keys [i]);
+
+	g_ptr_array_free (order, TRUE);
+
+	printf ("%d entries, %d rounds\n", N_ENTRIES, N_ROUNDS);
+
+	worst = MAX (worst, time_keys (index, short_keys,  G_N_ELEMENTS (short_keys),  "1 byte"));
+	worst = MAX (worst, time_keys (index, medium_keys, G_N_ELEMENTS (medium_keys), "2 bytes"));
+	worst = MAX (worst, time_keys (index, long_keys,   G_N_ELEMENTS (long_keys),   "3+ bytes"));
+
+	g_object_unref (index);
+
+	if (! correct)
+		return 1;
+
+	if ((budget = g_getenv (BUDGET_ENV_VAR)) && worst >= atof (budget)) {
+		printf ("FAIL: %.1f us per query, budget %s us\n", worst, budget);
+
+		return 1;
+	}
+
+	return 0;
+}
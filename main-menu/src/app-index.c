@@ -0,0 +1,634 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#include "app-index.h"
+
+#include <string.h>
+#include <gio/gdesktopappinfo.h>
+
+#include "stall-watchdog.h"
+
+/* An in-memory index of the installed applications.  It is built by a worker
+ * thread from g_app_info_get_all () and rebuilt, again off the main loop,
+ * REBUILD_DELAY_SECONDS after anything changes in one of the XDG application
+ * directories or their subdirectories, which the builds find and the main loop
+ * then watches as well.  A finished build replaces the previous one as a whole, so the
+ * main loop only ever sees complete, immutable indices.
+ *
+ * Every field is casefolded once at build time, which turns matching into
+ * plain byte comparison: strstr () and memcmp () from the C library, which
+ * are vectorized, instead of a per-character case-insensitive compare.  Two
+ * kinds of postings narrow down the entries worth comparing: the one and two
+ * byte prefixes of every word, which answer short queries on their own, and
+ * the byte trigrams of every field, whose lists are intersected for longer
+ * queries before the survivors are checked with strstr ().
+ */
+
+#define REBUILD_DELAY_SECONDS 1
+#define MAX_SUBDIR_DEPTH      4
+
+#define PREFIX_KEY(len, s)   ((len) == 1 ? (0x01000000 | (guchar) (s) [0]) : \
+                              (0x02000000 | ((guchar) (s) [0] << 8) | (guchar) (s) [1]))
+#define TRIGRAM_KEY(s)       (((guchar) (s) [0] << 16) | ((guchar) (s) [1] << 8) | (guchar) (s) [2])
+
+G_DEFINE_TYPE (AppIndex, app_index, G_TYPE_OBJECT)
+
+typedef struct {
+	GPtrArray  *entries;
+	GHashTable *postings;
+} IndexData;
+
+typedef struct {
+	AppIndex  *index;
+	IndexData *data;
+	GPtrArray *subdirs;
+} BuildJob;
+
+typedef struct {
+	IndexData *data;
+
+	GList     *monitors;
+	guint      rebuild_id;
+	gboolean   building;
+	gboolean   stale;
+} AppIndexPrivate;
+
+enum {
+	CHANGED,
+	LAST_SIGNAL
+};
+
+static guint app_index_signals [LAST_SIGNAL] = { 0 };
+
+#define PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), APP_INDEX_TYPE, AppIndexPrivate))
+
+static void       app_index_finalize (GObject *);
+static void       monitor_app_dirs   (AppIndex *, GPtrArray *);
+static void       find_subdirs       (const gchar *, gint, GPtrArray *);
+static void       dir_changed_cb     (GFileMonitor *, GFile *, GFile *, GFileMonitorEvent, gpointer);
+static gboolean   rebuild_cb         (gpointer);
+static void       start_build        (AppIndex *);
+static gpointer   build_thread       (gpointer);
+static gboolean   build_done_cb      (gpointer);
+static IndexData *index_data_new     (void);
+static void       index_data_free    (IndexData *);
+static void       index_entry        (IndexData *, guint);
+static void       add_posting        (GHashTable *, guint, guint);
+static void       entry_free         (gpointer);
+
+static AppIndex *instance = NULL;
+
+AppIndex *
+app_index_get_instance (void)
+{
+	if (! instance) {
+		instance = g_object_new (APP_INDEX_TYPE, NULL);
+
+		monitor_app_dirs (instance, NULL);
+		start_build (instance);
+	}
+
+	return instance;
+}
+
+/* Returns an index over entries alone, which it takes over along with the
+ * array, that is neither built from the installed applications nor ever
+ * rebuilt.  For measuring lookups; entry->info may be NULL there.
+ */
+AppIndex *
+app_index_new_for_entries (GPtrArray *entries)
+{
+	AppIndex        *this;
+	AppIndexPrivate *priv;
+
+	guint i;
+
+
+	this = g_object_new (APP_INDEX_TYPE, NULL);
+	priv = PRIVATE (this);
+
+	priv->data = index_data_new ();
+
+	for (i = 0; i < entries->len; ++i) {
+		g_ptr_array_add (priv->data->entries, g_ptr_array_index (entries, i));
+		index_entry (priv->data, i);
+	}
+
+	g_ptr_array_free (entries, TRUE);
+
+	return this;
+}
+
+/* Brings str into the form the index stores its fields in */
+gchar *
+app_index_get_key (const gchar *str)
+{
+	gchar *normal;
+	gchar *key;
+
+
+	if (! str)
+		return NULL;
+
+	normal = g_utf8_normalize (str, -1, G_NORMALIZE_ALL);
+
+	if (! normal)
+		return NULL;
+
+	key = g_utf8_casefold (g_strstrip (normal), -1);
+	g_free (normal);
+
+	return key;
+}
+
+/* Returns the entries with a word starting with key, if key is shorter than
+ * three bytes, or else with key anywhere in one of their fields.  key must
+ * come from app_index_get_key ().  The entries belong to the index and stay
+ * valid until it next emits "changed"; free the array with
+ * g_ptr_array_free (array, TRUE).
+ */
+GPtrArray *
+app_index_lookup (AppIndex *this, const gchar *key)
+{
+	AppIndexPrivate *priv = PRIVATE (this);
+
+	GPtrArray     *matches;
+	GArray        *postings;
+	GArray        *shortest = NULL;
+	AppIndexEntry *entry;
+	gsize          len;
+
+	guint *cursors;
+	guint  id;
+	gint   n_trigrams;
+	gint   i;
+	gint   j;
+
+
+	matches = g_ptr_array_new ();
+
+	if (! (priv->data && key && key [0]))
+		return matches;
+
+	len = strlen (key);
+
+	if (len < 3) {
+		postings = g_hash_table_lookup (priv->data->postings, GUINT_TO_POINTER (PREFIX_KEY (len, key)));
+
+		for (i = 0; postings && i < postings->len; ++i)
+			g_ptr_array_add (matches, g_ptr_array_index (
+				priv->data->entries, g_array_index (postings, guint, i)));
+
+		return matches;
+	}
+
+	/* every trigram of key has to be present; walk the shortest list and
+	 * probe the others with a cursor each, as all lists are sorted */
+	n_trigrams = len - 2;
+
+	for (i = 0; i < n_trigrams; ++i) {
+		postings = g_hash_table_lookup (priv->data->postings, GUINT_TO_POINTER (TRIGRAM_KEY (key + i)));
+
+		if (! postings)
+			return matches;
+
+		if (! shortest || postings->len < shortest->len)
+			shortest = postings;
+	}
+
+	cursors = g_new0 (guint, n_trigrams);
+
+	for (i = 0; i < shortest->len; ++i) {
+		id = g_array_index (shortest, guint, i);
+
+		for (j = 0; j < n_trigrams; ++j) {
+			postings = g_hash_table_lookup (priv->data->postings, GUINT_TO_POINTER (TRIGRAM_KEY (key + j)));
+
+			while (cursors [j] < postings->len && g_array_index (postings, guint, cursors [j]) < id)
+				cursors [j]++;
+
+			if (cursors [j] == postings->len || g_array_index (postings, guint, cursors [j]) != id)
+				break;
+		}
+
+		if (j < n_trigrams)
+			continue;
+
+		/* the trigrams may come from different fields or places */
+		entry = g_ptr_array_index (priv->data->entries, id);
+
+		for (j = 0; j < APP_INDEX_N_FIELDS; ++j) {
+			if (entry->keys [j] && strstr (entry->keys [j], key)) {
+				g_ptr_array_add (matches, entry);
+
+				break;
+			}
+		}
+	}
+
+	g_free (cursors);
+
+	return matches;
+}
+
+static void
+app_index_class_init (AppIndexClass *this_class)
+{
+	GObjectClass *g_obj_class = G_OBJECT_CLASS (this_class);
+
+	g_obj_class->finalize = app_index_finalize;
+
+	app_index_signals [CHANGED] = g_signal_new (
+		"changed", G_TYPE_FROM_CLASS (this_class),
+		G_SIGNAL_RUN_LAST, G_STRUCT_OFFSET (AppIndexClass, changed),
+		NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+	g_type_class_add_private (this_class, sizeof (AppIndexPrivate));
+}
+
+static void
+app_index_init (AppIndex *this)
+{
+	AppIndexPrivate *priv = PRIVATE (this);
+
+	priv->data       = NULL;
+	priv->monitors   = NULL;
+	priv->rebuild_id = 0;
+	priv->building   = FALSE;
+	priv->stale      = FALSE;
+}
+
+static void
+app_index_finalize (GObject *g_obj)
+{
+	AppIndexPrivate *priv = PRIVATE (g_obj);
+
+	GList *node;
+
+
+	for (node = priv->monitors; node; node = node->next) {
+		g_file_monitor_cancel (G_FILE_MONITOR (node->data));
+		g_object_unref (node->data);
+	}
+
+	g_list_free (priv->monitors);
+
+	if (priv->rebuild_id)
+		g_source_remove (priv->rebuild_id);
+
+	if (priv->data)
+		index_data_free (priv->data);
+
+	G_OBJECT_CLASS (app_index_parent_class)->finalize (g_obj);
+}
+
+static void
+monitor_app_dirs (AppIndex *this, GPtrArray *subdirs)
+{
+	AppIndexPrivate *priv = PRIVATE (this);
+
+	const gchar * const *data_dirs;
+
+	GPtrArray    *paths;
+	GFileMonitor *monitor;
+	GFile        *dir;
+	GList        *node;
+
+	gint i;
+
+
+	for (node = priv->monitors; node; node = node->next) {
+		g_file_monitor_cancel (G_FILE_MONITOR (node->data));
+		g_object_unref (node->data);
+	}
+
+	g_list_free (priv->monitors);
+	priv->monitors = NULL;
+
+	paths     = g_ptr_array_new_with_free_func (g_free);
+	data_dirs = g_get_system_data_dirs ();
+
+	for (i = -1; i < 0 || data_dirs [i]; ++i)
+		g_ptr_array_add (paths, g_build_filename (
+			i < 0 ? g_get_user_data_dir () : data_dirs [i], "applications", NULL));
+
+	for (i = 0; subdirs && i < subdirs->len; ++i)
+		g_ptr_array_add (paths, g_strdup (g_ptr_array_index (subdirs, i)));
+
+	for (i = 0; i < paths->len; ++i) {
+		dir = g_file_new_for_path (g_ptr_array_index (paths, i));
+
+		monitor = g_file_monitor_directory (dir, G_FILE_MONITOR_NONE, NULL, NULL);
+
+		if (monitor) {
+			g_signal_connect (monitor, "changed", G_CALLBACK (dir_changed_cb), this);
+			priv->monitors = g_list_prepend (priv->monitors, monitor);
+		}
+
+		g_object_unref (dir);
+	}
+
+	g_ptr_array_free (paths, TRUE);
+}
+
+/* Adds the directories below path, down to MAX_SUBDIR_DEPTH levels, to
+ * subdirs.  Entries in them, like applications/kde4/, get desktop ids with
+ * the subdirectory as a prefix.
+ */
+static void
+find_subdirs (const gchar *path, gint depth, GPtrArray *subdirs)
+{
+	GDir        *dir;
+	const gchar *name;
+	gchar       *subdir;
+
+
+	if (depth >= MAX_SUBDIR_DEPTH || ! (dir = g_dir_open (path, 0, NULL)))
+		return;
+
+	while ((name = g_dir_read_name (dir))) {
+		subdir = g_build_filename (path, name, NULL);
+
+		if (g_file_test (subdir, G_FILE_TEST_IS_DIR) && ! g_file_test (subdir, G_FILE_TEST_IS_SYMLINK)) {
+			g_ptr_array_add (subdirs, subdir);
+			find_subdirs (subdir, depth + 1, subdirs);
+		}
+		else
+			g_free (subdir);
+	}
+
+	g_dir_close (dir);
+}
+
+static void
+dir_changed_cb (GFileMonitor *monitor, GFile *file, GFile *other_file,
+                GFileMonitorEvent event_type, gpointer user_data)
+{
+	AppIndexPrivate *priv = PRIVATE (user_data);
+
+	if (event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+		return;
+
+	/* package installs touch many files at once; rebuild once they settle */
+	if (priv->rebuild_id)
+		g_source_remove (priv->rebuild_id);
+
+	priv->rebuild_id = g_timeout_add_seconds (REBUILD_DELAY_SECONDS, rebuild_cb, user_data);
+}
+
+static gboolean
+rebuild_cb (gpointer data)
+{
+	PRIVATE (data)->rebuild_id = 0;
+
+	start_build (APP_INDEX (data));
+
+	return FALSE;
+}
+
+static void
+start_build (AppIndex *this)
+{
+	AppIndexPrivate *priv = PRIVATE (this);
+
+	BuildJob *job;
+
+
+	/* a build already running would miss the latest change, so run another
+	 * one after it */
+	if (priv->building) {
+		priv->stale = TRUE;
+
+		return;
+	}
+
+	priv->building = TRUE;
+	priv->stale    = FALSE;
+
+	job = g_new0 (BuildJob, 1);
+	job->index = g_object_ref (this);
+
+	g_thread_unref (g_thread_new ("app-index", build_thread, job));
+}
+
+/* runs in its own thread */
+static gpointer
+build_thread (gpointer data)
+{
+	BuildJob       *job = data;
+	IndexData      *index;
+	GList          *infos;
+	GList          *node;
+	AppIndexEntry  *entry;
+	const gchar   **keywords;
+
+	const gchar * const *data_dirs;
+
+	const gchar *filename;
+	const gchar *exec;
+	gchar       *text;
+	gchar       *path;
+	gint         i;
+
+
+	/* the main loop watches these along with the top directories */
+	job->subdirs = g_ptr_array_new_with_free_func (g_free);
+	data_dirs    = g_get_system_data_dirs ();
+
+	for (i = -1; i < 0 || data_dirs [i]; ++i) {
+		path = g_build_filename (i < 0 ? g_get_user_data_dir () : data_dirs [i], "applications", NULL);
+		find_subdirs (path, 0, job->subdirs);
+		g_free (path);
+	}
+
+	index = index_data_new ();
+	infos = g_app_info_get_all ();
+
+	for (node = infos; node; node = node->next) {
+		if (! (G_IS_DESKTOP_APP_INFO (node->data) && g_app_info_should_show (node->data))) {
+			g_object_unref (node->data);
+
+			continue;
+		}
+
+		entry = g_new0 (AppIndexEntry, 1);
+
+		entry->info = node->data;
+
+		if ((filename = g_desktop_app_info_get_filename (G_DESKTOP_APP_INFO (entry->info))))
+			entry->uri = g_filename_to_uri (filename, NULL, NULL);
+
+		entry->keys [APP_INDEX_FIELD_NAME] = app_index_get_key (g_app_info_get_name (entry->info));
+		entry->keys [APP_INDEX_FIELD_GENERIC_NAME] = app_index_get_key (
+			g_desktop_app_info_get_generic_name (G_DESKTOP_APP_INFO (entry->info)));
+
+		keywords = (const gchar **) g_desktop_app_info_get_keywords (G_DESKTOP_APP_INFO (entry->info));
+
+		if (keywords && keywords [0]) {
+			text = g_strjoinv (" ", (gchar **) keywords);
+			entry->keys [APP_INDEX_FIELD_KEYWORDS] = app_index_get_key (text);
+			g_free (text);
+		}
+
+		if ((exec = g_app_info_get_executable (entry->info))) {
+			text = g_path_get_basename (exec);
+			entry->keys [APP_INDEX_FIELD_EXEC] = app_index_get_key (text);
+			g_free (text);
+		}
+
+		g_ptr_array_add (index->entries, entry);
+
+		index_entry (index, index->entries->len - 1);
+	}
+
+	g_list_free (infos);
+
+	job->data = index;
+	g_idle_add (build_done_cb, job);
+
+	return NULL;
+}
+
+static gboolean
+build_done_cb (gpointer data)
+{
+	BuildJob        *job  = data;
+	AppIndex        *this = job->index;
+	AppIndexPrivate *priv = PRIVATE (this);
+
+
+	CHECKPOINT ("app index: swapping in new build");
+
+	if (priv->data)
+		index_data_free (priv->data);
+
+	priv->data     = job->data;
+	priv->building = FALSE;
+
+	monitor_app_dirs (this, job->subdirs);
+
+	g_signal_emit (this, app_index_signals [CHANGED], 0);
+
+	if (priv->stale)
+		start_build (this);
+
+	g_ptr_array_free (job->subdirs, TRUE);
+	g_object_unref (this);
+	g_free (job);
+
+	return FALSE;
+}
+
+static IndexData *
+index_data_new (void)
+{
+	IndexData *index = g_new0 (IndexData, 1);
+
+	index->entries  = g_ptr_array_new_with_free_func (entry_free);
+	index->postings = g_hash_table_new_full (
+		g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_array_unref);
+
+	return index;
+}
+
+static void
+index_data_free (IndexData *index)
+{
+	g_ptr_array_free (index->entries, TRUE);
+	g_hash_table_destroy (index->postings);
+	g_free (index);
+}
+
+/* Adds the postings of entry id, which must be the highest id so far, so that
+ * every list stays sorted.
+ */
+static void
+index_entry (IndexData *index, guint id)
+{
+	AppIndexEntry *entry = g_ptr_array_index (index->entries, id);
+
+	const gchar *key;
+	gsize        len;
+
+	gint i;
+	gint j;
+
+
+	for (i = 0; i < APP_INDEX_N_FIELDS; ++i) {
+		if (! (key = entry->keys [i]))
+			continue;
+
+		len = strlen (key);
+
+		for (j = 0; j < len; ++j) {
+			/* a word starts after ASCII punctuation or space, never
+			 * within a multibyte character */
+			if (j == 0 || ((guchar) key [j - 1] < 0x80 && ! g_ascii_isalnum (key [j - 1]))) {
+				if (g_ascii_isalnum (key [j]) || ((guchar) key [j] & 0xC0) == 0xC0) {
+					add_posting (index->postings, PREFIX_KEY (1, key + j), id);
+
+					if (key [j + 1])
+						add_posting (index->postings, PREFIX_KEY (2, key + j), id);
+				}
+			}
+
+			if (j + 2 < len)
+				add_posting (index->postings, TRIGRAM_KEY (key + j), id);
+		}
+	}
+}
+
+static void
+add_posting (GHashTable *postings, guint key, guint id)
+{
+	GArray *list;
+
+
+	list = g_hash_table_lookup (postings, GUINT_TO_POINTER (key));
+
+	if (! list) {
+		list = g_array_new (FALSE, FALSE, sizeof (guint));
+		g_hash_table_insert (postings, GUINT_TO_POINTER (key), list);
+	}
+	else if (g_array_index (list, guint, list->len - 1) == id)
+		return;
+
+	g_array_append_val (list, id);
+}
+
+static void
+entry_free (gpointer data)
+{
+	AppIndexEntry *entry = data;
+
+	gint i;
+
+
+	if (entry->info)
+		g_object_unref (entry->info);
+
+	g_free (entry->uri);
+
+	for (i = 0; i < APP_INDEX_N_FIELDS; ++i)
+		g_free (entry->keys [i]);
+
+	g_free (entry);
+}
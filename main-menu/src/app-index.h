@@ -0,0 +1,72 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef __APP_INDEX_H__
+#define __APP_INDEX_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define APP_INDEX_TYPE         (app_index_get_type ())
+#define APP_INDEX(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), APP_INDEX_TYPE, AppIndex))
+#define APP_INDEX_CLASS(c)     (G_TYPE_CHECK_CLASS_CAST ((c), APP_INDEX_TYPE, AppIndexClass))
+#define IS_APP_INDEX(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), APP_INDEX_TYPE))
+#define IS_APP_INDEX_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE ((c), APP_INDEX_TYPE))
+#define APP_INDEX_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), APP_INDEX_TYPE, AppIndexClass))
+
+typedef enum {
+	APP_INDEX_FIELD_NAME,
+	APP_INDEX_FIELD_GENERIC_NAME,
+	APP_INDEX_FIELD_KEYWORDS,
+	APP_INDEX_FIELD_EXEC,
+	APP_INDEX_N_FIELDS
+} AppIndexField;
+
+/* One installed application.  keys hold the casefolded text of each field,
+ * or NULL; keywords are joined by spaces.
+ */
+typedef struct {
+	GAppInfo *info;
+	gchar    *uri;
+	gchar    *keys [APP_INDEX_N_FIELDS];
+} AppIndexEntry;
+
+typedef struct {
+	GObject g_object;
+} AppIndex;
+
+typedef struct {
+	GObjectClass g_object_class;
+
+	void (* changed) (AppIndex *);
+} AppIndexClass;
+
+GType app_index_get_type (void);
+
+AppIndex  *app_index_get_instance    (void);
+AppIndex  *app_index_new_for_entries (GPtrArray *entries);
+GPtrArray *app_index_lookup          (AppIndex *this, const gchar *key);
+gchar     *app_index_get_key         (const gchar *str);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,1014 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#include "app-prefetch.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <elf.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "io-guard.h"
+#include "launcher.h"
+
+/* Reads the programs the user is likely to start next into the page cache
+ * ahead of time, so that the click does not wait for the disk.
+ *
+ * A pass takes the first MAX_APPS entries of the recent applications, which
+ * come ordered by frecency, and of the favorites.  A thread at idle I/O
+ * priority asks the Launcher which program each of them runs, then follows
+ * every program through its ELF headers to the interpreter and the DT_NEEDED
+ * libraries, resolved much like ld.so does: DT_RPATH, LD_LIBRARY_PATH,
+ * DT_RUNPATH and then the directories of /etc/ld.so.conf.  For each file it
+ * counts the pages mincore () finds already cached and asks the kernel to
+ * read the others with posix_fadvise (), until the budget for the pass is
+ * spent.  The budget only pays for pages that are not cached, so a pass over
+ * a warm cache costs next to nothing.
+ *
+ * The first pass runs shortly after login and then one every
+ * PASS_INTERVAL_SECONDS, or sooner when the applications change, but only
+ * once the load average says the machine is idle and never while the menu is
+ * being presented.
+ *
+ * The running totals go to STATS_FILE_NAME in the user's cache directory:
+ * how many of the pages looked at were cached already, how many had to be
+ * read, and how many launches were of a program the last pass had prefetched.
+ */
+
+#define STATS_DIR_NAME             "gnome-main-menu"
+#define STATS_FILE_NAME            "prefetch-stats"
+#define STATS_GROUP                "Prefetch"
+#define SAVE_DELAY_SECONDS         10
+
+#define FIRST_PASS_DELAY_SECONDS   90
+#define PASS_INTERVAL_SECONDS      1800
+#define CHANGE_DELAY_SECONDS       60
+#define IDLE_RETRY_SECONDS         120
+#define IDLE_LOAD_AVERAGE          0.5
+
+#define MAX_APPS                   12
+#define MAX_FILES_PER_PASS         512
+#define MAX_PROGRAM_HEADERS        64
+#define MAX_DYNAMIC_SIZE           (64 * 1024)
+#define MAX_STRTAB_SIZE            (1024 * 1024)
+#define MAX_CONF_DEPTH             4
+
+#if GLIB_SIZEOF_VOID_P == 8
+#define NATIVE_ELF_CLASS ELFCLASS64
+typedef Elf64_Ehdr ElfEhdr;
+typedef Elf64_Phdr ElfPhdr;
+typedef Elf64_Dyn  ElfDyn;
+#else
+#define NATIVE_ELF_CLASS ELFCLASS32
+typedef Elf32_Ehdr ElfEhdr;
+typedef Elf32_Phdr ElfPhdr;
+typedef Elf32_Dyn  ElfDyn;
+#endif
+
+G_DEFINE_TYPE (AppPrefetch, app_prefetch, G_TYPE_OBJECT)
+
+typedef struct {
+	BookmarkLayer *layers [2];
+
+	gsize       budget;
+	guint       pass_id;
+	gint64      pass_due;
+	gboolean    running;
+	gboolean    presenting;
+	GHashTable *predicted;
+
+	AppPrefetchStats stats;
+	gboolean         stats_loaded;
+	gchar           *stats_path;
+	guint            save_id;
+} AppPrefetchPrivate;
+
+typedef struct {
+	AppPrefetch *prefetch;
+
+	GPtrArray  *uris;
+	GPtrArray  *predicted;
+	GPtrArray  *programs;
+	gchar      *lib_path;
+	gsize       budget;
+	gchar      *stats_path;
+
+	GHashTable *seen;
+	GPtrArray  *lib_dirs;
+	GPtrArray  *system_dirs;
+	gsize       page_size;
+
+	gint             files;
+	AppPrefetchStats totals;
+	AppPrefetchStats saved;
+	gboolean         load_stats;
+} PrefetchJob;
+
+typedef struct {
+	gchar *path;
+	gchar *contents;
+	gsize  length;
+} SaveJob;
+
+#define PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), APP_PREFETCH_TYPE, AppPrefetchPrivate))
+
+static void      app_prefetch_finalize (GObject *);
+static void      schedule_pass         (AppPrefetch *, guint);
+static gboolean  pass_cb               (gpointer);
+static gpointer  pass_thread           (gpointer);
+static gboolean  pass_done_cb          (gpointer);
+static void      prefetch_file         (PrefetchJob *, const gchar *, GQueue *);
+static guint64   count_missing_pages   (PrefetchJob *, gint, gsize, guchar **);
+static void      advise_missing_pages  (PrefetchJob *, gint, gsize, const guchar *);
+static void      read_dependencies     (gint, const gchar *, GPtrArray *, GPtrArray *, GPtrArray *);
+static void      add_search_path       (GPtrArray *, const gchar *, const gchar *);
+static gchar    *find_library          (PrefetchJob *, const gchar *, GPtrArray *, GPtrArray *);
+static gboolean  is_native_elf         (const gchar *);
+static void      read_ld_so_conf       (GPtrArray *, const gchar *, gint);
+static void      load_stats            (const gchar *, AppPrefetchStats *);
+static void      queue_save_stats      (AppPrefetch *);
+static gboolean  save_stats_cb         (gpointer);
+static gpointer  save_stats_thread     (gpointer);
+static void      items_changed_cb      (BookmarkLayer *, const GArray *, gpointer);
+static void      launching_cb          (Launcher *, const gchar *, gpointer);
+
+AppPrefetch *
+app_prefetch_new (BookmarkLayer *favorites, BookmarkLayer *recent)
+{
+	AppPrefetch        *this = g_object_new (APP_PREFETCH_TYPE, NULL);
+	AppPrefetchPrivate *priv = PRIVATE (this);
+
+	gint i;
+
+
+	/* recent first, its order says more about what comes next */
+	priv->layers [0] = g_object_ref (recent);
+	priv->layers [1] = g_object_ref (favorites);
+
+	for (i = 0; i < G_N_ELEMENTS (priv->layers); ++i)
+		g_signal_connect (
+			G_OBJECT (priv->layers [i]), "items-changed",
+			G_CALLBACK (items_changed_cb), this);
+
+	return this;
+}
+
+/* Sets how many megabytes a pass may read, 0 turns prefetching off */
+void
+app_prefetch_set_budget (AppPrefetch *this, gint megabytes)
+{
+	AppPrefetchPrivate *priv = PRIVATE (this);
+
+	gboolean was_off = (priv->budget == 0);
+
+
+	priv->budget = (gsize) MAX (megabytes, 0) * 1024 * 1024;
+
+	if (priv->budget == 0 && priv->pass_id) {
+		g_source_remove (priv->pass_id);
+		priv->pass_id = 0;
+	}
+	else if (priv->budget > 0 && was_off)
+		schedule_pass (this, FIRST_PASS_DELAY_SECONDS);
+}
+
+/* While the menu is being presented, passes wait for it */
+void
+app_prefetch_set_presenting (AppPrefetch *this, gboolean presenting)
+{
+	PRIVATE (this)->presenting = presenting;
+}
+
+/* Until the first pass has loaded the statistics file, the totals only cover
+ * this session.
+ */
+void
+app_prefetch_get_stats (AppPrefetch *this, AppPrefetchStats *stats)
+{
+	*stats = PRIVATE (this)->stats;
+}
+
+static void
+app_prefetch_class_init (AppPrefetchClass *this_class)
+{
+	GObjectClass *g_obj_class = G_OBJECT_CLASS (this_class);
+
+	g_obj_class->finalize = app_prefetch_finalize;
+
+	g_type_class_add_private (this_class, sizeof (AppPrefetchPrivate));
+}
+
+static void
+app_prefetch_init (AppPrefetch *this)
+{
+	AppPrefetchPrivate *priv = PRIVATE (this);
+
+	priv->layers [0] = NULL;
+	priv->layers [1] = NULL;
+
+	priv->budget    = 0;
+	priv->pass_id   = 0;
+	priv->pass_due  = 0;
+	priv->running   = FALSE;
+	priv->presenting = FALSE;
+	priv->predicted = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	memset (& priv->stats, 0, sizeof (priv->stats));
+	priv->stats_loaded = FALSE;
+	priv->stats_path   = g_build_filename (
+		g_get_user_cache_dir (), STATS_DIR_NAME, STATS_FILE_NAME, NULL);
+	priv->save_id      = 0;
+
+	g_signal_connect (
+		G_OBJECT (launcher_get_instance ()), "launching",
+		G_CALLBACK (launching_cb), this);
+}
+
+static void
+app_prefetch_finalize (GObject *g_obj)
+{
+	AppPrefetchPrivate *priv = PRIVATE (g_obj);
+
+	gint i;
+
+
+	if (priv->pass_id)
+		g_source_remove (priv->pass_id);
+
+	if (priv->save_id) {
+		g_source_remove (priv->save_id);
+		save_stats_cb (g_obj);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS (priv->layers); ++i) {
+		g_signal_handlers_disconnect_by_func (priv->layers [i], items_changed_cb, g_obj);
+		g_object_unref (priv->layers [i]);
+	}
+
+	g_signal_handlers_disconnect_by_func (launcher_get_instance (), launching_cb, g_obj);
+
+	g_hash_table_destroy (priv->predicted);
+	g_free (priv->stats_path);
+
+	G_OBJECT_CLASS (app_prefetch_parent_class)->finalize (g_obj);
+}
+
+/* Runs a pass in delay seconds, unless one is due sooner */
+static void
+schedule_pass (AppPrefetch *this, guint delay)
+{
+	AppPrefetchPrivate *priv = PRIVATE (this);
+
+	gint64 due;
+
+
+	if (priv->budget == 0)
+		return;
+
+	due = g_get_monotonic_time () + (gint64) delay * G_USEC_PER_SEC;
+
+	if (priv->pass_id) {
+		if (priv->pass_due <= due)
+			return;
+
+		g_source_remove (priv->pass_id);
+	}
+
+	priv->pass_id  = g_timeout_add_seconds (delay, pass_cb, this);
+	priv->pass_due = due;
+}
+
+static gboolean
+pass_cb (gpointer data)
+{
+	AppPrefetch        *this = APP_PREFETCH (data);
+	AppPrefetchPrivate *priv = PRIVATE (this);
+
+	PrefetchJob   *job;
+	BookmarkItem **items;
+	GHashTable    *seen;
+	gdouble        load;
+	gint           i;
+	gint           j;
+
+
+	priv->pass_id = 0;
+
+	/* a pass still running schedules the next one when it is done */
+	if (priv->running)
+		return FALSE;
+
+	/* the menu being presented gets the disk to itself, and the reading
+	 * waits for a quiet machine */
+	if (priv->presenting || (getloadavg (& load, 1) == 1 && load > IDLE_LOAD_AVERAGE)) {
+		schedule_pass (this, IDLE_RETRY_SECONDS);
+
+		return FALSE;
+	}
+
+	job = g_new0 (PrefetchJob, 1);
+
+	job->prefetch   = g_object_ref (this);
+	job->uris       = g_ptr_array_new_with_free_func (g_free);
+	job->predicted  = g_ptr_array_new ();
+	job->programs   = g_ptr_array_new_with_free_func (g_free);
+	job->budget     = priv->budget;
+	job->stats_path = g_strdup (priv->stats_path);
+	job->load_stats = ! priv->stats_loaded;
+
+	job->lib_path   = g_strdup (g_getenv ("LD_LIBRARY_PATH"));
+
+	/* the thread looks the programs up, which parses the desktop files;
+	 * entries it can't resolve leave room for the ones after them */
+	seen = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (i = 0; i < G_N_ELEMENTS (priv->layers); ++i) {
+		items = bookmark_layer_get_items (priv->layers [i]);
+
+		for (j = 0; items && items [j]; ++j) {
+			if (g_hash_table_contains (seen, items [j]->uri))
+				continue;
+
+			g_hash_table_add (seen, items [j]->uri);
+			g_ptr_array_add (job->uris, g_strdup (items [j]->uri));
+		}
+	}
+
+	g_hash_table_destroy (seen);
+
+	priv->running = TRUE;
+
+	g_thread_unref (g_thread_new ("app-prefetch", pass_thread, job));
+
+	return FALSE;
+}
+
+/* runs in its own thread */
+static gpointer
+pass_thread (gpointer data)
+{
+	PrefetchJob *job = data;
+
+	GQueue *pending;
+	gchar  *path;
+	gint    i;
+
+
+	io_guard_lower_thread_priority ();
+
+	for (i = 0; i < job->uris->len && job->programs->len < MAX_APPS; ++i) {
+		if ((path = launcher_find_program (job->uris->pdata [i]))) {
+			g_ptr_array_add (job->programs,  path);
+			g_ptr_array_add (job->predicted, job->uris->pdata [i]);
+		}
+	}
+
+	if (job->load_stats)
+		load_stats (job->stats_path, & job->saved);
+
+	job->seen        = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	job->lib_dirs    = g_ptr_array_new_with_free_func (g_free);
+	job->system_dirs = g_ptr_array_new_with_free_func (g_free);
+	job->page_size   = sysconf (_SC_PAGESIZE);
+
+	if (job->lib_path)
+		add_search_path (job->lib_dirs, job->lib_path, NULL);
+
+	read_ld_so_conf (job->system_dirs, "/etc/ld.so.conf", 0);
+
+	add_search_path (job->system_dirs, "/lib64:/usr/lib64:/lib:/usr/lib", NULL);
+
+	pending = g_queue_new ();
+
+	for (i = 0; i < job->programs->len; ++i) {
+		path = job->programs->pdata [i];
+
+		if (! g_hash_table_contains (job->seen, path)) {
+			g_hash_table_add (job->seen, g_strdup (path));
+			g_queue_push_tail (pending, g_strdup (path));
+		}
+	}
+
+	/* breadth first, so that a short budget goes to the programs and the
+	 * libraries closest to them */
+	while ((path = g_queue_pop_head (pending))) {
+		if (job->budget > 0 && job->files < MAX_FILES_PER_PASS)
+			prefetch_file (job, path, pending);
+
+		g_free (path);
+	}
+
+	g_queue_free (pending);
+
+	job->totals.passes = 1;
+
+	g_idle_add (pass_done_cb, job);
+
+	return NULL;
+}
+
+static gboolean
+pass_done_cb (gpointer data)
+{
+	PrefetchJob        *job  = data;
+	AppPrefetch        *this = job->prefetch;
+	AppPrefetchPrivate *priv = PRIVATE (this);
+
+	gint i;
+
+
+	priv->running = FALSE;
+
+	g_hash_table_remove_all (priv->predicted);
+
+	for (i = 0; i < job->predicted->len; ++i)
+		g_hash_table_add (priv->predicted, g_strdup (job->predicted->pdata [i]));
+
+	if (job->load_stats) {
+		priv->stats.passes             += job->saved.passes;
+		priv->stats.pages              += job->saved.pages;
+		priv->stats.resident_pages     += job->saved.resident_pages;
+		priv->stats.read_pages         += job->saved.read_pages;
+		priv->stats.launches           += job->saved.launches;
+		priv->stats.predicted_launches += job->saved.predicted_launches;
+
+		priv->stats_loaded = TRUE;
+	}
+
+	priv->stats.passes         += job->totals.passes;
+	priv->stats.pages          += job->totals.pages;
+	priv->stats.resident_pages += job->totals.resident_pages;
+	priv->stats.read_pages     += job->totals.read_pages;
+
+	queue_save_stats (this);
+
+	schedule_pass (this, PASS_INTERVAL_SECONDS);
+
+	g_ptr_array_free (job->predicted, TRUE);
+	g_ptr_array_free (job->uris, TRUE);
+	g_ptr_array_free (job->programs, TRUE);
+	g_free (job->lib_path);
+	g_free (job->stats_path);
+	g_hash_table_destroy (job->seen);
+	g_ptr_array_free (job->lib_dirs, TRUE);
+	g_ptr_array_free (job->system_dirs, TRUE);
+	g_object_unref (this);
+	g_free (job);
+
+	return FALSE;
+}
+
+/* Reads the uncached part of path, as far as the budget goes, and queues the
+ * files it depends on that no one has queued yet.
+ */
+static void
+prefetch_file (PrefetchJob *job, const gchar *path, GQueue *pending)
+{
+	struct stat  info;
+	GPtrArray   *needed;
+	GPtrArray   *first_dirs;
+	GPtrArray   *last_dirs;
+	gchar       *library;
+	guchar      *resident;
+	guint64      missing;
+	gint         fd;
+	gint         i;
+
+
+	if ((fd = open (path, O_RDONLY | O_CLOEXEC)) < 0)
+		return;
+
+	if (fstat (fd, & info) || ! S_ISREG (info.st_mode) || info.st_size <= 0) {
+		close (fd);
+
+		return;
+	}
+
+	job->files++;
+
+	/* before reading the headers pulls the first pages in */
+	missing = count_missing_pages (job, fd, info.st_size, & resident);
+
+	needed     = g_ptr_array_new_with_free_func (g_free);
+	first_dirs = g_ptr_array_new_with_free_func (g_free);
+	last_dirs  = g_ptr_array_new_with_free_func (g_free);
+
+	read_dependencies (fd, path, needed, first_dirs, last_dirs);
+
+	for (i = 0; i < needed->len; ++i) {
+		library = find_library (job, needed->pdata [i], first_dirs, last_dirs);
+
+		if (library && ! g_hash_table_contains (job->seen, library)) {
+			g_hash_table_add (job->seen, g_strdup (library));
+			g_queue_push_tail (pending, library);
+		}
+		else
+			g_free (library);
+	}
+
+	if (missing > 0)
+		advise_missing_pages (job, fd, info.st_size, resident);
+
+	g_free (resident);
+	g_ptr_array_free (needed,     TRUE);
+	g_ptr_array_free (first_dirs, TRUE);
+	g_ptr_array_free (last_dirs,  TRUE);
+
+	close (fd);
+}
+
+/* Returns how many pages of the file are not cached.  Unless that is unknown,
+ * *resident is set to the mincore () vector, to be freed with g_free ().
+ */
+static guint64
+count_missing_pages (PrefetchJob *job, gint fd, gsize size, guchar **resident)
+{
+	guint64        pages;
+	guint64        missing = 0;
+	gpointer       map;
+	unsigned char *vec;
+	guint64        i;
+
+
+	pages = (size + job->page_size - 1) / job->page_size;
+
+	job->totals.pages += pages;
+
+	*resident = NULL;
+
+	map = mmap (NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+
+	if (map == MAP_FAILED)
+		return pages;
+
+	vec = g_malloc (pages);
+
+	if (mincore (map, size, vec) == 0) {
+		for (i = 0; i < pages; ++i)
+			if (! (vec [i] & 1))
+				missing++;
+
+		*resident = vec;
+	}
+	else {
+		missing = pages;
+
+		g_free (vec);
+	}
+
+	munmap (map, size);
+
+	job->totals.resident_pages += pages - missing;
+
+	return missing;
+}
+
+/* Asks the kernel to read each run of pages resident marks as not cached, or
+ * the whole file if resident is NULL, until the budget is spent.  Only the
+ * pages asked for are charged.
+ */
+static void
+advise_missing_pages (PrefetchJob *job, gint fd, gsize size, const guchar *resident)
+{
+	guint64 pages;
+	guint64 first;
+	guint64 last;
+	guint64 limit;
+	gsize   length;
+
+
+	pages = (size + job->page_size - 1) / job->page_size;
+
+	for (first = 0; first < pages && job->budget > 0; first = last) {
+		last = first + 1;
+
+		if (resident && (resident [first] & 1))
+			continue;
+
+		limit = first + (job->budget + job->page_size - 1) / job->page_size;
+
+		while (last < pages && last < limit && ! (resident && (resident [last] & 1)))
+			last++;
+
+		length = (last - first) * job->page_size;
+
+		posix_fadvise (fd, first * job->page_size, length, POSIX_FADV_WILLNEED);
+
+		job->totals.read_pages += last - first;
+		job->budget            -= MIN (length, job->budget);
+	}
+}
+
+/* Adds what the ELF object (or script) at path needs to be loaded to needed:
+ * its interpreter and its DT_NEEDED entries.  The directories of its DT_RPATH
+ * go to first_dirs, those of its DT_RUNPATH to last_dirs.  Anything that does
+ * not look right is skipped; this is only a hint to the page cache.
+ */
+static void
+read_dependencies (gint fd, const gchar *path, GPtrArray *needed, GPtrArray *first_dirs, GPtrArray *last_dirs)
+{
+	gchar    head [256];
+	ElfEhdr  header;
+	ElfPhdr *phdrs   = NULL;
+	ElfDyn  *dynamic = NULL;
+	gchar   *strtab  = NULL;
+	gchar   *origin;
+	gchar   *interp;
+	gssize   length;
+	gsize    n_dynamic = 0;
+	guint64  strtab_addr = 0;
+	guint64  strtab_size = 0;
+	goffset  strtab_offset = -1;
+	gint     i;
+
+
+	length = pread (fd, head, sizeof (head) - 1, 0);
+
+	if (length > 2 && head [0] == '#' && head [1] == '!') {
+		head [length] = '\0';
+		interp = g_strstrip (g_strndup (head + 2, strcspn (head + 2, "\n")));
+		interp [strcspn (interp, " \t")] = '\0';
+
+		if (g_path_is_absolute (interp))
+			g_ptr_array_add (needed, interp);
+		else
+			g_free (interp);
+
+		return;
+	}
+
+	if (length < (gssize) sizeof (header))
+		return;
+
+	memcpy (& header, head, sizeof (header));
+
+	if (
+		memcmp (header.e_ident, ELFMAG, SELFMAG) ||
+		header.e_ident [EI_CLASS] != NATIVE_ELF_CLASS ||
+		header.e_phentsize != sizeof (ElfPhdr) ||
+		header.e_phnum == 0 || header.e_phnum > MAX_PROGRAM_HEADERS
+	)
+		return;
+
+	phdrs = g_new (ElfPhdr, header.e_phnum);
+
+	if (pread (fd, phdrs, header.e_phnum * sizeof (ElfPhdr), header.e_phoff) != (gssize) (header.e_phnum * sizeof (ElfPhdr)))
+		goto exit;
+
+	for (i = 0; i < header.e_phnum; ++i) {
+		if (phdrs [i].p_type == PT_INTERP && phdrs [i].p_filesz > 1 && phdrs [i].p_filesz < 4096) {
+			interp = g_malloc0 (phdrs [i].p_filesz + 1);
+
+			if (pread (fd, interp, phdrs [i].p_filesz, phdrs [i].p_offset) == (gssize) phdrs [i].p_filesz)
+				g_ptr_array_add (needed, interp);
+			else
+				g_free (interp);
+		}
+		else if (phdrs [i].p_type == PT_DYNAMIC && ! dynamic && phdrs [i].p_filesz <= MAX_DYNAMIC_SIZE) {
+			n_dynamic = phdrs [i].p_filesz / sizeof (ElfDyn);
+			dynamic   = g_new (ElfDyn, MAX (n_dynamic, 1));
+
+			if (pread (fd, dynamic, n_dynamic * sizeof (ElfDyn), phdrs [i].p_offset) != (gssize) (n_dynamic * sizeof (ElfDyn)))
+				n_dynamic = 0;
+		}
+	}
+
+	for (i = 0; i < n_dynamic && dynamic [i].d_tag != DT_NULL; ++i) {
+		if (dynamic [i].d_tag == DT_STRTAB)
+			strtab_addr = dynamic [i].d_un.d_ptr;
+		else if (dynamic [i].d_tag == DT_STRSZ)
+			strtab_size = dynamic [i].d_un.d_val;
+	}
+
+	if (strtab_size == 0 || strtab_size > MAX_STRTAB_SIZE)
+		goto exit;
+
+	/* DT_STRTAB is an address, the file offset is found through the loadable
+	 * segment that holds it */
+	for (i = 0; i < header.e_phnum; ++i)
+		if (
+			phdrs [i].p_type == PT_LOAD &&
+			strtab_addr >= phdrs [i].p_vaddr &&
+			strtab_addr + strtab_size <= phdrs [i].p_vaddr + phdrs [i].p_filesz
+		)
+			strtab_offset = strtab_addr - phdrs [i].p_vaddr + phdrs [i].p_offset;
+
+	if (strtab_offset < 0)
+		goto exit;
+
+	strtab = g_malloc (strtab_size + 1);
+
+	if (pread (fd, strtab, strtab_size, strtab_offset) != (gssize) strtab_size)
+		goto exit;
+
+	strtab [strtab_size] = '\0';
+
+	origin = g_path_get_dirname (path);
+
+	for (i = 0; i < n_dynamic && dynamic [i].d_tag != DT_NULL; ++i) {
+		if (dynamic [i].d_un.d_val >= strtab_size)
+			continue;
+
+		if (dynamic [i].d_tag == DT_NEEDED)
+			g_ptr_array_add (needed, g_strdup (strtab + dynamic [i].d_un.d_val));
+		else if (dynamic [i].d_tag == DT_RPATH)
+			add_search_path (first_dirs, strtab + dynamic [i].d_un.d_val, origin);
+		else if (dynamic [i].d_tag == DT_RUNPATH)
+			add_search_path (last_dirs, strtab + dynamic [i].d_un.d_val, origin);
+	}
+
+	/* with a DT_RUNPATH, ld.so ignores the DT_RPATH */
+	if (last_dirs->len > 0)
+		g_ptr_array_set_size (first_dirs, 0);
+
+	g_free (origin);
+
+exit:
+
+	g_free (phdrs);
+	g_free (dynamic);
+	g_free (strtab);
+}
+
+/* Appends the absolute directories of the colon separated list path to dirs,
+ * with $ORIGIN replaced by origin.  Directories with other dynamic string
+ * tokens are dropped.
+ */
+static void
+add_search_path (GPtrArray *dirs, const gchar *path, const gchar *origin)
+{
+	static const gchar *tokens [] = { "${ORIGIN}", "$ORIGIN" };
+
+	gchar  **elements;
+	GString *dir;
+	gchar   *token;
+	gsize    offset;
+	gint     i;
+	gint     j;
+
+
+	elements = g_strsplit (path, ":", -1);
+
+	for (i = 0; elements [i]; ++i) {
+		dir = g_string_new (elements [i]);
+
+		for (j = 0; origin && j < G_N_ELEMENTS (tokens); ++j) {
+			offset = 0;
+
+			while ((token = strstr (dir->str + offset, tokens [j]))) {
+				offset = token - dir->str;
+
+				g_string_erase  (dir, offset, strlen (tokens [j]));
+				g_string_insert (dir, offset, origin);
+
+				offset += strlen (origin);
+			}
+		}
+
+		if (dir->str [0] == '/' && ! strchr (dir->str, '$'))
+			g_ptr_array_add (dirs, g_strdup (dir->str));
+
+		g_string_free (dir, TRUE);
+	}
+
+	g_strfreev (elements);
+}
+
+/* Returns the file ld.so would load for the DT_NEEDED entry name, or NULL */
+static gchar *
+find_library (PrefetchJob *job, const gchar *name, GPtrArray *first_dirs, GPtrArray *last_dirs)
+{
+	GPtrArray *dirs [4];
+	gchar     *path;
+	gint       i;
+	gint       j;
+
+
+	if (strchr (name, '/'))
+		return g_path_is_absolute (name) ? g_strdup (name) : NULL;
+
+	dirs [0] = first_dirs;
+	dirs [1] = job->lib_dirs;
+	dirs [2] = last_dirs;
+	dirs [3] = job->system_dirs;
+
+	for (i = 0; i < G_N_ELEMENTS (dirs); ++i)
+		for (j = 0; j < dirs [i]->len; ++j) {
+			path = g_build_filename (dirs [i]->pdata [j], name, NULL);
+
+			if (g_hash_table_contains (job->seen, path) || is_native_elf (path))
+				return path;
+
+			g_free (path);
+		}
+
+	return NULL;
+}
+
+static gboolean
+is_native_elf (const gchar *path)
+{
+	guchar ident [EI_NIDENT];
+	gint   fd;
+	gssize length;
+
+
+	if ((fd = open (path, O_RDONLY | O_CLOEXEC)) < 0)
+		return FALSE;
+
+	length = pread (fd, ident, sizeof (ident), 0);
+
+	close (fd);
+
+	return
+		length == sizeof (ident) && ! memcmp (ident, ELFMAG, SELFMAG) &&
+		ident [EI_CLASS] == NATIVE_ELF_CLASS;
+}
+
+/* Appends the directories listed in the ld.so.conf at path, following its
+ * include lines.
+ */
+static void
+read_ld_so_conf (GPtrArray *dirs, const gchar *path, gint depth)
+{
+	gchar  *contents;
+	gchar **lines;
+	gchar  *line;
+	gchar  *pattern;
+	gchar  *base;
+	glob_t  matches;
+	gint    i;
+	gint    j;
+
+
+	if (depth > MAX_CONF_DEPTH || ! g_file_get_contents (path, & contents, NULL, NULL))
+		return;
+
+	lines = g_strsplit (contents, "\n", -1);
+
+	for (i = 0; lines [i]; ++i) {
+		line = lines [i];
+		line [strcspn (line, "#")] = '\0';
+		g_strstrip (line);
+
+		if (g_str_has_prefix (line, "include") && g_ascii_isspace (line [7])) {
+			pattern = g_strstrip (line + 7);
+
+			if (g_path_is_absolute (pattern))
+				pattern = g_strdup (pattern);
+			else {
+				base    = g_path_get_dirname (path);
+				pattern = g_build_filename (base, pattern, NULL);
+				g_free (base);
+			}
+
+			if (glob (pattern, 0, NULL, & matches) == 0) {
+				for (j = 0; j < matches.gl_pathc; ++j)
+					read_ld_so_conf (dirs, matches.gl_pathv [j], depth + 1);
+
+				globfree (& matches);
+			}
+
+			g_free (pattern);
+		}
+		else if (line [0] == '/')
+			g_ptr_array_add (dirs, g_strdup (line));
+	}
+
+	g_strfreev (lines);
+	g_free (contents);
+}
+
+static void
+load_stats (const gchar *path, AppPrefetchStats *stats)
+{
+	GKeyFile *file;
+
+
+	file = g_key_file_new ();
+
+	if (g_key_file_load_from_file (file, path, G_KEY_FILE_NONE, NULL)) {
+		stats->passes             = g_key_file_get_integer (file, STATS_GROUP, "passes",             NULL);
+		stats->pages              = g_key_file_get_uint64  (file, STATS_GROUP, "pages",              NULL);
+		stats->resident_pages     = g_key_file_get_uint64  (file, STATS_GROUP, "resident-pages",     NULL);
+		stats->read_pages         = g_key_file_get_uint64  (file, STATS_GROUP, "read-pages",         NULL);
+		stats->launches           = g_key_file_get_integer (file, STATS_GROUP, "launches",           NULL);
+		stats->predicted_launches = g_key_file_get_integer (file, STATS_GROUP, "predicted-launches", NULL);
+	}
+
+	g_key_file_free (file);
+}
+
+static void
+queue_save_stats (AppPrefetch *this)
+{
+	AppPrefetchPrivate *priv = PRIVATE (this);
+
+	/* the totals written before the file was read would wipe it out */
+	if (priv->stats_loaded && ! priv->save_id)
+		priv->save_id = g_timeout_add_seconds (SAVE_DELAY_SECONDS, save_stats_cb, this);
+}
+
+static gboolean
+save_stats_cb (gpointer data)
+{
+	AppPrefetchPrivate *priv = PRIVATE (data);
+
+	GKeyFile *file;
+	SaveJob  *job;
+
+
+	priv->save_id = 0;
+
+	file = g_key_file_new ();
+
+	g_key_file_set_integer (file, STATS_GROUP, "passes",             priv->stats.passes);
+	g_key_file_set_uint64  (file, STATS_GROUP, "pages",              priv->stats.pages);
+	g_key_file_set_uint64  (file, STATS_GROUP, "resident-pages",     priv->stats.resident_pages);
+	g_key_file_set_uint64  (file, STATS_GROUP, "read-pages",         priv->stats.read_pages);
+	g_key_file_set_integer (file, STATS_GROUP, "launches",           priv->stats.launches);
+	g_key_file_set_integer (file, STATS_GROUP, "predicted-launches", priv->stats.predicted_launches);
+
+	/* for whoever reads the file */
+	if (priv->stats.pages > 0)
+		g_key_file_set_double (file, STATS_GROUP, "cache-hit-rate",
+			(gdouble) priv->stats.resident_pages / priv->stats.pages);
+
+	if (priv->stats.launches > 0)
+		g_key_file_set_double (file, STATS_GROUP, "prediction-hit-rate",
+			(gdouble) priv->stats.predicted_launches / priv->stats.launches);
+
+	job = g_new0 (SaveJob, 1);
+
+	job->path     = g_strdup (priv->stats_path);
+	job->contents = g_key_file_to_data (file, & job->length, NULL);
+
+	g_key_file_free (file);
+
+	g_thread_unref (g_thread_new ("prefetch-stats", save_stats_thread, job));
+
+	return FALSE;
+}
+
+/* runs in its own thread */
+static gpointer
+save_stats_thread (gpointer data)
+{
+	SaveJob *job = data;
+
+	gchar *dir;
+
+
+	dir = g_path_get_dirname (job->path);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+
+	g_file_set_contents (job->path, job->contents, job->length, NULL);
+
+	g_free (job->path);
+	g_free (job->contents);
+	g_free (job);
+
+	return NULL;
+}
+
+static void
+items_changed_cb (BookmarkLayer *layer, const GArray *deltas, gpointer user_data)
+{
+	schedule_pass (APP_PREFETCH (user_data), CHANGE_DELAY_SECONDS);
+}
+
+static void
+launching_cb (Launcher *launcher, const gchar *uri, gpointer user_data)
+{
+	AppPrefetchPrivate *priv = PRIVATE (user_data);
+
+	priv->stats.launches++;
+
+	if (uri && g_hash_table_contains (priv->predicted, uri))
+		priv->stats.predicted_launches++;
+
+	queue_save_stats (APP_PREFETCH (user_data));
+}
@@ -0,0 +1,63 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef __APP_PREFETCH_H__
+#define __APP_PREFETCH_H__
+
+#include "bookmark-layer.h"
+
+G_BEGIN_DECLS
+
+#define APP_PREFETCH_TYPE         (app_prefetch_get_type ())
+#define APP_PREFETCH(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), APP_PREFETCH_TYPE, AppPrefetch))
+#define APP_PREFETCH_CLASS(c)     (G_TYPE_CHECK_CLASS_CAST ((c), APP_PREFETCH_TYPE, AppPrefetchClass))
+#define IS_APP_PREFETCH(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), APP_PREFETCH_TYPE))
+#define IS_APP_PREFETCH_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE ((c), APP_PREFETCH_TYPE))
+#define APP_PREFETCH_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), APP_PREFETCH_TYPE, AppPrefetchClass))
+
+typedef struct {
+	GObject g_object;
+} AppPrefetch;
+
+typedef struct {
+	GObjectClass g_object_class;
+} AppPrefetchClass;
+
+/* The running totals kept in the statistics file, see app-prefetch.c */
+typedef struct {
+	gint    passes;
+	guint64 pages;
+	guint64 resident_pages;
+	guint64 read_pages;
+	gint    launches;
+	gint    predicted_launches;
+} AppPrefetchStats;
+
+GType app_prefetch_get_type (void);
+
+AppPrefetch *app_prefetch_new            (BookmarkLayer *favorites, BookmarkLayer *recent);
+void         app_prefetch_set_budget     (AppPrefetch *this, gint megabytes);
+void         app_prefetch_set_presenting (AppPrefetch *this, gboolean presenting);
+void         app_prefetch_get_stats      (AppPrefetch *this, AppPrefetchStats *stats);
+
+G_END_DECLS
+
+#endif
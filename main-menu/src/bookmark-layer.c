@@ -0,0 +1,1268 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#include "bookmark-layer.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "io-guard.h"
+#include "stall-watchdog.h"
+
+/* The agents only tell us that their item list changed.  The layer keeps a
+ * snapshot of the list it last saw and turns each change into a short edit
+ * script, so that the tables can move, add and drop single tiles instead of
+ * rebuilding all of them.  "items-changed" carries the script, or NULL when
+ * the change is too large for a script to be worth applying.
+ *
+ * A layer with a journal also keeps the user's additions, removals and
+ * reorderings away from the agent for a while.  Each one is applied to the
+ * snapshot at once and appended to a small journal file by a worker thread,
+ * one synced write per batch, and only the net changes and the latest order
+ * are handed to the agent, which rewrites its whole store for every call,
+ * once per COMPACT_DELAY_SECONDS or when the layer is flushed.  A journal left
+ * behind by a crash is replayed when the journal is enabled again.
+ */
+
+#define COMPACT_DELAY_SECONDS 3
+#define JOURNAL_DIR_NAME      "gnome-main-menu"
+#define JOURNAL_RECORD        "reorder"
+#define JOURNAL_ADD_RECORD    "add"
+#define JOURNAL_REMOVE_RECORD "remove"
+
+G_DEFINE_TYPE (BookmarkLayer, bookmark_layer, G_TYPE_OBJECT)
+
+typedef struct {
+	BookmarkAgent *agent;
+	GPtrArray     *keys;
+	BookmarkItem **items;
+
+	GCompareDataFunc sort_func;
+	gpointer         sort_data;
+
+	BookmarkLayerFilterFunc filter_func;
+	gpointer                filter_data;
+
+	gchar         *journal_path;
+	GPtrArray     *pending_items;
+	GPtrArray     *pending_removals;
+	gchar        **pending_order;
+	guint          compact_id;
+} BookmarkLayerPrivate;
+
+typedef struct {
+	gchar    *path;
+	gchar    *record;
+} JournalJob;
+
+enum {
+	ITEMS_CHANGED,
+	LAST_SIGNAL
+};
+
+static guint bookmark_layer_signals [LAST_SIGNAL] = { 0 };
+
+/* one thread, so that records and truncations hit the files in order */
+static GThreadPool *journal_pool = NULL;
+
+#define PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), BOOKMARK_LAYER_TYPE, BookmarkLayerPrivate))
+
+static void       bookmark_layer_finalize (GObject *);
+static void       agent_notify_cb         (GObject *, GParamSpec *, gpointer);
+static void       agent_weak_notify       (gpointer, GObject *);
+static BookmarkItem **get_agent_items    (BookmarkLayer *);
+static BookmarkItem **get_sorted_items   (BookmarkLayer *);
+static void       update_keys             (BookmarkLayer *, GPtrArray *);
+static void       update_items            (BookmarkLayer *);
+static GPtrArray *order_keys              (GPtrArray *, const gchar * const *);
+static gchar    **get_key_uris            (GPtrArray *);
+static gboolean   compact_cb              (gpointer);
+static void       journal_push            (const gchar *, gchar *);
+static void       journal_job_run         (gpointer, gpointer);
+static gboolean   write_all               (gint, const gchar *, gsize);
+static void       journal_sync            (void);
+static GPtrArray *get_item_keys           (BookmarkItem **);
+static gchar     *get_item_key            (const BookmarkItem *);
+static gint       find_key                (GPtrArray *, const gchar *);
+static void       apply_pending_keys      (BookmarkLayer *, GPtrArray *);
+static gint       find_pending_item       (BookmarkLayer *, const gchar *);
+static gint       find_pending_removal    (BookmarkLayer *, const gchar *);
+static void       remove_uri              (BookmarkLayer *, const gchar *);
+static BookmarkItem *copy_item           (const BookmarkItem *);
+static void       append_add_record       (GString *, const BookmarkItem *);
+static BookmarkItem *parse_add_record    (const gchar *);
+static GArray    *compute_deltas          (GPtrArray *, GPtrArray *);
+
+BookmarkLayer *
+bookmark_layer_get_for_agent (BookmarkAgent *agent)
+{
+	BookmarkLayer        *this;
+	BookmarkLayerPrivate *priv;
+
+
+	this = g_object_get_data (G_OBJECT (agent), "bookmark-layer");
+
+	if (this)
+		return this;
+
+	this = g_object_new (BOOKMARK_LAYER_TYPE, NULL);
+	priv = PRIVATE (this);
+
+	priv->agent = agent;
+	priv->keys  = get_item_keys (get_agent_items (this));
+
+	update_items (this);
+
+	g_object_weak_ref (G_OBJECT (agent), agent_weak_notify, this);
+
+	g_object_set_data_full (G_OBJECT (agent), "bookmark-layer", this, g_object_unref);
+
+	g_signal_connect (
+		G_OBJECT (agent), "notify::" BOOKMARK_AGENT_ITEMS_PROP,
+		G_CALLBACK (agent_notify_cb), this);
+
+	return this;
+}
+
+/* Returns the items in the layer's order, which runs ahead of the agent's
+ * while a reordering is pending.  The array stays valid until the next
+ * "items-changed", or until the agent next notifies if that brings no change.
+ */
+BookmarkItem **
+bookmark_layer_get_items (BookmarkLayer *this)
+{
+	return PRIVATE (this)->items;
+}
+
+/* Returns whether the layer holds an item for uri, pending ones included */
+gboolean
+bookmark_layer_has_item (BookmarkLayer *this, const gchar *uri)
+{
+	return find_key (PRIVATE (this)->keys, uri) >= 0;
+}
+
+/* Applies a reordering by the user to the snapshot first, so the tables get
+ * the moves right away.  The items named in uris trade places among the slots
+ * they already hold.  Without a journal the agent gets the order at once,
+ * otherwise compact_cb () hands it over later.  Either way, by the time the
+ * agent notifies the snapshot matches its new order and the diff comes out
+ * empty; if the agent ordered anything differently, that diff carries the
+ * correction.
+ */
+void
+bookmark_layer_reorder_items (BookmarkLayer *this, const gchar **uris)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	GString *record;
+	gchar   *escaped;
+	gint     i;
+
+
+	if (! priv->agent)
+		return;
+
+	update_keys (this, order_keys (priv->keys, (const gchar * const *) uris));
+
+	if (! priv->journal_path) {
+		bookmark_agent_reorder_items (priv->agent, uris);
+
+		return;
+	}
+
+	g_strfreev (priv->pending_order);
+	priv->pending_order = get_key_uris (priv->keys);
+
+	record = g_string_new (JOURNAL_RECORD);
+
+	/* escaped like the other records, so that a tab or a newline in a uri
+	 * cannot break the record up */
+	for (i = 0; priv->pending_order [i]; ++i) {
+		escaped = g_strescape (priv->pending_order [i], NULL);
+
+		g_string_append_c (record, '\t');
+		g_string_append   (record, escaped);
+
+		g_free (escaped);
+	}
+
+	g_string_append_c (record, '\n');
+
+	journal_push (priv->journal_path, g_string_free (record, FALSE));
+
+	if (! priv->compact_id)
+		priv->compact_id = g_timeout_add_seconds (COMPACT_DELAY_SECONDS, compact_cb, this);
+}
+
+/* Adds items to the end of the layer in one go; items it already holds are
+ * skipped.  With a journal the batch is applied to the snapshot at once and
+ * written to the journal as a single record, and compact_cb () hands it to
+ * the agent later, together with any pending order.  Without one the agent
+ * gets the items right away, its notifications held back until the last one
+ * is in.
+ */
+void
+bookmark_layer_add_items (BookmarkLayer *this, BookmarkItem **items)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	GPtrArray    *keys;
+	GString      *record;
+	BookmarkItem *item;
+	gint          i;
+
+
+	if (! (priv->agent && items && items [0]))
+		return;
+
+	if (! priv->journal_path) {
+		g_object_freeze_notify (G_OBJECT (priv->agent));
+
+		for (i = 0; items [i]; ++i)
+			bookmark_agent_add_item (priv->agent, items [i]);
+
+		g_object_thaw_notify (G_OBJECT (priv->agent));
+
+		return;
+	}
+
+	keys   = g_ptr_array_new_with_free_func (g_free);
+	record = g_string_new (NULL);
+
+	for (i = 0; i < priv->keys->len; ++i)
+		g_ptr_array_add (keys, g_strdup (g_ptr_array_index (priv->keys, i)));
+
+	for (i = 0; items [i]; ++i) {
+		if (! (items [i]->uri && items [i]->mime_type) || find_key (keys, items [i]->uri) >= 0)
+			continue;
+
+		item = copy_item (items [i]);
+
+		g_ptr_array_add (priv->pending_items, item);
+		g_ptr_array_add (keys, get_item_key (item));
+
+		append_add_record (record, item);
+	}
+
+	if (record->len == 0) {
+		g_ptr_array_free (keys, TRUE);
+		g_string_free (record, TRUE);
+
+		return;
+	}
+
+	update_keys (this, keys);
+
+	/* a pending order has to take the new items along */
+	if (priv->pending_order) {
+		g_strfreev (priv->pending_order);
+		priv->pending_order = get_key_uris (priv->keys);
+	}
+
+	journal_push (priv->journal_path, g_string_free (record, FALSE));
+
+	if (! priv->compact_id)
+		priv->compact_id = g_timeout_add_seconds (COMPACT_DELAY_SECONDS, compact_cb, this);
+}
+
+/* Removes the items named in uris from the layer, the way
+ * bookmark_layer_add_items () adds them: with a journal the removals show in
+ * the snapshot at once, are written to the journal as a single record, and
+ * reach the agent with the next compaction.
+ */
+void
+bookmark_layer_remove_items (BookmarkLayer *this, const gchar **uris)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	GPtrArray *keys;
+	GPtrArray *dropped;
+	GString   *record;
+	gchar     *escaped;
+	gint       index;
+	gint       i;
+
+
+	if (! (priv->agent && uris && uris [0]))
+		return;
+
+	if (! priv->journal_path) {
+		g_object_freeze_notify (G_OBJECT (priv->agent));
+
+		for (i = 0; uris [i]; ++i)
+			if (bookmark_agent_has_item (priv->agent, uris [i]))
+				bookmark_agent_remove_item (priv->agent, uris [i]);
+
+		g_object_thaw_notify (G_OBJECT (priv->agent));
+
+		return;
+	}
+
+	keys    = g_ptr_array_new_with_free_func (g_free);
+	dropped = g_ptr_array_new_with_free_func ((GDestroyNotify) bookmark_item_free);
+	record  = g_string_new (NULL);
+
+	for (i = 0; i < priv->keys->len; ++i)
+		g_ptr_array_add (keys, g_strdup (g_ptr_array_index (priv->keys, i)));
+
+	for (i = 0; uris [i]; ++i) {
+		if ((index = find_key (keys, uris [i])) < 0)
+			continue;
+
+		g_ptr_array_remove_index (keys, index);
+
+		/* an item the agent has not seen yet is simply forgotten, but only
+		 * once the snapshot no longer points at it */
+		if ((index = find_pending_item (this, uris [i])) >= 0)
+			g_ptr_array_add (dropped, g_ptr_array_remove_index (priv->pending_items, index));
+		else
+			g_ptr_array_add (priv->pending_removals, g_strdup (uris [i]));
+
+		escaped = g_strescape (uris [i], NULL);
+		g_string_append_printf (record, JOURNAL_REMOVE_RECORD "\t%s\n", escaped);
+		g_free (escaped);
+	}
+
+	if (record->len == 0) {
+		g_ptr_array_free (keys, TRUE);
+		g_ptr_array_free (dropped, TRUE);
+		g_string_free (record, TRUE);
+
+		return;
+	}
+
+	update_keys (this, keys);
+
+	g_ptr_array_free (dropped, TRUE);
+
+	if (priv->pending_order) {
+		g_strfreev (priv->pending_order);
+		priv->pending_order = get_key_uris (priv->keys);
+	}
+
+	journal_push (priv->journal_path, g_string_free (record, FALSE));
+
+	if (! priv->compact_id)
+		priv->compact_id = g_timeout_add_seconds (COMPACT_DELAY_SECONDS, compact_cb, this);
+}
+
+/* Orders the layer's items by func, which compares two BookmarkItem pointers,
+ * instead of by the agent.  Items that func finds equal keep the agent's
+ * order among them.
+ */
+void
+bookmark_layer_set_sort_func (BookmarkLayer *this, GCompareDataFunc func, gpointer data)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	priv->sort_func = func;
+	priv->sort_data = data;
+
+	bookmark_layer_refresh (this);
+}
+
+/* Leaves out the agent's items that func turns down.  Pending items are not
+ * filtered, the user put them there.
+ */
+void
+bookmark_layer_set_filter_func (BookmarkLayer *this, BookmarkLayerFilterFunc func, gpointer data)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	priv->filter_func = func;
+	priv->filter_data = data;
+
+	bookmark_layer_refresh (this);
+}
+
+/* Re-reads the agent's items, for when the order the sort function gives or
+ * the items the filter function lets through may have changed without the
+ * agent noticing.  The tables get the difference as deltas.
+ */
+void
+bookmark_layer_refresh (BookmarkLayer *this)
+{
+	agent_notify_cb (NULL, NULL, this);
+}
+
+/* Keeps the user's additions to, removals from and reorderings of this layer
+ * in the journal called name, and replays whatever a previous run left there.
+ */
+void
+bookmark_layer_enable_journal (BookmarkLayer *this, const gchar *name)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	gchar        *basename;
+	gchar        *contents = NULL;
+	gchar        *record   = NULL;
+	gchar       **lines;
+	gchar        *uri;
+	GPtrArray    *keys;
+	BookmarkItem *item;
+
+	gint i;
+
+
+	if (priv->journal_path)
+		return;
+
+	basename = g_strconcat (name, ".journal", NULL);
+	priv->journal_path = g_build_filename (g_get_user_data_dir (), JOURNAL_DIR_NAME, basename, NULL);
+	g_free (basename);
+
+	io_guard_check ("bookmark journal replay");
+
+	if (! g_file_get_contents (priv->journal_path, & contents, NULL, NULL))
+		return;
+
+	/* every order record holds the complete order, so only the last one
+	 * counts, while the add and remove records count in turn; a record
+	 * without its newline was cut short by the crash */
+	lines = g_strsplit (contents, "\n", -1);
+
+	for (i = 0; lines [i] && lines [i + 1]; ++i) {
+		if (g_str_has_prefix (lines [i], JOURNAL_RECORD "\t"))
+			record = lines [i];
+		else if (g_str_has_prefix (lines [i], JOURNAL_ADD_RECORD "\t")) {
+			item = parse_add_record (lines [i] + strlen (JOURNAL_ADD_RECORD "\t"));
+
+			/* the crash may have come after the item reached the store */
+			if (! item)
+				continue;
+
+			if (find_pending_item (this, item->uri) >= 0 || (
+				bookmark_agent_has_item (priv->agent, item->uri) &&
+				find_pending_removal (this, item->uri) < 0))
+				bookmark_item_free (item);
+			else
+				g_ptr_array_add (priv->pending_items, item);
+		}
+		else if (g_str_has_prefix (lines [i], JOURNAL_REMOVE_RECORD "\t")) {
+			uri = g_strcompress (lines [i] + strlen (JOURNAL_REMOVE_RECORD "\t"));
+			remove_uri (this, uri);
+			g_free (uri);
+		}
+	}
+
+	if (record) {
+		priv->pending_order = g_strsplit (record + strlen (JOURNAL_RECORD "\t"), "\t", -1);
+
+		for (i = 0; priv->pending_order [i]; ++i) {
+			uri = g_strcompress (priv->pending_order [i]);
+			g_free (priv->pending_order [i]);
+			priv->pending_order [i] = uri;
+		}
+	}
+
+	if (record || priv->pending_items->len || priv->pending_removals->len) {
+		keys = get_item_keys (priv->items);
+		apply_pending_keys (this, keys);
+
+		if (priv->pending_order) {
+			update_keys (this, order_keys (keys, (const gchar * const *) priv->pending_order));
+			g_ptr_array_free (keys, TRUE);
+		}
+		else
+			update_keys (this, keys);
+
+		priv->compact_id = g_idle_add_full (G_PRIORITY_LOW, compact_cb, this, NULL);
+	}
+
+	g_strfreev (lines);
+	g_free (contents);
+}
+
+/* Returns TRUE if the layer keeps a journal, i.e. if the user edits its list */
+gboolean
+bookmark_layer_has_journal (BookmarkLayer *this)
+{
+	return PRIVATE (this)->journal_path != NULL;
+}
+
+/* Hands the pending changes to the agent right away, for code that is about
+ * to work on the agent directly and has to find it up to date.
+ */
+void
+bookmark_layer_commit (BookmarkLayer *this)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	if (priv->compact_id) {
+		g_source_remove (priv->compact_id);
+		compact_cb (this);
+	}
+}
+
+/* Hands the pending changes to the agent right away and waits for the journal
+ * to be written; meant for shutdown.
+ */
+void
+bookmark_layer_flush (BookmarkLayer *this)
+{
+	bookmark_layer_commit (this);
+
+	journal_sync ();
+}
+
+static void
+bookmark_layer_class_init (BookmarkLayerClass *this_class)
+{
+	GObjectClass *g_obj_class = G_OBJECT_CLASS (this_class);
+
+	g_obj_class->finalize = bookmark_layer_finalize;
+
+	bookmark_layer_signals [ITEMS_CHANGED] = g_signal_new (
+		"items-changed", G_TYPE_FROM_CLASS (this_class),
+		G_SIGNAL_RUN_LAST, G_STRUCT_OFFSET (BookmarkLayerClass, items_changed),
+		NULL, NULL, g_cclosure_marshal_VOID__POINTER, G_TYPE_NONE, 1, G_TYPE_POINTER);
+
+	g_type_class_add_private (this_class, sizeof (BookmarkLayerPrivate));
+}
+
+static void
+bookmark_layer_init (BookmarkLayer *this)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	priv->agent            = NULL;
+	priv->keys             = NULL;
+	priv->items            = NULL;
+	priv->sort_func        = NULL;
+	priv->sort_data        = NULL;
+	priv->filter_func      = NULL;
+	priv->filter_data      = NULL;
+
+	priv->journal_path     = NULL;
+	priv->pending_items    = g_ptr_array_new_with_free_func ((GDestroyNotify) bookmark_item_free);
+	priv->pending_removals = g_ptr_array_new_with_free_func (g_free);
+	priv->pending_order    = NULL;
+	priv->compact_id       = 0;
+}
+
+static void
+bookmark_layer_finalize (GObject *g_obj)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (g_obj);
+
+	if (priv->agent)
+		g_object_weak_unref (G_OBJECT (priv->agent), agent_weak_notify, g_obj);
+
+	if (priv->keys)
+		g_ptr_array_free (priv->keys, TRUE);
+
+	if (priv->compact_id)
+		g_source_remove (priv->compact_id);
+
+	g_free     (priv->items);
+	g_free     (priv->journal_path);
+	g_strfreev (priv->pending_order);
+
+	g_ptr_array_free (priv->pending_items,    TRUE);
+	g_ptr_array_free (priv->pending_removals, TRUE);
+
+	G_OBJECT_CLASS (bookmark_layer_parent_class)->finalize (g_obj);
+}
+
+static void
+agent_weak_notify (gpointer data, GObject *where_the_object_was)
+{
+	PRIVATE (data)->agent = NULL;
+}
+
+static void
+agent_notify_cb (GObject *g_obj, GParamSpec *pspec, gpointer user_data)
+{
+	BookmarkLayer        *this = BOOKMARK_LAYER (user_data);
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	BookmarkItem **items;
+	GPtrArray     *keys;
+	GPtrArray     *rebased;
+
+
+	CHECKPOINT ("bookmark layer: diffing agent items");
+
+	items = get_sorted_items (this);
+	keys  = get_item_keys (items);
+	g_free (items);
+
+	/* the agent does not know about the pending changes and order yet, so
+	 * put them on top of whatever else changed in the store */
+	apply_pending_keys (this, keys);
+
+	if (priv->pending_order) {
+		rebased = order_keys (keys, (const gchar * const *) priv->pending_order);
+		g_ptr_array_free (keys, TRUE);
+		keys = rebased;
+	}
+
+	update_keys (this, keys);
+}
+
+static gboolean
+compact_cb (gpointer data)
+{
+	BookmarkLayer        *this = BOOKMARK_LAYER (data);
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	GPtrArray     *added;
+	GPtrArray     *removed;
+	BookmarkItem  *item;
+	gchar        **order;
+	gchar         *uri;
+	gint           i;
+
+
+	priv->compact_id = 0;
+
+	if (! (priv->pending_order || priv->pending_items->len || priv->pending_removals->len))
+		return FALSE;
+
+	CHECKPOINT ("bookmark layer: compacting journal into the store");
+
+	/* cleared first, as the agent notifies from within the calls */
+	added   = priv->pending_items;
+	removed = priv->pending_removals;
+	order   = priv->pending_order;
+
+	priv->pending_items    = g_ptr_array_new_with_free_func ((GDestroyNotify) bookmark_item_free);
+	priv->pending_removals = g_ptr_array_new_with_free_func (g_free);
+	priv->pending_order    = NULL;
+
+	if (priv->agent) {
+		g_object_freeze_notify (G_OBJECT (priv->agent));
+
+		/* removals first, so that an item removed and added again ends up
+		 * where the user put it the second time */
+		for (i = 0; i < removed->len; ++i) {
+			uri = g_ptr_array_index (removed, i);
+
+			if (bookmark_agent_has_item (priv->agent, uri))
+				bookmark_agent_remove_item (priv->agent, uri);
+		}
+
+		for (i = 0; i < added->len; ++i) {
+			item = g_ptr_array_index (added, i);
+
+			/* adding it again would move it to the end */
+			if (! bookmark_agent_has_item (priv->agent, item->uri))
+				bookmark_agent_add_item (priv->agent, item);
+		}
+
+		if (order)
+			bookmark_agent_reorder_items (priv->agent, (const gchar **) order);
+
+		g_object_thaw_notify (G_OBJECT (priv->agent));
+	}
+
+	/* the snapshot may still point at the added items, and an agent that
+	 * turned some of them down does not notify */
+	if (added->len)
+		agent_notify_cb (NULL, NULL, this);
+
+	g_ptr_array_free (added,   TRUE);
+	g_ptr_array_free (removed, TRUE);
+	g_strfreev (order);
+
+	journal_push (priv->journal_path, NULL);
+
+	return FALSE;
+}
+
+/* Queues record for appending to the journal at path, or with a NULL record,
+ * the truncation of that journal.  Takes ownership of record.
+ */
+static void
+journal_push (const gchar *path, gchar *record)
+{
+	JournalJob *job;
+
+
+	if (! journal_pool)
+		journal_pool = g_thread_pool_new (journal_job_run, NULL, 1, FALSE, NULL);
+
+	job = g_new0 (JournalJob, 1);
+
+	job->path   = g_strdup (path);
+	job->record = record;
+
+	g_thread_pool_push (journal_pool, job, NULL);
+}
+
+/* runs in the journal thread */
+static void
+journal_job_run (gpointer data, gpointer user_data)
+{
+	JournalJob *job = data;
+
+	gchar *dir;
+	gint   fd;
+
+
+	if (job->record) {
+		dir = g_path_get_dirname (job->path);
+		g_mkdir_with_parents (dir, 0700);
+		g_free (dir);
+
+		fd = g_open (job->path, O_WRONLY | O_APPEND | O_CREAT, 0600);
+
+		/* a record only counts once it is on the disk */
+		if (fd >= 0) {
+			if (! write_all (fd, job->record, strlen (job->record)) || fdatasync (fd))
+				g_warning ("could not write to %s", job->path);
+
+			close (fd);
+		}
+	}
+	else
+		g_unlink (job->path);
+
+	g_free (job->path);
+	g_free (job->record);
+	g_free (job);
+}
+
+static gboolean
+write_all (gint fd, const gchar *data, gsize length)
+{
+	gssize written;
+
+
+	while (length > 0) {
+		written = write (fd, data, length);
+
+		if (written < 0 && errno == EINTR)
+			continue;
+
+		if (written <= 0)
+			return FALSE;
+
+		data   += written;
+		length -= written;
+	}
+
+	return TRUE;
+}
+
+static void
+journal_sync (void)
+{
+	if (! journal_pool)
+		return;
+
+	g_thread_pool_free (journal_pool, FALSE, TRUE);
+	journal_pool = NULL;
+}
+
+/* Replaces the snapshot with keys and tells the tables how to get there */
+static void
+update_keys (BookmarkLayer *this, GPtrArray *keys)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	GArray *deltas;
+
+
+	deltas = compute_deltas (priv->keys, keys);
+
+	g_ptr_array_free (priv->keys, TRUE);
+	priv->keys = keys;
+
+	update_items (this);
+
+	if (deltas && deltas->len == 0) {
+		g_array_free (deltas, TRUE);
+
+		return;
+	}
+
+	g_signal_emit (this, bookmark_layer_signals [ITEMS_CHANGED], 0, deltas);
+
+	if (deltas)
+		g_array_free (deltas, TRUE);
+}
+
+static BookmarkItem **
+get_agent_items (BookmarkLayer *this)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	BookmarkItem **items = NULL;
+
+
+	if (priv->agent)
+		g_object_get (G_OBJECT (priv->agent), BOOKMARK_AGENT_ITEMS_PROP, & items, NULL);
+
+	return items;
+}
+
+/* Returns a copy of the agent's item array, without the items the filter
+ * function turns down and ordered by the sort function, if there are any.
+ * Free it with g_free ().
+ */
+static BookmarkItem **
+get_sorted_items (BookmarkLayer *this)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	BookmarkItem **agent_items;
+	BookmarkItem **items;
+	gint           n_items;
+
+	gint i;
+
+
+	agent_items = get_agent_items (this);
+
+	for (n_items = 0; agent_items && agent_items [n_items]; ++n_items)
+		;
+
+	items = g_new0 (BookmarkItem *, n_items + 1);
+
+	for (i = 0, n_items = 0; agent_items && agent_items [i]; ++i)
+		if (! priv->filter_func || priv->filter_func (agent_items [i], priv->filter_data))
+			items [n_items++] = agent_items [i];
+
+	if (priv->sort_func)
+		g_qsort_with_data (items, n_items, sizeof (BookmarkItem *), priv->sort_func, priv->sort_data);
+
+	return items;
+}
+
+/* Rebuilds priv->items, the agent's items in the order of priv->keys.  It has
+ * to be redone on every notification even if the order stays, as the agent
+ * replaces its items whenever it reloads the store.
+ */
+static void
+update_items (BookmarkLayer *this)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	BookmarkItem **agent_items;
+	GHashTable    *by_uri;
+	BookmarkItem  *item;
+	gchar         *key;
+	gchar         *uri;
+
+	gint i;
+	gint n;
+
+
+	agent_items = get_agent_items (this);
+
+	by_uri = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (i = 0; i < priv->pending_items->len; ++i) {
+		item = g_ptr_array_index (priv->pending_items, i);
+		g_hash_table_insert (by_uri, item->uri, item);
+	}
+
+	for (i = 0; agent_items && agent_items [i]; ++i)
+		g_hash_table_insert (by_uri, agent_items [i]->uri, agent_items [i]);
+
+	g_free (priv->items);
+	priv->items = g_new0 (BookmarkItem *, priv->keys->len + 1);
+
+	for (i = 0, n = 0; i < priv->keys->len; ++i) {
+		key = g_ptr_array_index (priv->keys, i);
+		uri = g_strndup (key, strcspn (key, "\n"));
+
+		if ((item = g_hash_table_lookup (by_uri, uri)))
+			priv->items [n++] = item;
+
+		g_free (uri);
+	}
+
+	g_hash_table_destroy (by_uri);
+}
+
+/* Returns a copy of keys in which the items named in uris have traded places
+ * among the slots they hold, so that they appear in the order of uris.  Items
+ * that uris does not name keep their slots.
+ */
+static GPtrArray *
+order_keys (GPtrArray *keys, const gchar * const *uris)
+{
+	GHashTable *unnamed;
+	GPtrArray  *named;
+	GPtrArray  *ordered;
+	gchar      *key;
+	gchar      *uri;
+
+	gint i;
+	gint n;
+
+
+	/* maps the uri of every item to its key, until the item turns out to be
+	 * one of the named ones */
+	unnamed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	for (i = 0; i < keys->len; ++i) {
+		key = g_ptr_array_index (keys, i);
+		g_hash_table_insert (unnamed, g_strndup (key, strcspn (key, "\n")), key);
+	}
+
+	named = g_ptr_array_new ();
+
+	for (i = 0; uris && uris [i]; ++i) {
+		if ((key = g_hash_table_lookup (unnamed, uris [i]))) {
+			g_ptr_array_add (named, key);
+			g_hash_table_remove (unnamed, uris [i]);
+		}
+	}
+
+	ordered = g_ptr_array_new_with_free_func (g_free);
+
+	for (i = 0, n = 0; i < keys->len; ++i) {
+		key = g_ptr_array_index (keys, i);
+		uri = g_strndup (key, strcspn (key, "\n"));
+
+		if (g_hash_table_lookup (unnamed, uri))
+			g_ptr_array_add (ordered, g_strdup (key));
+		else
+			g_ptr_array_add (ordered, g_strdup (g_ptr_array_index (named, n++)));
+
+		g_free (uri);
+	}
+
+	g_ptr_array_free (named, TRUE);
+	g_hash_table_destroy (unnamed);
+
+	return ordered;
+}
+
+/* Returns the uris of keys, in order */
+static gchar **
+get_key_uris (GPtrArray *keys)
+{
+	gchar **uris;
+	gchar  *key;
+	gint    i;
+
+
+	uris = g_new0 (gchar *, keys->len + 1);
+
+	for (i = 0; i < keys->len; ++i) {
+		key = g_ptr_array_index (keys, i);
+		uris [i] = g_strndup (key, strcspn (key, "\n"));
+	}
+
+	return uris;
+}
+
+/* An item's key covers everything a tile shows, so an item that kept its uri
+ * but changed otherwise comes out as removed and inserted again, and gets a
+ * fresh tile.
+ */
+static GPtrArray *
+get_item_keys (BookmarkItem **items)
+{
+	GPtrArray *keys;
+	gint       i;
+
+
+	keys = g_ptr_array_new_with_free_func (g_free);
+
+	for (i = 0; items && items [i]; ++i)
+		g_ptr_array_add (keys, get_item_key (items [i]));
+
+	return keys;
+}
+
+static gchar *
+get_item_key (const BookmarkItem *item)
+{
+	return g_strdup_printf (
+		"%s\n%s\n%s\n%s\n%ld", item->uri,
+		item->title     ? item->title     : "",
+		item->mime_type ? item->mime_type : "",
+		item->icon      ? item->icon      : "",
+		(glong) item->mtime);
+}
+
+/* Returns the index of the key for uri, or -1 */
+static gint
+find_key (GPtrArray *keys, const gchar *uri)
+{
+	gchar *key;
+	gsize  len;
+	gint   i;
+
+
+	len = strlen (uri);
+
+	for (i = 0; i < keys->len; ++i) {
+		key = g_ptr_array_index (keys, i);
+
+		if (! strncmp (key, uri, len) && key [len] == '\n')
+			return i;
+	}
+
+	return -1;
+}
+
+/* Drops the keys of the pending removals from keys, then appends those of
+ * the pending items that keys does not hold yet.
+ */
+static void
+apply_pending_keys (BookmarkLayer *this, GPtrArray *keys)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	BookmarkItem *item;
+	gint          index;
+	gint          i;
+
+
+	for (i = 0; i < priv->pending_removals->len; ++i)
+		if ((index = find_key (keys, g_ptr_array_index (priv->pending_removals, i))) >= 0)
+			g_ptr_array_remove_index (keys, index);
+
+	for (i = 0; i < priv->pending_items->len; ++i) {
+		item = g_ptr_array_index (priv->pending_items, i);
+
+		if (find_key (keys, item->uri) < 0)
+			g_ptr_array_add (keys, get_item_key (item));
+	}
+}
+
+static gint
+find_pending_item (BookmarkLayer *this, const gchar *uri)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	BookmarkItem *item;
+	gint          i;
+
+
+	for (i = 0; i < priv->pending_items->len; ++i) {
+		item = g_ptr_array_index (priv->pending_items, i);
+
+		if (! strcmp (item->uri, uri))
+			return i;
+	}
+
+	return -1;
+}
+
+static gint
+find_pending_removal (BookmarkLayer *this, const gchar *uri)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	gint i;
+
+
+	for (i = 0; i < priv->pending_removals->len; ++i)
+		if (! strcmp (g_ptr_array_index (priv->pending_removals, i), uri))
+			return i;
+
+	return -1;
+}
+
+/* Replays a remove record.  Only for the replay, before the snapshot takes
+ * in the pending changes, as it frees pending items outright.
+ */
+static void
+remove_uri (BookmarkLayer *this, const gchar *uri)
+{
+	BookmarkLayerPrivate *priv = PRIVATE (this);
+
+	gint index;
+
+
+	if ((index = find_pending_item (this, uri)) >= 0)
+		g_ptr_array_remove_index (priv->pending_items, index);
+	else if (bookmark_agent_has_item (priv->agent, uri) && find_pending_removal (this, uri) < 0)
+		g_ptr_array_add (priv->pending_removals, g_strdup (uri));
+}
+
+static BookmarkItem *
+copy_item (const BookmarkItem *item)
+{
+	BookmarkItem *copy;
+
+
+	copy = g_new0 (BookmarkItem, 1);
+
+	copy->uri       = g_strdup (item->uri);
+	copy->title     = g_strdup (item->title);
+	copy->mime_type = g_strdup (item->mime_type);
+	copy->mtime     = item->mtime;
+	copy->icon      = g_strdup (item->icon);
+	copy->app_name  = g_strdup (item->app_name);
+	copy->app_exec  = g_strdup (item->app_exec);
+
+	return copy;
+}
+
+/* An add record holds the fields of one item, escaped so that none of them
+ * carries a tab or a newline, with an empty field for a missing one.
+ */
+static void
+append_add_record (GString *record, const BookmarkItem *item)
+{
+	const gchar *fields [6];
+	gchar       *escaped;
+	gint         i;
+
+
+	fields [0] = item->uri;
+	fields [1] = item->title;
+	fields [2] = item->mime_type;
+	fields [3] = item->icon;
+	fields [4] = item->app_name;
+	fields [5] = item->app_exec;
+
+	g_string_append_printf (record, JOURNAL_ADD_RECORD "\t%ld", (glong) item->mtime);
+
+	for (i = 0; i < G_N_ELEMENTS (fields); ++i) {
+		escaped = g_strescape (fields [i] ? fields [i] : "", NULL);
+
+		g_string_append_c (record, '\t');
+		g_string_append   (record, escaped);
+
+		g_free (escaped);
+	}
+
+	g_string_append_c (record, '\n');
+}
+
+static BookmarkItem *
+parse_add_record (const gchar *record)
+{
+	BookmarkItem  *item;
+	gchar        **fields;
+	gchar         *field [6];
+	gint           i;
+
+
+	fields = g_strsplit (record, "\t", -1);
+
+	if (g_strv_length (fields) != 7 || ! fields [1][0] || ! fields [3][0]) {
+		g_strfreev (fields);
+
+		return NULL;
+	}
+
+	for (i = 0; i < G_N_ELEMENTS (field); ++i)
+		field [i] = fields [i + 1][0] ? g_strcompress (fields [i + 1]) : NULL;
+
+	item = g_new0 (BookmarkItem, 1);
+
+	item->mtime     = (time_t) g_ascii_strtoll (fields [0], NULL, 10);
+	item->uri       = field [0];
+	item->title     = field [1];
+	item->mime_type = field [2];
+	item->icon      = field [3];
+	item->app_name  = field [4];
+	item->app_exec  = field [5];
+
+	g_strfreev (fields);
+
+	return item;
+}
+
+static void
+append_delta (GArray *deltas, BookmarkDeltaType type, gint from, gint to)
+{
+	BookmarkDelta delta;
+
+
+	delta.type = type;
+	delta.from = from;
+	delta.to   = to;
+
+	g_array_append_val (deltas, delta);
+}
+
+/* Builds the edit script that turns old_keys into new_keys: first every item
+ * that is gone is removed, back to front, then the list is walked front to
+ * back and each position that does not hold its final item yet gets it, by
+ * moving it up from further down or by inserting it.  Returns NULL if that
+ * takes more steps than there are items, as the tables are quicker to reload
+ * then.
+ */
+static GArray *
+compute_deltas (GPtrArray *old_keys, GPtrArray *new_keys)
+{
+	GArray     *deltas;
+	GPtrArray  *work;
+	GHashTable *wanted;
+
+	gint i;
+	gint j;
+
+
+	deltas = g_array_new (FALSE, FALSE, sizeof (BookmarkDelta));
+	work   = g_ptr_array_sized_new (old_keys->len);
+	wanted = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (i = 0; i < new_keys->len; ++i)
+		g_hash_table_insert (wanted, g_ptr_array_index (new_keys, i), GINT_TO_POINTER (TRUE));
+
+	for (i = 0; i < old_keys->len; ++i)
+		g_ptr_array_add (work, g_ptr_array_index (old_keys, i));
+
+	for (i = work->len - 1; i >= 0; --i) {
+		if (! g_hash_table_lookup (wanted, g_ptr_array_index (work, i))) {
+			append_delta (deltas, BOOKMARK_DELTA_REMOVED, i, -1);
+			g_ptr_array_remove_index (work, i);
+		}
+	}
+
+	for (i = 0; i < new_keys->len && deltas->len <= new_keys->len; ++i) {
+		if (i < work->len && ! strcmp (g_ptr_array_index (work, i), g_ptr_array_index (new_keys, i)))
+			continue;
+
+		for (j = i + 1; j < work->len; ++j)
+			if (! strcmp (g_ptr_array_index (work, j), g_ptr_array_index (new_keys, i)))
+				break;
+
+		if (j < work->len) {
+			append_delta (deltas, BOOKMARK_DELTA_MOVED, j, i);
+			g_ptr_array_remove_index (work, j);
+		}
+		else
+			append_delta (deltas, BOOKMARK_DELTA_INSERTED, -1, i);
+
+		g_ptr_array_add (work, NULL);
+		memmove (
+			& work->pdata [i + 1], & work->pdata [i],
+			(work->len - i - 1) * sizeof (gpointer));
+		work->pdata [i] = g_ptr_array_index (new_keys, i);
+	}
+
+	g_hash_table_destroy (wanted);
+	g_ptr_array_free (work, TRUE);
+
+	if (deltas->len > new_keys->len) {
+		g_array_free (deltas, TRUE);
+
+		return NULL;
+	}
+
+	return deltas;
+}
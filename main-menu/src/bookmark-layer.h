@@ -0,0 +1,86 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef __BOOKMARK_LAYER_H__
+#define __BOOKMARK_LAYER_H__
+
+#include <libslab/slab.h>
+
+G_BEGIN_DECLS
+
+#define BOOKMARK_LAYER_TYPE         (bookmark_layer_get_type ())
+#define BOOKMARK_LAYER(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), BOOKMARK_LAYER_TYPE, BookmarkLayer))
+#define BOOKMARK_LAYER_CLASS(c)     (G_TYPE_CHECK_CLASS_CAST ((c), BOOKMARK_LAYER_TYPE, BookmarkLayerClass))
+#define IS_BOOKMARK_LAYER(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), BOOKMARK_LAYER_TYPE))
+#define IS_BOOKMARK_LAYER_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE ((c), BOOKMARK_LAYER_TYPE))
+#define BOOKMARK_LAYER_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), BOOKMARK_LAYER_TYPE, BookmarkLayerClass))
+
+typedef enum {
+	BOOKMARK_DELTA_INSERTED,
+	BOOKMARK_DELTA_REMOVED,
+	BOOKMARK_DELTA_MOVED
+} BookmarkDeltaType;
+
+/* One step of an edit script.  Steps apply in order, each against the list as
+ * the previous steps left it.  INSERTED uses to, REMOVED uses from, MOVED uses
+ * both.  An item inserted or moved to position i is already at its final
+ * position, so it can be looked up as item i of bookmark_layer_get_items ().
+ */
+typedef struct {
+	BookmarkDeltaType type;
+	gint              from;
+	gint              to;
+} BookmarkDelta;
+
+/* Returns whether item belongs in the layer */
+typedef gboolean (* BookmarkLayerFilterFunc) (BookmarkItem *item, gpointer data);
+
+typedef struct {
+	GObject g_object;
+} BookmarkLayer;
+
+typedef struct {
+	GObjectClass g_object_class;
+
+	void (* items_changed) (BookmarkLayer *, const GArray *);
+} BookmarkLayerClass;
+
+GType bookmark_layer_get_type (void);
+
+BookmarkLayer  *bookmark_layer_get_for_agent (BookmarkAgent *agent);
+BookmarkItem  **bookmark_layer_get_items     (BookmarkLayer *this);
+gboolean        bookmark_layer_has_item      (BookmarkLayer *this, const gchar *uri);
+void            bookmark_layer_reorder_items (BookmarkLayer *this, const gchar **uris);
+void            bookmark_layer_add_items     (BookmarkLayer *this, BookmarkItem **items);
+void            bookmark_layer_remove_items  (BookmarkLayer *this, const gchar **uris);
+
+void            bookmark_layer_set_sort_func (BookmarkLayer *this, GCompareDataFunc func, gpointer data);
+void            bookmark_layer_set_filter_func (BookmarkLayer *this, BookmarkLayerFilterFunc func, gpointer data);
+void            bookmark_layer_refresh       (BookmarkLayer *this);
+
+void            bookmark_layer_enable_journal (BookmarkLayer *this, const gchar *name);
+gboolean        bookmark_layer_has_journal    (BookmarkLayer *this);
+void            bookmark_layer_commit         (BookmarkLayer *this);
+void            bookmark_layer_flush          (BookmarkLayer *this);
+
+G_END_DECLS
+
+#endif
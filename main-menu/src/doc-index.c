@@ -0,0 +1,1088 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+
+#include "doc-index.h"
+
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "app-index.h"
+#include "io-guard.h"
+#include "stall-watchdog.h"
+
+/* A filename index over the user's document directories, so that the search
+ * pane can offer files that were never opened through the recent documents.
+ *
+ * A crawler thread, running at idle I/O priority, walks the directories
+ * breadth first and writes what it finds to INDEX_FILE_NAME in the user's
+ * cache directory: a header, then one record per entry sorted by key, then a
+ * table of the byte trigrams found in the keys, sorted, each pointing to the
+ * ascending list of records whose key holds it, then those lists, and last the
+ * keys and the paths as NUL terminated strings.  The thread that wrote the
+ * file, or at startup one that only loads it, maps it with GMappedFile and
+ * checks every offset in it, so the main loop takes the mapping over without
+ * copying or walking it.  A lookup is a binary search for the names starting
+ * with the query, followed, for queries of three bytes or more, by the
+ * intersection of the lists of the query's trigrams, the way AppIndex does it,
+ * with strstr () only run on the survivors, so it touches no more of the
+ * mapping than the records that can match.  The file is replaced atomically,
+ * so a mapping stays valid while the next one is written.
+ *
+ * Between crawls the first MAX_MONITORED_DIRS directories, the shallow ones,
+ * are watched through GFileMonitor (inotify).  Files created or deleted there
+ * go into an overlay that takes precedence over the mapped file, and a fresh
+ * crawl is scheduled to fold them in, along with whatever changed deeper down.
+ * What changes in the unwatched directories is only found by crawling, so
+ * there is a crawl every PERIODIC_CRAWL_SECONDS regardless, and more often
+ * when there are directories the monitors don't reach.
+ */
+
+#define INDEX_DIR_NAME          "gnome-main-menu"
+#define INDEX_FILE_NAME         "documents.idx"
+#define INDEX_MAGIC             "MMDOCIX2"
+
+#define FIRST_CRAWL_DELAY_SECONDS 30
+#define RECRAWL_DELAY_SECONDS     600
+#define PERIODIC_CRAWL_SECONDS    3600
+#define UNWATCHED_CRAWL_SECONDS   1200
+#define MAX_OVERLAY_ENTRIES       1024
+
+#define MAX_DEPTH               12
+#define MAX_ENTRIES             250000
+#define MAX_MONITORED_DIRS      256
+
+#define TRIGRAM_KEY(s)          (((guchar) (s) [0] << 16) | ((guchar) (s) [1] << 8) | (guchar) (s) [2])
+
+G_DEFINE_TYPE (DocIndex, doc_index, G_TYPE_OBJECT)
+
+typedef struct {
+	gchar   magic [8];
+	guint32 n_records;
+	guint32 n_trigrams;
+	guint32 n_postings;
+	guint32 pool_offset;
+} IndexHeader;
+
+/* offsets into the string pool */
+typedef struct {
+	guint32 key;
+	guint32 path;
+} IndexRecord;
+
+/* postings [start] to postings [start + count - 1] are the records holding
+ * trigram */
+typedef struct {
+	guint32 trigram;
+	guint32 start;
+	guint32 count;
+} IndexTrigram;
+
+typedef struct {
+	gchar *key;
+	gchar *path;
+} CrawlEntry;
+
+typedef struct {
+	gchar *path;
+	gint   depth;
+} CrawlDir;
+
+typedef struct {
+	DocIndex  *index;
+	gchar    **roots;
+	gchar     *index_path;
+	gint64     started;
+
+	GPtrArray   *dirs;
+	gboolean     unwatched;
+	GMappedFile *map;
+} CrawlJob;
+
+/* key is NULL for a deleted path */
+typedef struct {
+	gchar  *key;
+	gint64  time;
+} OverlayEntry;
+
+typedef struct {
+	gchar *index_path;
+
+	GMappedFile        *map;
+	const IndexRecord  *records;
+	guint32             n_records;
+	const IndexTrigram *trigrams;
+	guint32             n_trigrams;
+	const guint32      *postings;
+	const gchar        *pool;
+	gsize               pool_size;
+
+	GHashTable *overlay;
+	GList      *monitors;
+
+	guint    crawl_id;
+	gboolean crawling;
+	gboolean stale;
+} DocIndexPrivate;
+
+enum {
+	CHANGED,
+	LAST_SIGNAL
+};
+
+static guint doc_index_signals [LAST_SIGNAL] = { 0 };
+
+#define PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), DOC_INDEX_TYPE, DocIndexPrivate))
+
+static void         doc_index_finalize    (GObject *);
+static void         start_load            (DocIndex *);
+static gpointer     load_thread           (gpointer);
+static gboolean     load_done_cb          (gpointer);
+static GMappedFile *open_index            (const gchar *);
+static void         install_index         (DocIndex *, GMappedFile *);
+static void         unload_index          (DocIndex *);
+static const gchar *record_string         (DocIndexPrivate *, guint32);
+static const IndexTrigram *find_trigram   (DocIndexPrivate *, const gchar *);
+static void         add_substring_matches (DocIndexPrivate *, const gchar *, guint, GPtrArray *);
+static void         schedule_crawl        (DocIndex *, guint);
+static gboolean     crawl_cb              (gpointer);
+static void         start_crawl           (DocIndex *);
+static gchar      **get_roots             (void);
+static gpointer     crawl_thread          (gpointer);
+static void         crawl_dir             (CrawlJob *, CrawlDir *, GQueue *, GPtrArray *);
+static gboolean     write_index           (const gchar *, GPtrArray *);
+static gint         compare_entries       (gconstpointer, gconstpointer);
+static gint         compare_trigrams      (gconstpointer, gconstpointer);
+static gboolean     crawl_done_cb         (gpointer);
+static void         monitor_dirs          (DocIndex *, GPtrArray *);
+static void         dir_changed_cb        (GFileMonitor *, GFile *, GFile *, GFileMonitorEvent, gpointer);
+static gboolean     is_indexable          (const gchar *);
+static void         crawl_entry_free      (gpointer);
+static void         overlay_entry_free    (gpointer);
+
+static DocIndex *instance = NULL;
+
+DocIndex *
+doc_index_get_instance (void)
+{
+	if (! instance)
+		instance = g_object_new (DOC_INDEX_TYPE, NULL);
+
+	return instance;
+}
+
+/* Returns the paths of up to max files and folders whose name starts with
+ * key, and if key is three bytes or longer, then those whose name contains it
+ * elsewhere.  key must come from app_index_get_key ().  Free the array with
+ * g_ptr_array_free (array, TRUE).
+ */
+GPtrArray *
+doc_index_lookup (DocIndex *this, const gchar *key, guint max)
+{
+	DocIndexPrivate *priv = PRIVATE (this);
+
+	GPtrArray      *matches;
+	GHashTableIter  iter;
+	OverlayEntry   *entry;
+	const gchar    *path;
+	gsize           len;
+
+	guint32 lo;
+	guint32 hi;
+	guint32 mid;
+	guint32 i;
+
+
+	matches = g_ptr_array_new_with_free_func (g_free);
+
+	if (! (key && key [0] && max))
+		return matches;
+
+	len = strlen (key);
+
+	g_hash_table_iter_init (& iter, priv->overlay);
+
+	while (matches->len < max && g_hash_table_iter_next (& iter, (gpointer *) & path, (gpointer *) & entry))
+		if (entry->key && (len >= 3 ? strstr (entry->key, key) != NULL : g_str_has_prefix (entry->key, key)))
+			g_ptr_array_add (matches, g_strdup (path));
+
+	if (! priv->map)
+		return matches;
+
+	/* the names starting with key form one run of the sorted records */
+	lo = 0;
+	hi = priv->n_records;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+
+		if (strncmp (record_string (priv, priv->records [mid].key), key, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (i = lo; i < priv->n_records && matches->len < max; ++i) {
+		if (strncmp (record_string (priv, priv->records [i].key), key, len))
+			break;
+
+		path = record_string (priv, priv->records [i].path);
+
+		if (! g_hash_table_lookup (priv->overlay, path))
+			g_ptr_array_add (matches, g_strdup (path));
+	}
+
+	if (len >= 3 && matches->len < max)
+		add_substring_matches (priv, key, max, matches);
+
+	return matches;
+}
+
+static void
+doc_index_class_init (DocIndexClass *this_class)
+{
+	GObjectClass *g_obj_class = G_OBJECT_CLASS (this_class);
+
+	g_obj_class->finalize = doc_index_finalize;
+
+	doc_index_signals [CHANGED] = g_signal_new (
+		"changed", G_TYPE_FROM_CLASS (this_class),
+		G_SIGNAL_RUN_LAST, G_STRUCT_OFFSET (DocIndexClass, changed),
+		NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+	g_type_class_add_private (this_class, sizeof (DocIndexPrivate));
+}
+
+static void
+doc_index_init (DocIndex *this)
+{
+	DocIndexPrivate *priv = PRIVATE (this);
+
+	priv->index_path = g_build_filename (
+		g_get_user_cache_dir (), INDEX_DIR_NAME, INDEX_FILE_NAME, NULL);
+
+	priv->map        = NULL;
+	priv->records    = NULL;
+	priv->n_records  = 0;
+	priv->trigrams   = NULL;
+	priv->n_trigrams = 0;
+	priv->postings   = NULL;
+	priv->pool       = NULL;
+	priv->pool_size  = 0;
+	priv->overlay    = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, overlay_entry_free);
+	priv->monitors  = NULL;
+	priv->crawl_id  = 0;
+	priv->crawling  = FALSE;
+	priv->stale     = FALSE;
+
+	/* answer from the previous session's index as soon as it is loaded; the
+	 * crawl that brings it up to date can wait until the menu has settled */
+	start_load (this);
+	schedule_crawl (this, FIRST_CRAWL_DELAY_SECONDS);
+}
+
+static void
+doc_index_finalize (GObject *g_obj)
+{
+	DocIndexPrivate *priv = PRIVATE (g_obj);
+
+	monitor_dirs (DOC_INDEX (g_obj), NULL);
+
+	if (priv->crawl_id)
+		g_source_remove (priv->crawl_id);
+
+	unload_index (DOC_INDEX (g_obj));
+
+	g_hash_table_destroy (priv->overlay);
+	g_free (priv->index_path);
+
+	G_OBJECT_CLASS (doc_index_parent_class)->finalize (g_obj);
+}
+
+/* Loads the previous session's index in a thread */
+static void
+start_load (DocIndex *this)
+{
+	DocIndexPrivate *priv = PRIVATE (this);
+
+	CrawlJob *job;
+
+
+	job = g_new0 (CrawlJob, 1);
+
+	job->index      = g_object_ref (this);
+	job->index_path = g_strdup (priv->index_path);
+
+	g_thread_unref (g_thread_new ("doc-index-load", load_thread, job));
+}
+
+/* runs in its own thread */
+static gpointer
+load_thread (gpointer data)
+{
+	CrawlJob *job = data;
+
+
+	io_guard_lower_thread_priority ();
+
+	job->map = open_index (job->index_path);
+
+	g_idle_add (load_done_cb, job);
+
+	return NULL;
+}
+
+static gboolean
+load_done_cb (gpointer data)
+{
+	CrawlJob        *job  = data;
+	DocIndex        *this = job->index;
+	DocIndexPrivate *priv = PRIVATE (this);
+
+
+	/* a crawl that got done first has the newer file */
+	if (job->map && ! priv->map) {
+		install_index (this, job->map);
+
+		g_signal_emit (this, doc_index_signals [CHANGED], 0);
+	}
+	else if (job->map)
+		g_mapped_file_unref (job->map);
+
+	g_free (job->index_path);
+	g_object_unref (this);
+	g_free (job);
+
+	return FALSE;
+}
+
+/* Maps the index file and checks it.  Returns NULL if there is no valid one.
+ * Safe to call from any thread.
+ */
+static GMappedFile *
+open_index (const gchar *index_path)
+{
+	GMappedFile        *map;
+	const gchar        *contents;
+	const IndexHeader  *header;
+	const IndexRecord  *records;
+	const IndexTrigram *trigrams;
+	gsize               size;
+	gsize               pool_size;
+	guint64             pool_offset;
+
+	guint32 i;
+
+
+	map = g_mapped_file_new (index_path, FALSE, NULL);
+
+	if (! map)
+		return NULL;
+
+	contents = g_mapped_file_get_contents (map);
+	size     = g_mapped_file_get_length (map);
+	header   = (const IndexHeader *) contents;
+
+	if (size < sizeof (IndexHeader) || memcmp (header->magic, INDEX_MAGIC, sizeof (header->magic)))
+		goto invalid;
+
+	pool_offset =
+		sizeof (IndexHeader) +
+		(guint64) header->n_records  * sizeof (IndexRecord) +
+		(guint64) header->n_trigrams * sizeof (IndexTrigram) +
+		(guint64) header->n_postings * sizeof (guint32);
+
+	if (header->pool_offset != pool_offset || pool_offset >= size || contents [size - 1])
+		goto invalid;
+
+	records   = (const IndexRecord *) (contents + sizeof (IndexHeader));
+	trigrams  = (const IndexTrigram *) (records + header->n_records);
+	pool_size = size - header->pool_offset;
+
+	/* with every offset inside the pool and the pool NUL terminated, no
+	 * string read from it can run off the end; the record ids in the lists
+	 * are checked as they are read */
+	for (i = 0; i < header->n_records; ++i)
+		if (records [i].key >= pool_size || records [i].path >= pool_size)
+			goto invalid;
+
+	for (i = 0; i < header->n_trigrams; ++i)
+		if ((guint64) trigrams [i].start + trigrams [i].count > header->n_postings)
+			goto invalid;
+
+	return map;
+
+invalid:
+
+	g_mapped_file_unref (map);
+
+	return NULL;
+}
+
+/* Takes over map, which open_index () has checked, in place of the current one */
+static void
+install_index (DocIndex *this, GMappedFile *map)
+{
+	DocIndexPrivate *priv = PRIVATE (this);
+
+	const gchar       *contents;
+	const IndexHeader *header;
+
+
+	CHECKPOINT ("doc index: installing index file");
+
+	unload_index (this);
+
+	contents = g_mapped_file_get_contents (map);
+	header   = (const IndexHeader *) contents;
+
+	priv->map        = map;
+	priv->records    = (const IndexRecord *) (contents + sizeof (IndexHeader));
+	priv->n_records  = header->n_records;
+	priv->trigrams   = (const IndexTrigram *) (priv->records + header->n_records);
+	priv->n_trigrams = header->n_trigrams;
+	priv->postings   = (const guint32 *) (priv->trigrams + header->n_trigrams);
+	priv->pool       = contents + header->pool_offset;
+	priv->pool_size  = g_mapped_file_get_length (map) - header->pool_offset;
+}
+
+static void
+unload_index (DocIndex *this)
+{
+	DocIndexPrivate *priv = PRIVATE (this);
+
+	if (priv->map)
+		g_mapped_file_unref (priv->map);
+
+	priv->map        = NULL;
+	priv->records    = NULL;
+	priv->n_records  = 0;
+	priv->trigrams   = NULL;
+	priv->n_trigrams = 0;
+	priv->postings   = NULL;
+	priv->pool       = NULL;
+	priv->pool_size  = 0;
+}
+
+static const gchar *
+record_string (DocIndexPrivate *priv, guint32 offset)
+{
+	return priv->pool + offset;
+}
+
+/* Returns the table entry of the trigram at s, or NULL if no key holds it */
+static const IndexTrigram *
+find_trigram (DocIndexPrivate *priv, const gchar *s)
+{
+	guint32 trigram = TRIGRAM_KEY (s);
+	guint32 lo;
+	guint32 hi;
+	guint32 mid;
+
+
+	lo = 0;
+	hi = priv->n_trigrams;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+
+		if (priv->trigrams [mid].trigram < trigram)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == priv->n_trigrams || priv->trigrams [lo].trigram != trigram)
+		return NULL;
+
+	return & priv->trigrams [lo];
+}
+
+/* Adds the names holding key anywhere but at their start, up to max matches.
+ * Every trigram of key has to be present, so the shortest list is walked and
+ * the others probed with a cursor each, as all lists are sorted.
+ */
+static void
+add_substring_matches (DocIndexPrivate *priv, const gchar *key, guint max, GPtrArray *matches)
+{
+	const IndexTrigram **lists;
+	const IndexTrigram  *shortest = NULL;
+	const gchar         *name;
+	const gchar         *match;
+	const gchar         *path;
+
+	guint32 *cursors;
+	guint32  id;
+	guint32  i;
+	gint     n_trigrams;
+	gint     j;
+
+
+	n_trigrams = strlen (key) - 2;
+
+	lists   = g_new0 (const IndexTrigram *, n_trigrams);
+	cursors = g_new0 (guint32, n_trigrams);
+
+	for (j = 0; j < n_trigrams; ++j) {
+		if (! (lists [j] = find_trigram (priv, key + j)))
+			goto out;
+
+		if (! shortest || lists [j]->count < shortest->count)
+			shortest = lists [j];
+	}
+
+	for (i = 0; i < shortest->count && matches->len < max; ++i) {
+		id = priv->postings [shortest->start + i];
+
+		for (j = 0; j < n_trigrams; ++j) {
+			while (cursors [j] < lists [j]->count && priv->postings [lists [j]->start + cursors [j]] < id)
+				cursors [j]++;
+
+			if (cursors [j] == lists [j]->count || priv->postings [lists [j]->start + cursors [j]] != id)
+				break;
+		}
+
+		if (j < n_trigrams || id >= priv->n_records)
+			continue;
+
+		/* the trigrams may sit in different places of the name */
+		name  = record_string (priv, priv->records [id].key);
+		match = strstr (name, key);
+
+		if (! match || match == name)
+			continue;
+
+		path = record_string (priv, priv->records [id].path);
+
+		if (! g_hash_table_lookup (priv->overlay, path))
+			g_ptr_array_add (matches, g_strdup (path));
+	}
+
+out:
+
+	g_free (cursors);
+	g_free (lists);
+}
+
+static void
+schedule_crawl (DocIndex *this, guint delay)
+{
+	DocIndexPrivate *priv = PRIVATE (this);
+
+	if (! priv->crawl_id)
+		priv->crawl_id = g_timeout_add_seconds_full (G_PRIORITY_LOW, delay, crawl_cb, this, NULL);
+}
+
+static gboolean
+crawl_cb (gpointer data)
+{
+	PRIVATE (data)->crawl_id = 0;
+
+	start_crawl (DOC_INDEX (data));
+
+	return FALSE;
+}
+
+static void
+start_crawl (DocIndex *this)
+{
+	DocIndexPrivate *priv = PRIVATE (this);
+
+	CrawlJob *job;
+
+
+	if (priv->crawling) {
+		priv->stale = TRUE;
+
+		return;
+	}
+
+	priv->crawling = TRUE;
+	priv->stale    = FALSE;
+
+	job = g_new0 (CrawlJob, 1);
+
+	job->index      = g_object_ref (this);
+	job->roots      = get_roots ();
+	job->index_path = g_strdup (priv->index_path);
+	job->started    = g_get_monotonic_time ();
+	job->dirs       = g_ptr_array_new_with_free_func (g_free);
+
+	g_thread_unref (g_thread_new ("doc-index", crawl_thread, job));
+}
+
+/* The XDG document directories, leaving out the ones that are unset, which
+ * makes them fall back to the home directory, and the ones inside another.
+ */
+static gchar **
+get_roots (void)
+{
+	static const GUserDirectory dirs [] = {
+		G_USER_DIRECTORY_DOCUMENTS,
+		G_USER_DIRECTORY_DESKTOP,
+		G_USER_DIRECTORY_DOWNLOAD
+	};
+
+	GPtrArray   *roots;
+	const gchar *dir;
+	gchar       *prefix;
+
+	gint i;
+	gint j;
+
+
+	roots = g_ptr_array_new ();
+
+	for (i = 0; i < G_N_ELEMENTS (dirs); ++i) {
+		dir = g_get_user_special_dir (dirs [i]);
+
+		if (! dir || ! strcmp (dir, g_get_home_dir ()))
+			continue;
+
+		for (j = 0; j < roots->len; ++j) {
+			prefix = g_strconcat (g_ptr_array_index (roots, j), G_DIR_SEPARATOR_S, NULL);
+
+			if (! strcmp (dir, g_ptr_array_index (roots, j)) || g_str_has_prefix (dir, prefix)) {
+				g_free (prefix);
+
+				break;
+			}
+
+			g_free (prefix);
+		}
+
+		if (j == roots->len)
+			g_ptr_array_add (roots, g_strdup (dir));
+	}
+
+	g_ptr_array_add (roots, NULL);
+
+	return (gchar **) g_ptr_array_free (roots, FALSE);
+}
+
+/* runs in its own thread */
+static gpointer
+crawl_thread (gpointer data)
+{
+	CrawlJob  *job = data;
+	GPtrArray *entries;
+	GQueue    *pending;
+	CrawlDir  *dir;
+
+	gint i;
+
+
+	io_guard_lower_thread_priority ();
+
+	entries = g_ptr_array_new_with_free_func (crawl_entry_free);
+	pending = g_queue_new ();
+
+	for (i = 0; job->roots [i]; ++i) {
+		dir = g_new0 (CrawlDir, 1);
+		dir->path = g_strdup (job->roots [i]);
+
+		g_queue_push_tail (pending, dir);
+	}
+
+	/* breadth first, so that the directories we get to watch are the ones
+	 * closest to the roots */
+	while ((dir = g_queue_pop_head (pending))) {
+		if (entries->len < MAX_ENTRIES)
+			crawl_dir (job, dir, pending, entries);
+
+		g_free (dir->path);
+		g_free (dir);
+	}
+
+	g_queue_free (pending);
+
+	if (write_index (job->index_path, entries))
+		job->map = open_index (job->index_path);
+
+	g_ptr_array_free (entries, TRUE);
+
+	g_idle_add (crawl_done_cb, job);
+
+	return NULL;
+}
+
+static void
+crawl_dir (CrawlJob *job, CrawlDir *dir, GQueue *pending, GPtrArray *entries)
+{
+	DIR           *handle;
+	struct dirent *dirent;
+	struct stat    info;
+	CrawlEntry    *entry;
+	CrawlDir      *subdir;
+	gchar         *path;
+	gchar         *name;
+	gboolean       is_dir;
+
+
+	if (! (handle = opendir (dir->path)))
+		return;
+
+	if (job->dirs->len < MAX_MONITORED_DIRS)
+		g_ptr_array_add (job->dirs, g_strdup (dir->path));
+	else
+		job->unwatched = TRUE;
+
+	while (entries->len < MAX_ENTRIES && (dirent = readdir (handle))) {
+		if (! is_indexable (dirent->d_name))
+			continue;
+
+		path = g_build_filename (dir->path, dirent->d_name, NULL);
+
+		/* symbolic links get indexed but never followed */
+#ifdef _DIRENT_HAVE_D_TYPE
+		if (dirent->d_type != DT_UNKNOWN)
+			is_dir = dirent->d_type == DT_DIR;
+		else
+#endif
+			is_dir = ! lstat (path, & info) && S_ISDIR (info.st_mode);
+
+		if (is_dir && dir->depth < MAX_DEPTH) {
+			subdir = g_new0 (CrawlDir, 1);
+			subdir->path  = g_strdup (path);
+			subdir->depth = dir->depth + 1;
+
+			g_queue_push_tail (pending, subdir);
+		}
+
+		name = g_filename_display_name (dirent->d_name);
+
+		entry = g_new0 (CrawlEntry, 1);
+		entry->key  = app_index_get_key (name);
+		entry->path = path;
+
+		g_free (name);
+
+		if (entry->key)
+			g_ptr_array_add (entries, entry);
+		else
+			crawl_entry_free (entry);
+	}
+
+	closedir (handle);
+}
+
+/* Writes entries, which it sorts, in the format described at the top */
+static gboolean
+write_index (const gchar *index_path, GPtrArray *entries)
+{
+	IndexHeader   header;
+	IndexRecord  *records;
+	IndexTrigram *trigrams;
+	GHashTable   *lists;
+	GArray       *list;
+	GArray       *postings;
+	GList        *keys;
+	GList        *node;
+	GByteArray   *pool;
+	GByteArray   *contents;
+	CrawlEntry   *entry;
+	gchar        *dir;
+	gboolean      success;
+	gsize         len;
+
+	GError *error = NULL;
+
+	guint i;
+	guint j;
+
+
+	g_ptr_array_sort (entries, compare_entries);
+
+	/* the records are visited in order, so every list comes out sorted */
+	lists = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_array_unref);
+
+	for (i = 0; i < entries->len; ++i) {
+		entry = g_ptr_array_index (entries, i);
+		len   = strlen (entry->key);
+
+		for (j = 0; j + 2 < len; ++j) {
+			list = g_hash_table_lookup (lists, GUINT_TO_POINTER (TRIGRAM_KEY (entry->key + j)));
+
+			if (! list) {
+				list = g_array_new (FALSE, FALSE, sizeof (guint32));
+				g_hash_table_insert (lists, GUINT_TO_POINTER (TRIGRAM_KEY (entry->key + j)), list);
+			}
+			else if (g_array_index (list, guint32, list->len - 1) == i)
+				continue;
+
+			g_array_append_val (list, i);
+		}
+	}
+
+	keys = g_list_sort (g_hash_table_get_keys (lists), compare_trigrams);
+
+	trigrams = g_new0 (IndexTrigram, g_hash_table_size (lists));
+	postings = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+	for (node = keys, i = 0; node; node = node->next, ++i) {
+		list = g_hash_table_lookup (lists, node->data);
+
+		trigrams [i].trigram = GPOINTER_TO_UINT (node->data);
+		trigrams [i].start   = postings->len;
+		trigrams [i].count   = list->len;
+
+		g_array_append_vals (postings, list->data, list->len);
+	}
+
+	g_list_free (keys);
+
+	records = g_new0 (IndexRecord, entries->len);
+	pool    = g_byte_array_new ();
+
+	/* all keys first, so that the binary search stays on few pages */
+	for (i = 0; i < entries->len; ++i) {
+		entry = g_ptr_array_index (entries, i);
+
+		records [i].key = pool->len;
+		g_byte_array_append (pool, (guint8 *) entry->key, strlen (entry->key) + 1);
+	}
+
+	for (i = 0; i < entries->len; ++i) {
+		entry = g_ptr_array_index (entries, i);
+
+		records [i].path = pool->len;
+		g_byte_array_append (pool, (guint8 *) entry->path, strlen (entry->path) + 1);
+	}
+
+	/* never write an empty pool, which would leave no room for the
+	 * terminating NUL open_index () checks for */
+	if (! pool->len)
+		g_byte_array_append (pool, (guint8 *) "", 1);
+
+	memset (& header, 0, sizeof (header));
+	memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+	header.n_records   = entries->len;
+	header.n_trigrams  = g_hash_table_size (lists);
+	header.n_postings  = postings->len;
+	header.pool_offset =
+		sizeof (IndexHeader) +
+		header.n_records  * sizeof (IndexRecord) +
+		header.n_trigrams * sizeof (IndexTrigram) +
+		header.n_postings * sizeof (guint32);
+
+	contents = g_byte_array_sized_new (header.pool_offset + pool->len);
+	g_byte_array_append (contents, (guint8 *) & header, sizeof (header));
+	g_byte_array_append (contents, (guint8 *) records, header.n_records * sizeof (IndexRecord));
+	g_byte_array_append (contents, (guint8 *) trigrams, header.n_trigrams * sizeof (IndexTrigram));
+	g_byte_array_append (contents, (guint8 *) postings->data, header.n_postings * sizeof (guint32));
+	g_byte_array_append (contents, pool->data, pool->len);
+
+	dir = g_path_get_dirname (index_path);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+
+	success = g_file_set_contents (index_path, (gchar *) contents->data, contents->len, & error);
+
+	if (error) {
+		g_warning ("%s: can't write [%s]: %s\n", G_STRFUNC, index_path, error->message);
+		g_error_free (error);
+	}
+
+	g_byte_array_free (contents, TRUE);
+	g_byte_array_free (pool, TRUE);
+	g_array_free (postings, TRUE);
+	g_hash_table_destroy (lists);
+	g_free (trigrams);
+	g_free (records);
+
+	return success;
+}
+
+static gint
+compare_trigrams (gconstpointer a, gconstpointer b)
+{
+	guint trigram_a = GPOINTER_TO_UINT (a);
+	guint trigram_b = GPOINTER_TO_UINT (b);
+
+	return trigram_a < trigram_b ? -1 : trigram_a > trigram_b;
+}
+
+static gint
+compare_entries (gconstpointer a, gconstpointer b)
+{
+	const CrawlEntry *entry_a = * (CrawlEntry * const *) a;
+	const CrawlEntry *entry_b = * (CrawlEntry * const *) b;
+
+	gint result;
+
+
+	if ((result = strcmp (entry_a->key, entry_b->key)))
+		return result;
+
+	return strcmp (entry_a->path, entry_b->path);
+}
+
+static gboolean
+crawl_done_cb (gpointer data)
+{
+	CrawlJob        *job  = data;
+	DocIndex        *this = job->index;
+	DocIndexPrivate *priv = PRIVATE (this);
+
+	GHashTableIter  iter;
+	OverlayEntry   *entry;
+
+
+	CHECKPOINT ("doc index: swapping in new crawl");
+
+	priv->crawling = FALSE;
+
+	if (job->map) {
+		install_index (this, job->map);
+
+		/* what changed after the crawl began may not be in the file */
+		g_hash_table_iter_init (& iter, priv->overlay);
+
+		while (g_hash_table_iter_next (& iter, NULL, (gpointer *) & entry))
+			if (entry->time < job->started)
+				g_hash_table_iter_remove (& iter);
+
+		monitor_dirs (this, job->dirs);
+
+		g_signal_emit (this, doc_index_signals [CHANGED], 0);
+	}
+
+	if (priv->stale)
+		start_crawl (this);
+	else
+		schedule_crawl (this, job->unwatched ? UNWATCHED_CRAWL_SECONDS : PERIODIC_CRAWL_SECONDS);
+
+	g_strfreev (job->roots);
+	g_free (job->index_path);
+	g_ptr_array_free (job->dirs, TRUE);
+	g_object_unref (this);
+	g_free (job);
+
+	return FALSE;
+}
+
+/* Replaces the watched directories with dirs, or drops them all if NULL */
+static void
+monitor_dirs (DocIndex *this, GPtrArray *dirs)
+{
+	DocIndexPrivate *priv = PRIVATE (this);
+
+	GFileMonitor *monitor;
+	GFile        *dir;
+	GList        *node;
+
+	gint i;
+
+
+	for (node = priv->monitors; node; node = node->next) {
+		g_file_monitor_cancel (G_FILE_MONITOR (node->data));
+		g_object_unref (node->data);
+	}
+
+	g_list_free (priv->monitors);
+	priv->monitors = NULL;
+
+	for (i = 0; dirs && i < dirs->len; ++i) {
+		dir     = g_file_new_for_path (g_ptr_array_index (dirs, i));
+		monitor = g_file_monitor_directory (dir, G_FILE_MONITOR_NONE, NULL, NULL);
+
+		if (monitor) {
+			g_signal_connect (monitor, "changed", G_CALLBACK (dir_changed_cb), this);
+			priv->monitors = g_list_prepend (priv->monitors, monitor);
+		}
+
+		g_object_unref (dir);
+	}
+}
+
+static void
+dir_changed_cb (GFileMonitor *monitor, GFile *file, GFile *other_file,
+                GFileMonitorEvent event_type, gpointer user_data)
+{
+	DocIndex        *this = DOC_INDEX (user_data);
+	DocIndexPrivate *priv = PRIVATE (this);
+
+	OverlayEntry *entry;
+	gchar        *path;
+	gchar        *basename;
+	gchar        *name;
+
+
+	if (event_type != G_FILE_MONITOR_EVENT_CREATED && event_type != G_FILE_MONITOR_EVENT_DELETED)
+		return;
+
+	basename = g_file_get_basename (file);
+
+	if (! (basename && is_indexable (basename) && (path = g_file_get_path (file)))) {
+		g_free (basename);
+
+		return;
+	}
+
+	entry = g_new0 (OverlayEntry, 1);
+	entry->time = g_get_monotonic_time ();
+
+	if (event_type == G_FILE_MONITOR_EVENT_CREATED) {
+		name = g_filename_display_name (basename);
+		entry->key = app_index_get_key (name);
+		g_free (name);
+	}
+
+	g_hash_table_replace (priv->overlay, path, entry);
+	g_free (basename);
+
+	/* new folders are not watched, and deleted ones leave their contents
+	 * behind in the file, until the next crawl */
+	if (g_hash_table_size (priv->overlay) > MAX_OVERLAY_ENTRIES)
+		start_crawl (this);
+	else
+		schedule_crawl (this, RECRAWL_DELAY_SECONDS);
+
+	g_signal_emit (this, doc_index_signals [CHANGED], 0);
+}
+
+/* hidden files and backups stay out of the index */
+static gboolean
+is_indexable (const gchar *basename)
+{
+	return basename [0] && basename [0] != '.' && ! g_str_has_suffix (basename, "~");
+}
+
+static void
+crawl_entry_free (gpointer data)
+{
+	CrawlEntry *entry = data;
+
+	g_free (entry->key);
+	g_free (entry->path);
+	g_free (entry);
+}
+
+static void
+overlay_entry_free (gpointer data)
+{
+	OverlayEntry *entry = data;
+
+	g_free (entry->key);
+	g_free (entry);
+}
@@ -0,0 +1,53 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef __DOC_INDEX_H__
+#define __DOC_INDEX_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define DOC_INDEX_TYPE         (doc_index_get_type ())
+#define DOC_INDEX(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), DOC_INDEX_TYPE, DocIndex))
+#define DOC_INDEX_CLASS(c)     (G_TYPE_CHECK_CLASS_CAST ((c), DOC_INDEX_TYPE, DocIndexClass))
+#define IS_DOC_INDEX(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), DOC_INDEX_TYPE))
+#define IS_DOC_INDEX_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE ((c), DOC_INDEX_TYPE))
+#define DOC_INDEX_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), DOC_INDEX_TYPE, DocIndexClass))
+
+typedef struct {
+	GObject g_object;
+} DocIndex;
+
+typedef struct {
+	GObjectClass g_object_class;
+
+	void (* changed) (DocIndex *);
+} DocIndexClass;
+
+GType doc_index_get_type (void);
+
+DocIndex  *doc_index_get_instance (void);
+GPtrArray *doc_index_lookup       (DocIndex *this, const gchar *key, guint max);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,243 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#include "frecency.h"
+
+#include <math.h>
+#include <string.h>
+#include <libslab/slab.h>
+
+/* Frecency ranks uris by how often and how recently they were used.  Every use
+ * adds one to a score that halves every HALF_LIFE_DAYS, so the score at time t
+ * of a uri last updated at time t0 is
+ *
+ *     score (t) = score (t0) * exp (-lambda * (t - t0))
+ *
+ * Instead of the score we keep its rank, log (score (t0)) + lambda * t0, which
+ * does not change as time passes: two uris compare the same way whenever the
+ * comparison is made, and nothing has to be recomputed as the clock moves.
+ *
+ * The stores, the recently-used store for documents and the usage journal's
+ * for applications, only hold the number of uses and the time of the last
+ * one.  Each update from the store works out how many uses a uri gained
+ * since the previous update and folds just those into its rank, at the time of
+ * the latest one; uris whose count and stamp did not move are left alone.
+ */
+
+#define HALF_LIFE_DAYS 7
+#define LAMBDA         (G_LN2 / (HALF_LIFE_DAYS * 24.0 * 60.0 * 60.0))
+
+G_DEFINE_TYPE (Frecency, frecency, G_TYPE_OBJECT)
+
+typedef struct {
+	GHashTable   *entries;
+	guint         generation;
+	FrecencyKind  sweep_kind;
+} FrecencyPrivate;
+
+typedef struct {
+	guint        count;
+	time_t       stamp;
+	gdouble      rank;
+	guint        generation;
+	FrecencyKind kind;
+} FrecencyEntry;
+
+#define PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), FRECENCY_TYPE, FrecencyPrivate))
+
+static void     frecency_finalize (GObject *);
+static gboolean entry_is_stale    (gpointer, gpointer, gpointer);
+
+static Frecency *instance = NULL;
+
+Frecency *
+frecency_get_instance (void)
+{
+	if (! instance)
+		instance = g_object_new (FRECENCY_TYPE, NULL);
+
+	return instance;
+}
+
+/* Folds the uses of the uris of kind recorded in store into the ranks, the
+ * desktop entries for FRECENCY_APPS and everything else for FRECENCY_DOCS.
+ * Uris of kind that store no longer holds are forgotten, those of the other
+ * kind are left alone.  Returns TRUE if any rank changed.
+ */
+gboolean
+frecency_update_from_store (Frecency *this, GBookmarkFile *store, FrecencyKind kind)
+{
+	FrecencyPrivate *priv = PRIVATE (this);
+
+	FrecencyEntry *entry;
+	gchar        **uris;
+	gchar        **apps;
+	gchar         *mime_type;
+	gboolean       is_app;
+	guint          count;
+	guint          app_count;
+	time_t         stamp;
+	time_t         app_stamp;
+	gdouble        score;
+	gboolean       changed = FALSE;
+
+	gint i;
+	gint j;
+
+
+	priv->generation++;
+
+	uris = g_bookmark_file_get_uris (store, NULL);
+
+	for (i = 0; uris && uris [i]; ++i) {
+		mime_type = g_bookmark_file_get_mime_type (store, uris [i], NULL);
+		is_app    = (mime_type && ! strcmp (mime_type, "application/x-desktop"));
+
+		g_free (mime_type);
+
+		if (is_app != (kind == FRECENCY_APPS))
+			continue;
+
+		apps  = g_bookmark_file_get_applications (store, uris [i], NULL, NULL);
+		count = 0;
+		stamp = g_bookmark_file_get_visited (store, uris [i], NULL);
+
+		for (j = 0; apps && apps [j]; ++j) {
+			if (g_bookmark_file_get_app_info (store, uris [i], apps [j], NULL, & app_count, & app_stamp, NULL)) {
+				count += app_count;
+				stamp  = MAX (stamp, app_stamp);
+			}
+		}
+
+		g_strfreev (apps);
+
+		count = MAX (count, 1);
+
+		entry = g_hash_table_lookup (priv->entries, uris [i]);
+
+		if (! entry) {
+			entry = g_new0 (FrecencyEntry, 1);
+			g_hash_table_insert (priv->entries, g_strdup (uris [i]), entry);
+
+			entry->kind = kind;
+
+			entry->rank = log (count) + LAMBDA * stamp;
+			changed     = TRUE;
+		}
+		else if (count > entry->count && stamp >= entry->stamp) {
+			score = exp (entry->rank - LAMBDA * stamp);
+
+			entry->rank = log (score + (count - entry->count)) + LAMBDA * stamp;
+			changed     = TRUE;
+		}
+		else if (count < entry->count || stamp < entry->stamp) {
+			/* the store was cleared or rewritten; start over */
+			entry->rank = log (count) + LAMBDA * stamp;
+			changed     = TRUE;
+		}
+		else if (stamp > entry->stamp) {
+			/* used without a count of its own, e.g. only visited */
+			score = exp (entry->rank - LAMBDA * stamp);
+
+			entry->rank = log (score + 1.0) + LAMBDA * stamp;
+			changed     = TRUE;
+		}
+
+		entry->count      = count;
+		entry->stamp      = stamp;
+		entry->generation = priv->generation;
+	}
+
+	g_strfreev (uris);
+
+	/* uris that have dropped out of the store */
+	priv->sweep_kind = kind;
+
+	if (g_hash_table_foreach_remove (priv->entries, entry_is_stale, this))
+		changed = TRUE;
+
+	return changed;
+}
+
+gdouble
+frecency_get_rank (Frecency *this, const gchar *uri)
+{
+	FrecencyEntry *entry;
+
+
+	if (! uri)
+		return FRECENCY_RANK_NONE;
+
+	entry = g_hash_table_lookup (PRIVATE (this)->entries, uri);
+
+	return entry ? entry->rank : FRECENCY_RANK_NONE;
+}
+
+/* A GCompareDataFunc for arrays of BookmarkItem pointers, highest rank first */
+gint
+frecency_compare_items (gconstpointer a, gconstpointer b, gpointer this)
+{
+	gdouble rank_a = frecency_get_rank (FRECENCY (this), (* (BookmarkItem **) a)->uri);
+	gdouble rank_b = frecency_get_rank (FRECENCY (this), (* (BookmarkItem **) b)->uri);
+
+
+	if (rank_a == rank_b)
+		return 0;
+
+	return rank_a > rank_b ? -1 : 1;
+}
+
+static void
+frecency_class_init (FrecencyClass *this_class)
+{
+	GObjectClass *g_obj_class = G_OBJECT_CLASS (this_class);
+
+	g_obj_class->finalize = frecency_finalize;
+
+	g_type_class_add_private (this_class, sizeof (FrecencyPrivate));
+}
+
+static void
+frecency_init (Frecency *this)
+{
+	FrecencyPrivate *priv = PRIVATE (this);
+
+	priv->entries    = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	priv->generation = 0;
+	priv->sweep_kind = FRECENCY_DOCS;
+}
+
+static void
+frecency_finalize (GObject *g_obj)
+{
+	g_hash_table_destroy (PRIVATE (g_obj)->entries);
+
+	G_OBJECT_CLASS (frecency_parent_class)->finalize (g_obj);
+}
+
+static gboolean
+entry_is_stale (gpointer key, gpointer value, gpointer user_data)
+{
+	FrecencyEntry   *entry = value;
+	FrecencyPrivate *priv  = PRIVATE (user_data);
+
+	return entry->kind == priv->sweep_kind && entry->generation != priv->generation;
+}
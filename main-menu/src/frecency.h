@@ -0,0 +1,64 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef __FRECENCY_H__
+#define __FRECENCY_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define FRECENCY_TYPE         (frecency_get_type ())
+#define FRECENCY(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), FRECENCY_TYPE, Frecency))
+#define FRECENCY_CLASS(c)     (G_TYPE_CHECK_CLASS_CAST ((c), FRECENCY_TYPE, FrecencyClass))
+#define IS_FRECENCY(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), FRECENCY_TYPE))
+#define IS_FRECENCY_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE ((c), FRECENCY_TYPE))
+#define FRECENCY_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), FRECENCY_TYPE, FrecencyClass))
+
+/* the rank of a uri that was never used */
+#define FRECENCY_RANK_NONE (-G_MAXDOUBLE)
+
+/* Applications and documents come from different stores, see
+ * frecency_update_from_store ().
+ */
+typedef enum {
+	FRECENCY_APPS,
+	FRECENCY_DOCS
+} FrecencyKind;
+
+typedef struct {
+	GObject g_object;
+} Frecency;
+
+typedef struct {
+	GObjectClass g_object_class;
+} FrecencyClass;
+
+GType frecency_get_type (void);
+
+Frecency *frecency_get_instance     (void);
+gboolean  frecency_update_from_store (Frecency *this, GBookmarkFile *store, FrecencyKind kind);
+gdouble   frecency_get_rank          (Frecency *this, const gchar *uri);
+gint      frecency_compare_items     (gconstpointer a, gconstpointer b, gpointer this);
+
+G_END_DECLS
+
+#endif
@@ -54,6 +54,7 @@ typedef struct
 	
 	gdouble capacity_bytes;
 	gdouble available_bytes;	
+	gboolean usage_known;
 
 	guint timeout_notify;
 	
@@ -132,6 +133,35 @@ hard_drive_status_tile_new ()
 	return GTK_WIDGET (tile);
 }
 
+/* Measures the home directory's file system; safe to call from any thread */
+void
+hard_drive_status_get_usage (gdouble * available_bytes, gdouble * capacity_bytes)
+{
+	struct statvfs s;
+
+	if (statvfs (g_get_home_dir (), &s) != 0) {
+		*available_bytes = 0;
+		*capacity_bytes = 0;
+		return;
+	}
+
+	*available_bytes = (gdouble)s.f_frsize * s.f_bavail;
+	*capacity_bytes = (gdouble)s.f_frsize * s.f_blocks;
+}
+
+/* Shows a usage measured elsewhere, e.g. by a worker thread */
+void
+hard_drive_status_tile_set_usage (HardDriveStatusTile * tile, gdouble available_bytes, gdouble capacity_bytes)
+{
+	HardDriveStatusTilePrivate *priv = HARD_DRIVE_STATUS_TILE_GET_PRIVATE (tile);
+
+	priv->available_bytes = available_bytes;
+	priv->capacity_bytes = capacity_bytes;
+	priv->usage_known = TRUE;
+
+	update_tile (tile);
+}
+
 static void
 hard_drive_status_tile_init (HardDriveStatusTile * tile)
 {
@@ -184,16 +214,9 @@ static void
 compute_usage (HardDriveStatusTile * tile)
 {
 	HardDriveStatusTilePrivate *priv = HARD_DRIVE_STATUS_TILE_GET_PRIVATE (tile);
-	struct statvfs s;
 
-	if (statvfs (g_get_home_dir (), &s) != 0) {
-		priv->available_bytes = 0;
-		priv->capacity_bytes = 0;
-		return;
-	}
-
-	priv->available_bytes = (gdouble)s.f_frsize * s.f_bavail;
-	priv->capacity_bytes = (gdouble)s.f_frsize * s.f_blocks;
+	hard_drive_status_get_usage (&priv->available_bytes, &priv->capacity_bytes);
+	priv->usage_known = TRUE;
 }
 
 static gchar *
@@ -224,7 +247,9 @@ update_tile (HardDriveStatusTile * tile)
 	gchar *available;
 	gchar *capacity;
 
-	compute_usage (tile);
+	/* measured by the caller or by the menu's refresh worker otherwise */
+	if (!priv->usage_known)
+		compute_usage (tile);
 
 	available = size_bytes_to_string (priv->available_bytes);
 	capacity = size_bytes_to_string (priv->capacity_bytes);
@@ -247,6 +272,7 @@ timeout_cb (gpointer user_data)
 {
 	HardDriveStatusTile *tile = HARD_DRIVE_STATUS_TILE (user_data);
 
+	compute_usage (tile);
 	update_tile (tile);
 
 	return TRUE;
@@ -48,5 +48,8 @@ GType hard_drive_status_tile_get_type (void);
 
 GtkWidget *hard_drive_status_tile_new (void);
 
+void hard_drive_status_get_usage (gdouble *available_bytes, gdouble *capacity_bytes);
+void hard_drive_status_tile_set_usage (HardDriveStatusTile *tile, gdouble available_bytes, gdouble capacity_bytes);
+
 G_END_DECLS
 #endif
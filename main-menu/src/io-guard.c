@@ -0,0 +1,87 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#include "io-guard.h"
+
+#include <sys/resource.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+/* This only catches the I/O entry points that call io_guard_check (); there
+ * is no portable way of trapping the syscalls themselves from inside the
+ * process.  Run under strace -e trace=file,network for the complete picture.
+ */
+
+static const gchar *active_section = NULL;
+static gint         enabled        = -1;
+
+static gboolean
+io_guard_enabled (void)
+{
+	if (enabled < 0)
+		enabled = (g_getenv (IO_GUARD_ENV_VAR) != NULL);
+
+	return enabled;
+}
+
+void
+io_guard_enter (const gchar *section)
+{
+	if (io_guard_enabled ())
+		active_section = section;
+}
+
+void
+io_guard_leave (void)
+{
+	active_section = NULL;
+}
+
+gboolean
+io_guard_active (void)
+{
+	return active_section != NULL;
+}
+
+void
+io_guard_check (const gchar *operation)
+{
+	if (active_section)
+		g_critical ("I/O in %s: %s", active_section, operation);
+}
+
+/* Makes the calling thread yield the disk and the CPU to everything else, for
+ * the threads that crawl or read ahead in the background.
+ */
+void
+io_guard_lower_thread_priority (void)
+{
+#if defined (__linux__) && defined (SYS_ioprio_set)
+	/* IOPRIO_WHO_PROCESS with 0 for the calling thread, IOPRIO_CLASS_IDLE */
+	syscall (SYS_ioprio_set, 1, 0, 3 << 13);
+
+	/* on Linux the nice value is per thread */
+	setpriority (PRIO_PROCESS, syscall (SYS_gettid), 19);
+#endif
+}
@@ -0,0 +1,44 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef __IO_GUARD_H__
+#define __IO_GUARD_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Set MAIN_MENU_DEBUG_IO in the environment to have io_guard_check () complain
+ * (with g_critical, so G_DEBUG=fatal-criticals turns it into an abort) about
+ * every instrumented I/O operation made while the menu is being presented.
+ */
+#define IO_GUARD_ENV_VAR "MAIN_MENU_DEBUG_IO"
+
+void     io_guard_enter  (const gchar *section);
+void     io_guard_leave  (void);
+gboolean io_guard_active (void);
+void     io_guard_check  (const gchar *operation);
+
+void     io_guard_lower_thread_priority (void);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,867 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+
+#include "launcher.h"
+
+#include <string.h>
+#include <signal.h>
+#include <spawn.h>
+#include <X11/Xlib.h>
+#include <gdk/gdkx.h>
+#include <gio/gdesktopappinfo.h>
+#include <libslab/slab.h>
+
+#include "app-index.h"
+#include "path-cache.h"
+#include "usage-journal.h"
+#include "stall-watchdog.h"
+
+/* Starts applications from their desktop entries, getting the menu out of the
+ * way before anything else happens.
+ *
+ * The first launch of an entry parses it into a LaunchPlan: the Exec line with
+ * its field codes expanded, its program looked up in PATH, and the few keys
+ * that matter for starting it.  Plans are kept until the AppIndex sees the
+ * application directories change.  A launch emits "launching", upon which
+ * the owner hides the menu, and only from idle, with the unmap on its way to
+ * the X server, spawns the plan with posix_spawn ().  Entries a plain spawn
+ * does not do justice to, such as terminal or D-Bus activated applications,
+ * are declined and left to the caller's usual way of launching.
+ *
+ * Every launch with startup notification is timed from the click to the
+ * application's "remove" message on the root window, which toolkits send when
+ * they map their first window.  The times end up per application in
+ * STATS_FILE_NAME, a key file in the user's cache directory.
+ */
+
+#define STATS_DIR_NAME          "gnome-main-menu"
+#define STATS_FILE_NAME         "launch-times"
+#define SAVE_DELAY_SECONDS      10
+
+/* GDK sends "remove" itself when it gives up on a launch after 30 seconds, so
+ * anything that late is not a measurement */
+#define STARTUP_TIMEOUT_SECONDS 30
+
+#define STARTUP_MESSAGE_CHUNK   20
+
+G_DEFINE_TYPE (Launcher, launcher, G_TYPE_OBJECT)
+
+typedef struct {
+	gint             ref_count;
+	GDesktopAppInfo *info;
+	gchar           *id;
+	gchar           *uri;
+	gchar          **argv;
+	gchar           *workdir;
+	gboolean         startup_notify;
+} LaunchPlan;
+
+typedef struct {
+	Launcher   *launcher;
+	LaunchPlan *plan;
+	guint32     time;
+	gint64      clicked;
+} LaunchJob;
+
+typedef struct {
+	gchar  *id;
+	gint64  clicked;
+} PendingStartup;
+
+typedef struct {
+	gchar *path;
+	gchar *contents;
+	gsize  length;
+} SaveJob;
+
+typedef struct {
+	GHashTable *plans;
+	GHashTable *pending;
+	GHashTable *messages;
+	gboolean    watching;
+	Atom        info_begin_atom;
+	Atom        info_atom;
+
+	GKeyFile   *stats;
+	gchar      *stats_path;
+	guint       save_id;
+
+	AppIndex   *index;
+} LauncherPrivate;
+
+enum {
+	LAUNCHING,
+	LAST_SIGNAL
+};
+
+static guint launcher_signals [LAST_SIGNAL] = { 0 };
+
+#define PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), LAUNCHER_TYPE, LauncherPrivate))
+
+static void            launcher_finalize       (GObject *);
+static LaunchPlan     *get_plan                (Launcher *, const gchar *);
+static LaunchPlan     *plan_new                (const gchar *);
+static GDesktopAppInfo *open_entry             (const gchar *, gchar ***);
+static gchar         **expand_exec             (GDesktopAppInfo *, const gchar *);
+static LaunchPlan     *plan_ref                (LaunchPlan *);
+static void            plan_unref              (gpointer);
+static gboolean        spawn_cb                (gpointer);
+static gboolean        spawn_plan              (LaunchPlan *, gchar **, GPid *, GError **);
+static void            reap_cb                 (GPid, gint, gpointer);
+static void            index_changed_cb        (AppIndex *, gpointer);
+static void            watch_startup_messages  (Launcher *);
+static GdkFilterReturn startup_message_filter  (GdkXEvent *, GdkEvent *, gpointer);
+static void            startup_message_cb      (Launcher *, const gchar *);
+static gchar          *get_startup_message_id  (const gchar *);
+static void            expire_pending          (Launcher *);
+static void            record_latency          (Launcher *, const gchar *, gint64);
+static gboolean        save_stats_cb           (gpointer);
+static gpointer        save_stats_thread       (gpointer);
+static gboolean        is_plan_cb              (gpointer, gpointer, gpointer);
+static void            pending_startup_free    (gpointer);
+static void            message_free            (gpointer);
+
+static Launcher *instance = NULL;
+
+Launcher *
+launcher_get_instance (void)
+{
+	if (! instance)
+		instance = g_object_new (LAUNCHER_TYPE, NULL);
+
+	return instance;
+}
+
+/* Launches the application of desktop_entry, which is a desktop file id, path
+ * or uri.  Returns FALSE, before doing anything, if it has to be launched some
+ * other way.
+ */
+gboolean
+launcher_launch (Launcher *this, const gchar *desktop_entry, guint32 time)
+{
+	LaunchPlan *plan;
+	LaunchJob  *job;
+
+
+	if (! desktop_entry)
+		return FALSE;
+
+	CHECKPOINT ("launcher_launch(): preparing launch plan");
+
+	if (! (plan = get_plan (this, desktop_entry)))
+		return FALSE;
+
+	job = g_new0 (LaunchJob, 1);
+
+	job->launcher = g_object_ref (this);
+	job->plan     = plan_ref (plan);
+	job->time     = time;
+	job->clicked  = g_get_monotonic_time ();
+
+	g_signal_emit (this, launcher_signals [LAUNCHING], 0, plan->uri);
+
+	g_idle_add (spawn_cb, job);
+
+	return TRUE;
+}
+
+/* Returns the full path of the program desktop_entry runs, or NULL if it is
+ * not one the launcher would spawn.  Free with g_free ().
+ */
+gchar *
+launcher_get_program (Launcher *this, const gchar *desktop_entry)
+{
+	LaunchPlan *plan;
+
+
+	if (! desktop_entry || ! (plan = get_plan (this, desktop_entry)))
+		return NULL;
+
+	return g_strdup (plan->argv [0]);
+}
+
+/* Same as launcher_get_program (), but safe to call from any thread, as it
+ * neither consults nor fills the launcher's and the PATH lookup's caches.
+ */
+gchar *
+launcher_find_program (const gchar *desktop_entry)
+{
+	GDesktopAppInfo *info;
+	gchar          **argv;
+	gchar           *program;
+
+
+	if (! desktop_entry || ! (info = open_entry (desktop_entry, & argv)))
+		return NULL;
+
+	program = g_find_program_in_path (argv [0]);
+
+	g_strfreev (argv);
+	g_object_unref (info);
+
+	return program;
+}
+
+static void
+launcher_class_init (LauncherClass *this_class)
+{
+	GObjectClass *g_obj_class = G_OBJECT_CLASS (this_class);
+
+	g_obj_class->finalize = launcher_finalize;
+
+	launcher_signals [LAUNCHING] = g_signal_new (
+		"launching", G_TYPE_FROM_CLASS (this_class),
+		G_SIGNAL_RUN_LAST, G_STRUCT_OFFSET (LauncherClass, launching),
+		NULL, NULL, g_cclosure_marshal_VOID__STRING, G_TYPE_NONE, 1, G_TYPE_STRING);
+
+	g_type_class_add_private (this_class, sizeof (LauncherPrivate));
+}
+
+static void
+launcher_init (Launcher *this)
+{
+	LauncherPrivate *priv = PRIVATE (this);
+
+	priv->plans    = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, plan_unref);
+	priv->pending  = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, pending_startup_free);
+	priv->messages = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, message_free);
+	priv->watching = FALSE;
+
+	priv->stats      = NULL;
+	priv->stats_path = g_build_filename (
+		g_get_user_cache_dir (), STATS_DIR_NAME, STATS_FILE_NAME, NULL);
+	priv->save_id    = 0;
+
+	priv->index = g_object_ref (app_index_get_instance ());
+
+	g_signal_connect (
+		G_OBJECT (priv->index), "changed",
+		G_CALLBACK (index_changed_cb), this);
+}
+
+static void
+launcher_finalize (GObject *g_obj)
+{
+	LauncherPrivate *priv = PRIVATE (g_obj);
+
+	if (priv->watching)
+		gdk_window_remove_filter (NULL, startup_message_filter, g_obj);
+
+	if (priv->save_id) {
+		g_source_remove (priv->save_id);
+		save_stats_cb (g_obj);
+	}
+
+	g_hash_table_destroy (priv->plans);
+	g_hash_table_destroy (priv->pending);
+	g_hash_table_destroy (priv->messages);
+
+	if (priv->stats)
+		g_key_file_free (priv->stats);
+
+	g_free (priv->stats_path);
+
+	g_signal_handlers_disconnect_by_func (priv->index, index_changed_cb, g_obj);
+	g_object_unref (priv->index);
+
+	G_OBJECT_CLASS (launcher_parent_class)->finalize (g_obj);
+}
+
+static LaunchPlan *
+get_plan (Launcher *this, const gchar *desktop_entry)
+{
+	LauncherPrivate *priv = PRIVATE (this);
+
+	LaunchPlan *plan;
+
+
+	/* the entries we decline are remembered as well */
+	if (! g_hash_table_lookup_extended (priv->plans, desktop_entry, NULL, (gpointer *) & plan)) {
+		plan = plan_new (desktop_entry);
+		g_hash_table_insert (priv->plans, g_strdup (desktop_entry), plan);
+	}
+
+	return plan;
+}
+
+/* Returns NULL if desktop_entry can't be found or needs more than a spawn */
+static LaunchPlan *
+plan_new (const gchar *desktop_entry)
+{
+	LaunchPlan      *plan;
+	GDesktopAppInfo *info;
+	const gchar     *filename;
+	gchar          **argv;
+	gchar           *program;
+
+
+	if (! (info = open_entry (desktop_entry, & argv)))
+		return NULL;
+
+	filename = g_desktop_app_info_get_filename (info);
+
+	if (! (program = path_cache_lookup (path_cache_get_instance (), argv [0]))) {
+		g_strfreev (argv);
+		g_object_unref (info);
+
+		return NULL;
+	}
+
+	g_free (argv [0]);
+	argv [0] = program;
+
+	plan = g_new0 (LaunchPlan, 1);
+
+	plan->ref_count      = 1;
+	plan->info           = info;
+	plan->uri            = g_filename_to_uri (filename, NULL, NULL);
+	plan->argv           = argv;
+	plan->workdir        = g_desktop_app_info_get_string (info, "Path");
+	plan->startup_notify = g_desktop_app_info_get_boolean (info, "StartupNotify");
+
+	if (g_app_info_get_id (G_APP_INFO (info)))
+		plan->id = g_strdup (g_app_info_get_id (G_APP_INFO (info)));
+	else
+		plan->id = g_path_get_basename (filename);
+
+	if (plan->workdir && ! plan->workdir [0]) {
+		g_free (plan->workdir);
+		plan->workdir = NULL;
+	}
+
+	return plan;
+}
+
+/* Loads desktop_entry and expands its Exec line into argv, whose program is
+ * not looked up in PATH yet.  Returns NULL if desktop_entry can't be found or
+ * needs more than a spawn.  Safe to call from any thread.
+ */
+static GDesktopAppInfo *
+open_entry (const gchar *desktop_entry, gchar ***argv)
+{
+	GDesktopAppInfo *info;
+	const gchar     *filename;
+	gchar           *path = NULL;
+
+
+	if (g_str_has_prefix (desktop_entry, "file://"))
+		path = g_filename_from_uri (desktop_entry, NULL, NULL);
+	else if (g_path_is_absolute (desktop_entry))
+		path = g_strdup (desktop_entry);
+
+	if (path)
+		info = g_desktop_app_info_new_from_filename (path);
+	else
+		info = g_desktop_app_info_new (desktop_entry);
+
+	g_free (path);
+
+	if (! info)
+		return NULL;
+
+	if (
+		g_desktop_app_info_get_boolean (info, "Terminal") ||
+		g_desktop_app_info_get_boolean (info, "DBusActivatable") ||
+		! (filename = g_desktop_app_info_get_filename (info)) ||
+		! (*argv = expand_exec (info, filename))
+	) {
+		g_object_unref (info);
+
+		return NULL;
+	}
+
+	return info;
+}
+
+/* Expands the field codes of the Exec line for a launch without files, see
+ * the Desktop Entry Specification.
+ */
+static gchar **
+expand_exec (GDesktopAppInfo *info, const gchar *filename)
+{
+	GPtrArray   *argv;
+	GString     *arg;
+	gchar      **args;
+	gchar       *icon;
+	const gchar *c;
+
+	gint i;
+
+
+	if (! g_shell_parse_argv (g_app_info_get_commandline (G_APP_INFO (info)), NULL, & args, NULL))
+		return NULL;
+
+	argv = g_ptr_array_new ();
+
+	for (i = 0; args [i]; ++i) {
+		if (! strcmp (args [i], "%i")) {
+			if ((icon = g_desktop_app_info_get_string (info, "Icon"))) {
+				g_ptr_array_add (argv, g_strdup ("--icon"));
+				g_ptr_array_add (argv, icon);
+			}
+
+			continue;
+		}
+
+		arg = g_string_new (NULL);
+
+		for (c = args [i]; *c; ++c) {
+			if (*c != '%' || ! c [1]) {
+				g_string_append_c (arg, *c);
+
+				continue;
+			}
+
+			switch (*++c) {
+				case '%':
+					g_string_append_c (arg, '%');
+					break;
+
+				case 'c':
+					g_string_append (arg, g_app_info_get_name (G_APP_INFO (info)));
+					break;
+
+				case 'k':
+					g_string_append (arg, filename);
+					break;
+
+				/* the file and url codes, with nothing to pass */
+				default:
+					break;
+			}
+		}
+
+		/* a code standing alone expands to no argument at all */
+		if (arg->len || args [i][0] != '%')
+			g_ptr_array_add (argv, g_string_free (arg, FALSE));
+		else
+			g_string_free (arg, TRUE);
+	}
+
+	g_strfreev (args);
+
+	if (! argv->len) {
+		g_ptr_array_free (argv, TRUE);
+
+		return NULL;
+	}
+
+	g_ptr_array_add (argv, NULL);
+
+	return (gchar **) g_ptr_array_free (argv, FALSE);
+}
+
+static LaunchPlan *
+plan_ref (LaunchPlan *plan)
+{
+	plan->ref_count++;
+
+	return plan;
+}
+
+static void
+plan_unref (gpointer data)
+{
+	LaunchPlan *plan = data;
+
+	if (! plan || --plan->ref_count)
+		return;
+
+	g_object_unref (plan->info);
+	g_free (plan->id);
+	g_free (plan->uri);
+	g_strfreev (plan->argv);
+	g_free (plan->workdir);
+	g_free (plan);
+}
+
+static gboolean
+spawn_cb (gpointer data)
+{
+	LaunchJob       *job  = data;
+	Launcher        *this = job->launcher;
+	LauncherPrivate *priv = PRIVATE (this);
+
+	GAppLaunchContext *context    = NULL;
+	gchar             *startup_id = NULL;
+	gchar            **envp;
+	PendingStartup    *pending;
+	GPid               pid;
+
+	GError *error = NULL;
+
+
+	/* make sure the menu is off the screen before the fork */
+	gdk_flush ();
+
+	CHECKPOINT ("launcher: spawning");
+
+	envp = g_get_environ ();
+
+	if (job->plan->startup_notify) {
+		context = G_APP_LAUNCH_CONTEXT (gdk_app_launch_context_new ());
+		gdk_app_launch_context_set_timestamp (GDK_APP_LAUNCH_CONTEXT (context), job->time);
+
+		startup_id = g_app_launch_context_get_startup_notify_id (
+			context, G_APP_INFO (job->plan->info), NULL);
+
+		if (startup_id)
+			envp = g_environ_setenv (envp, "DESKTOP_STARTUP_ID", startup_id, TRUE);
+	}
+
+	if (spawn_plan (job->plan, envp, & pid, & error)) {
+		g_child_watch_add (pid, reap_cb, NULL);
+
+		if (startup_id) {
+			watch_startup_messages (this);
+			expire_pending (this);
+
+			pending = g_new0 (PendingStartup, 1);
+			pending->id      = g_strdup (job->plan->id);
+			pending->clicked = job->clicked;
+
+			g_hash_table_insert (priv->pending, g_strdup (startup_id), pending);
+		}
+
+		usage_journal_record (usage_journal_get_instance (), job->plan->uri);
+	}
+	else {
+		if (startup_id)
+			g_app_launch_context_launch_failed (context, startup_id);
+
+		/* the program may have moved; prepare afresh next time */
+		g_hash_table_foreach_remove (priv->plans, is_plan_cb, job->plan);
+
+		libslab_handle_g_error (
+			& error, "%s: can't launch [%s]\n", G_STRFUNC, job->plan->argv [0]);
+	}
+
+	if (context)
+		g_object_unref (context);
+
+	g_free (startup_id);
+	g_strfreev (envp);
+
+	plan_unref (job->plan);
+	g_object_unref (this);
+	g_free (job);
+
+	return FALSE;
+}
+
+static gboolean
+spawn_plan (LaunchPlan *plan, gchar **envp, GPid *pid, GError **error)
+{
+	posix_spawnattr_t attr;
+	sigset_t          signals;
+	gshort            flags;
+	gint              result;
+
+
+	/* posix_spawn () can't change directories */
+	if (plan->workdir)
+		return g_spawn_async (
+			plan->workdir, plan->argv, envp, G_SPAWN_DO_NOT_REAP_CHILD,
+			NULL, NULL, pid, error);
+
+	posix_spawnattr_init (& attr);
+
+	/* nothing of what the panel blocks or ignores is for the application
+	 * to inherit */
+	sigemptyset (& signals);
+	posix_spawnattr_setsigmask (& attr, & signals);
+
+	sigaddset (& signals, SIGPIPE);
+	posix_spawnattr_setsigdefault (& attr, & signals);
+
+	flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+
+#ifdef POSIX_SPAWN_SETSID
+	/* nor is our session, so that it outlives the panel */
+	flags |= POSIX_SPAWN_SETSID;
+#endif
+
+	posix_spawnattr_setflags (& attr, flags);
+
+	result = posix_spawn (pid, plan->argv [0], NULL, & attr, plan->argv, envp);
+
+	posix_spawnattr_destroy (& attr);
+
+	if (result) {
+		g_set_error (
+			error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+			"%s: %s", plan->argv [0], g_strerror (result));
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+reap_cb (GPid pid, gint status, gpointer user_data)
+{
+	g_spawn_close_pid (pid);
+}
+
+/* applications were installed, removed or changed */
+static void
+index_changed_cb (AppIndex *index, gpointer user_data)
+{
+	g_hash_table_remove_all (PRIVATE (user_data)->plans);
+}
+
+static void
+watch_startup_messages (Launcher *this)
+{
+	LauncherPrivate *priv = PRIVATE (this);
+
+	GdkWindow *root;
+
+
+	if (priv->watching)
+		return;
+
+	priv->info_begin_atom = gdk_x11_get_xatom_by_name ("_NET_STARTUP_INFO_BEGIN");
+	priv->info_atom       = gdk_x11_get_xatom_by_name ("_NET_STARTUP_INFO");
+
+	/* the messages are sent to the root window with this mask */
+	root = gdk_get_default_root_window ();
+	gdk_window_set_events (root, gdk_window_get_events (root) | GDK_PROPERTY_CHANGE_MASK);
+
+	gdk_window_add_filter (NULL, startup_message_filter, this);
+
+	priv->watching = TRUE;
+}
+
+/* Puts the startup notification messages back together, which arrive in
+ * client messages of STARTUP_MESSAGE_CHUNK bytes each, per sending window.
+ */
+static GdkFilterReturn
+startup_message_filter (GdkXEvent *gdk_xevent, GdkEvent *event, gpointer data)
+{
+	LauncherPrivate *priv = PRIVATE (data);
+
+	XEvent      *xevent = gdk_xevent;
+	GString     *message;
+	const gchar *chunk;
+	const gchar *end;
+	gpointer     sender;
+
+
+	if (xevent->type != ClientMessage)
+		return GDK_FILTER_CONTINUE;
+
+	sender = GUINT_TO_POINTER (xevent->xclient.window);
+
+	if (xevent->xclient.message_type == priv->info_begin_atom)
+		g_hash_table_replace (priv->messages, sender, g_string_new (NULL));
+	else if (xevent->xclient.message_type != priv->info_atom)
+		return GDK_FILTER_CONTINUE;
+
+	if (! (message = g_hash_table_lookup (priv->messages, sender)))
+		return GDK_FILTER_CONTINUE;
+
+	chunk = xevent->xclient.data.b;
+	end   = memchr (chunk, '\0', STARTUP_MESSAGE_CHUNK);
+
+	g_string_append_len (message, chunk, end ? end - chunk : STARTUP_MESSAGE_CHUNK);
+
+	if (end) {
+		startup_message_cb (LAUNCHER (data), message->str);
+		g_hash_table_remove (priv->messages, sender);
+	}
+
+	return GDK_FILTER_CONTINUE;
+}
+
+static void
+startup_message_cb (Launcher *this, const gchar *message)
+{
+	LauncherPrivate *priv = PRIVATE (this);
+
+	PendingStartup *pending;
+	gchar          *startup_id;
+	gint64          elapsed;
+
+
+	if (! (startup_id = get_startup_message_id (message)))
+		return;
+
+	if ((pending = g_hash_table_lookup (priv->pending, startup_id))) {
+		elapsed = g_get_monotonic_time () - pending->clicked;
+
+		if (elapsed < (gint64) STARTUP_TIMEOUT_SECONDS * G_USEC_PER_SEC)
+			record_latency (this, pending->id, elapsed / 1000);
+
+		g_hash_table_remove (priv->pending, startup_id);
+	}
+
+	g_free (startup_id);
+}
+
+/* Returns the ID of a "remove" message, or NULL for any other message */
+static gchar *
+get_startup_message_id (const gchar *message)
+{
+	GString     *id;
+	const gchar *c;
+
+
+	if (! g_str_has_prefix (message, "remove:"))
+		return NULL;
+
+	for (c = message + strlen ("remove:"); *c; ++c)
+		if (g_str_has_prefix (c, "ID=") && (c [-1] == ' ' || c [-1] == ':'))
+			break;
+
+	if (! *c)
+		return NULL;
+
+	id = g_string_new (NULL);
+
+	/* values are either quoted, with backslash escapes, or end at a space */
+	if (*(c += strlen ("ID=")) == '"') {
+		for (++c; *c && *c != '"'; ++c) {
+			if (*c == '\\' && c [1])
+				++c;
+
+			g_string_append_c (id, *c);
+		}
+	}
+	else
+		for (; *c && *c != ' '; ++c)
+			g_string_append_c (id, *c);
+
+	return g_string_free (id, FALSE);
+}
+
+/* forgets the launches that never reported back */
+static void
+expire_pending (Launcher *this)
+{
+	LauncherPrivate *priv = PRIVATE (this);
+
+	GHashTableIter  iter;
+	PendingStartup *pending;
+	gint64          now;
+
+
+	now = g_get_monotonic_time ();
+
+	g_hash_table_iter_init (& iter, priv->pending);
+
+	while (g_hash_table_iter_next (& iter, NULL, (gpointer *) & pending))
+		if (now - pending->clicked >= (gint64) STARTUP_TIMEOUT_SECONDS * G_USEC_PER_SEC)
+			g_hash_table_iter_remove (& iter);
+}
+
+static void
+record_latency (Launcher *this, const gchar *id, gint64 msecs)
+{
+	LauncherPrivate *priv = PRIVATE (this);
+
+	gint64 total;
+	gint64 max;
+	gint   launches;
+
+
+	if (! priv->stats) {
+		priv->stats = g_key_file_new ();
+		g_key_file_load_from_file (priv->stats, priv->stats_path, G_KEY_FILE_NONE, NULL);
+	}
+
+	launches = g_key_file_get_integer (priv->stats, id, "launches", NULL);
+	total    = g_key_file_get_int64   (priv->stats, id, "total-ms", NULL);
+	max      = g_key_file_get_int64   (priv->stats, id, "max-ms",   NULL);
+
+	g_key_file_set_integer (priv->stats, id, "launches", launches + 1);
+	g_key_file_set_int64   (priv->stats, id, "total-ms", total + msecs);
+	g_key_file_set_int64   (priv->stats, id, "max-ms",   MAX (max, msecs));
+	g_key_file_set_int64   (priv->stats, id, "last-ms",  msecs);
+
+	if (! priv->save_id)
+		priv->save_id = g_timeout_add_seconds (SAVE_DELAY_SECONDS, save_stats_cb, this);
+}
+
+static gboolean
+save_stats_cb (gpointer data)
+{
+	LauncherPrivate *priv = PRIVATE (data);
+
+	SaveJob *job;
+
+
+	priv->save_id = 0;
+
+	job = g_new0 (SaveJob, 1);
+
+	job->path     = g_strdup (priv->stats_path);
+	job->contents = g_key_file_to_data (priv->stats, & job->length, NULL);
+
+	g_thread_unref (g_thread_new ("launch-times", save_stats_thread, job));
+
+	return FALSE;
+}
+
+/* runs in its own thread */
+static gpointer
+save_stats_thread (gpointer data)
+{
+	SaveJob *job = data;
+
+	gchar *dir;
+
+
+	dir = g_path_get_dirname (job->path);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+
+	g_file_set_contents (job->path, job->contents, job->length, NULL);
+
+	g_free (job->path);
+	g_free (job->contents);
+	g_free (job);
+
+	return NULL;
+}
+
+static gboolean
+is_plan_cb (gpointer key, gpointer value, gpointer user_data)
+{
+	return value == user_data;
+}
+
+static void
+pending_startup_free (gpointer data)
+{
+	PendingStartup *pending = data;
+
+	g_free (pending->id);
+	g_free (pending);
+}
+
+static void
+message_free (gpointer data)
+{
+	g_string_free ((GString *) data, TRUE);
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef __LAUNCHER_H__
+#define __LAUNCHER_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define LAUNCHER_TYPE         (launcher_get_type ())
+#define LAUNCHER(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), LAUNCHER_TYPE, Launcher))
+#define LAUNCHER_CLASS(c)     (G_TYPE_CHECK_CLASS_CAST ((c), LAUNCHER_TYPE, LauncherClass))
+#define IS_LAUNCHER(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), LAUNCHER_TYPE))
+#define IS_LAUNCHER_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE ((c), LAUNCHER_TYPE))
+#define LAUNCHER_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), LAUNCHER_TYPE, LauncherClass))
+
+typedef struct {
+	GObject g_object;
+} Launcher;
+
+typedef struct {
+	GObjectClass g_object_class;
+
+	void (* launching) (Launcher *, const gchar *uri);
+} LauncherClass;
+
+GType launcher_get_type (void);
+
+Launcher *launcher_get_instance (void);
+gboolean  launcher_launch       (Launcher *this, const gchar *desktop_entry, guint32 time);
+gchar    *launcher_get_program  (Launcher *this, const gchar *desktop_entry);
+gchar    *launcher_find_program (const gchar *desktop_entry);
+
+G_END_DECLS
+
+#endif
@@ -43,9 +43,22 @@
 
 #ifdef HAVE_NETWORK
 #include "network-status-tile.h"
+#include "network-status-agent.h"
 #endif
 
 #include "tile-table.h"
+#include "bookmark-layer.h"
+#include "menu-search.h"
+#include "search-helper.h"
+#include "path-cache.h"
+#include "launcher.h"
+#include "app-prefetch.h"
+#include "frecency.h"
+#include "usage-journal.h"
+#include "thumbnail-loader.h"
+#include "mount-tracker.h"
+#include "io-guard.h"
+#include "stall-watchdog.h"
 
 #include "tomboykeybinder.h"
 
@@ -54,6 +67,11 @@
 #define APP_BROWSER_SETTINGS_KEY        "application-browser"
 #define FILE_BROWSER_SETTINGS_KEY       "file-browser"
 #define SEARCH_CMD_SETTINGS_KEY         "search-command"
+#define SEARCH_PROVIDERS_SETTINGS_KEY   "search-providers"
+#define SEARCH_HELPER_SETTINGS_KEY      "search-helper-command"
+#define PREWARM_WINDOW_SETTINGS_KEY     "prewarm-window"
+#define STALL_BUDGET_SETTINGS_KEY       "stall-budget"
+#define PREFETCH_BUDGET_SETTINGS_KEY    "prefetch-budget"
 
 #define FILE_AREA_SCHEMA                SETTINGS_SCHEMA ".file-area"
 #define CURRENT_PAGE_SETTINGS_KEY       "file-class"
@@ -84,8 +102,71 @@
 #define PANEL_SCHEMA                    "org.mate.panel"
 #define DISABLE_LOGOUT_SETTINGS_KEY     "disable-log-out"
 
+#define FILE_CLASS_WRITE_DELAY_SECONDS     2
+#define MODEL_REFRESH_SECONDS             30
+#define MODEL_STALE_SECONDS                5
+#define HOVER_REFRESH_DELAY_MILLISECONDS  50
+
+/* what a change to a lockdown key has to redo, see lockdown_key_changes */
+enum {
+	LOCKDOWN_MORE_LINKS    = 1 << 0,
+	LOCKDOWN_SEARCH_AREA   = 1 << 1,
+	LOCKDOWN_STATUS_AREA   = 1 << 2,
+	LOCKDOWN_SYSTEM_AREA   = 1 << 3,
+	LOCKDOWN_RELOAD_SYSTEM = 1 << 4,
+	LOCKDOWN_ALL           = ~0
+};
+
+/* per file table, indexed like priv->file_tables */
+#define LOCKDOWN_VISIBLE(table) (1 << (8 + (table)))
+#define LOCKDOWN_RELOAD(table)  (1 << (16 + (table)))
+
+/* what a refresh job brings up to date, see start_refresh; the usage
+ * journal is only read back on the main loop */
+enum {
+	REFRESH_NETWORK      = 1 << 0,
+	REFRESH_DISK         = 1 << 1,
+	REFRESH_RECENT_STORE = 1 << 2,
+	REFRESH_RECENT_APPS  = 1 << 3
+};
+
 G_DEFINE_TYPE (MainMenuUI, main_menu_ui, G_TYPE_OBJECT)
 
+/* the results of a refresh, gathered in its own thread */
+typedef struct {
+	MainMenuUI    *ui;
+	guint          what;
+
+	gpointer       network_info;
+	gdouble        available_bytes;
+	gdouble        capacity_bytes;
+	GBookmarkFile *store;
+} RefreshJob;
+
+/* The settings read on hot paths, kept current by the GSettings "changed"
+ * signals so that nobody has to go through GSettings to look at them.
+ */
+typedef struct {
+	gboolean   urgent_close;
+	gchar     *search_cmd;
+
+	gint       file_class;
+	gint       max_total_items;
+	gint       min_recent_items;
+	gchar    **file_blacklist;
+
+	gboolean   disable_terminal;
+	gboolean   disable_lockscreen;
+	gboolean   disable_logout;
+} SettingsSnapshot;
+
+/* search-command parsed, along with the setting it was parsed from */
+typedef struct {
+	gboolean   valid;
+	gchar     *cmd;
+	gchar    **argv;
+} SearchCommandCache;
+
 typedef struct {
 	MatePanelApplet *panel_applet;
 	GtkWidget   *panel_about_dialog;
@@ -101,9 +182,37 @@ typedef struct {
 	GtkWidget *top_pane;
 	GtkWidget *left_pane;
 
-	GtkWidget *search_section;
-	GtkWidget *search_entry;
+	cairo_surface_t *bg_surface;
+	guint            n_bg_renders;
+	guint            n_exposes;
+
+	guint    warm_up_id;
+	gboolean is_warm;
+	gint     slab_x;
+	gint     slab_y;
+	gboolean slab_pos_valid;
+
+	GTimer  *present_timer;
+	gboolean awaiting_first_frame;
+	gboolean presenting;
+
+	guint    model_refresh_id;
+	guint    hover_refresh_id;
+	gint64   models_refreshed_at;
+	gboolean refreshing;
+	guint    refresh_pending;
+	RefreshJob *held_refresh;
+
+	GtkWidget  *search_section;
+	GtkWidget  *search_entry;
+	MenuSearch *menu_search;
+	gboolean    external_search_available;
+
+	SearchCommandCache  search_cmd_cache;
+	SearchHelper       *search_helper;
+
 	GtkWidget *network_status;
+	GtkWidget *hard_drive_status;
 
 	GtkNotebook *file_section;
 	GtkWidget   *page_selectors    [3];
@@ -118,15 +227,17 @@ typedef struct {
 	GtkWidget *more_buttons  [3];
 	GtkWidget *more_sections [3];
 
-	gint max_total_items;
+	gint  max_total_items;
+	gint  recent_limits [2];
+	guint limits_id;
 
 	GtkWidget *status_section;
 	GtkWidget *system_section;
 
 	BookmarkAgent *bm_agents [BOOKMARK_STORE_N_TYPES];
 
-	GVolumeMonitor        *volume_mon;
-	GList                 *mounts;
+	MountTracker *mount_tracker;
+	AppPrefetch  *app_prefetch;
 
 	GFileMonitor *recently_used_store_monitor;
 	guint recently_used_timeout_id;
@@ -137,10 +248,17 @@ typedef struct {
 	GSettings *mate_lockdown_settings;
 	GSettings *panel_settings;
 
+	SettingsSnapshot snapshot;
+	guint            file_class_write_id;
+
+	guint lockdown_changes;
+	guint lockdown_changes_id;
+
 	gboolean ptr_is_grabbed;
 	gboolean kbd_is_grabbed;
 
 	guint recently_used_store_has_changed : 1;
+	guint usage_journal_has_changed       : 1;
 } MainMenuUIPrivate;
 
 #define PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), MAIN_MENU_UI_TYPE, MainMenuUIPrivate))
@@ -155,6 +273,8 @@ static void create_user_apps_section (MainMenuUI *);
 static void create_rct_apps_section  (MainMenuUI *);
 static void create_user_docs_section (MainMenuUI *);
 static void create_rct_docs_section  (MainMenuUI *);
+static void setup_mount_tracker      (MainMenuUI *);
+static void setup_app_prefetch       (MainMenuUI *);
 static void create_user_dirs_section (MainMenuUI *);
 static void create_system_section    (MainMenuUI *);
 static void create_status_section    (MainMenuUI *);
@@ -164,14 +284,26 @@ static void setup_bookmark_agents    (MainMenuUI *);
 static void setup_lock_down          (MainMenuUI *);
 static void setup_recently_used_store_monitor (MainMenuUI *this, gboolean is_startup);
 static void update_recently_used_sections (MainMenuUI *this);
+static void compute_slab_window_position  (MainMenuUI *this, gint *x, gint *y);
+static gboolean warm_up_slab_window_cb (gpointer);
+static gboolean refresh_models_cb      (gpointer);
+static void     refresh_models         (MainMenuUI *);
+static void     start_refresh          (MainMenuUI *, guint);
+static gpointer refresh_thread         (gpointer);
+static gboolean refresh_done_cb        (gpointer);
+static void     end_presenting         (MainMenuUI *);
 
 static void       select_page                (MainMenuUI *);
+static void       load_settings_snapshot     (MainMenuUI *);
+static gboolean   write_file_class_cb        (gpointer);
 static void       update_limits              (MainMenuUI *);
 static void       connect_to_tile_triggers   (MainMenuUI *, TileTable *);
 static void       hide_slab_if_urgent_close  (MainMenuUI *);
 static void       set_search_section_visible (MainMenuUI *);
 static void       set_table_section_visible  (MainMenuUI *, TileTable *);
-static gchar    **get_search_argv            (const gchar *);
+static gchar    **parse_search_command       (MainMenuUI *);
+static gboolean   search_command_available   (MainMenuUI *);
+static gchar    **get_search_argv            (MainMenuUI *, const gchar *);
 static void       reorient_panel_button      (MainMenuUI *);
 static void       bind_beagle_search_key     (MainMenuUI *);
 static void       launch_search              (MainMenuUI *);
@@ -185,14 +317,19 @@ static Tile *item_to_user_doc_tile   (BookmarkItem *, gpointer);
 static Tile *item_to_recent_doc_tile (BookmarkItem *, gpointer);
 static Tile *item_to_dir_tile        (BookmarkItem *, gpointer);
 static Tile *item_to_system_tile     (BookmarkItem *, gpointer);
+static Tile *create_document_tile    (MainMenuUI *, BookmarkStoreType, BookmarkItem *);
 static BookmarkItem *app_uri_to_item (const gchar *, gpointer);
 static BookmarkItem *doc_uri_to_item (const gchar *, gpointer);
 
 static void     panel_button_clicked_cb           (GtkButton *, gpointer);
 static gboolean panel_button_button_press_cb      (GtkWidget *, GdkEventButton *, gpointer);
+static gboolean panel_button_enter_notify_cb      (GtkWidget *, GdkEventCrossing *, gpointer);
+static gboolean panel_button_leave_notify_cb      (GtkWidget *, GdkEventCrossing *, gpointer);
 static void     panel_button_drag_data_rcv_cb     (GtkWidget *, GdkDragContext *, gint, gint,
                                                    GtkSelectionData *, guint, guint, gpointer);
 static gboolean slab_window_expose_cb             (GtkWidget *, GdkEventExpose *, gpointer);
+static void     slab_window_style_set_cb          (GtkWidget *, GtkStyle *, gpointer);
+static void     slab_pane_allocate_cb             (GtkWidget *, GtkAllocation *, gpointer);
 static gboolean slab_window_key_press_cb          (GtkWidget *, GdkEventKey *, gpointer);
 static gboolean slab_window_button_press_cb       (GtkWidget *, GdkEventButton *, gpointer);
 static void     slab_window_allocate_cb           (GtkWidget *, GtkAllocation *, gpointer);
@@ -200,25 +337,36 @@ static void     slab_window_map_event_cb          (GtkWidget *, GdkEvent *, gpoi
 static void     slab_window_unmap_event_cb        (GtkWidget *, GdkEvent *, gpointer);
 static gboolean slab_window_grab_broken_cb        (GtkWidget *, GdkEvent *, gpointer);
 static void     search_entry_activate_cb          (GtkEntry *, gpointer);
+static void     search_entry_changed_cb           (GtkEditable *, gpointer);
+static gboolean search_entry_key_press_cb         (GtkWidget *, GdkEventKey *, gpointer);
+static void     search_result_activated_cb        (MenuSearch *, gpointer);
 static void     page_button_clicked_cb            (GtkButton *, gpointer);
 static void     tile_table_notify_cb              (GObject *, GParamSpec *, gpointer);
 static void     gtk_table_notify_cb               (GObject *, GParamSpec *, gpointer);
 static void     tile_action_triggered_cb          (Tile *, TileEvent *, TileAction *, gpointer);
 static void     more_buttons_clicked_cb            (GtkButton *, gpointer);
+static void     launcher_launching_cb              (Launcher *, const gchar *, gpointer);
 static void     search_cmd_notify_cb              (GSettings *, gchar *, gpointer);
+static void     search_providers_notify_cb        (GSettings *, gchar *, gpointer);
+static void     search_helper_notify_cb           (GSettings *, gchar *, gpointer);
 static void     current_page_notify_cb            (GSettings *, gchar *, gpointer);
 static void     lockdown_notify_cb                (GSettings *, gchar *, gpointer);
+static void     stall_budget_notify_cb            (GSettings *, gchar *, gpointer);
+static void     prefetch_budget_notify_cb         (GSettings *, gchar *, gpointer);
+static void     snapshot_notify_cb                (GSettings *, gchar *, gpointer);
 static void     panel_menu_open_cb                (GtkAction *, gpointer);
 static void     panel_menu_about_cb               (GtkAction *, gpointer);
 static void     panel_applet_change_orient_cb     (MatePanelApplet *, MatePanelAppletOrient, gpointer);
 static void     panel_applet_change_background_cb (MatePanelApplet *, MatePanelAppletBackgroundType, GdkColor *,
                                                    GdkPixmap * pixmap, gpointer);
+static void     panel_applet_destroy_cb           (GtkWidget *, gpointer);
 static void     slab_window_tomboy_bindkey_cb     (gchar *, gpointer);
 static void     search_tomboy_bindkey_cb          (gchar *, gpointer);
 static gboolean grabbing_window_event_cb          (GtkWidget *, GdkEvent *, gpointer);
-static void     user_app_agent_notify_cb          (GObject *, GParamSpec *, gpointer);
-static void     user_doc_agent_notify_cb          (GObject *, GParamSpec *, gpointer);
-static void     volume_monitor_mount_cb           (GVolumeMonitor *, GMount *, gpointer);
+static void     user_app_layer_changed_cb         (BookmarkLayer *, const GArray *, gpointer);
+static void     user_doc_layer_changed_cb         (BookmarkLayer *, const GArray *, gpointer);
+static void     usage_journal_changed_cb          (UsageJournal *, gpointer);
+static void     mount_health_changed_cb           (MountTracker *, gpointer);
 
 static GdkFilterReturn slab_gdk_message_filter (GdkXEvent *, GdkEvent *, gpointer);
 
@@ -268,6 +416,40 @@ enum {
 
 static Atom slab_action_main_menu_atom = None;
 
+static const gchar *table_visibility_keys [] = {
+	USER_APPS_VIS_SETTINGS_KEY,
+	RCNT_APPS_VIS_SETTINGS_KEY,
+	USER_DOCS_VIS_SETTINGS_KEY,
+	RCNT_DOCS_VIS_SETTINGS_KEY,
+	USER_DIRS_VIS_SETTINGS_KEY
+};
+
+/* The blacklisting keys filter the system area and both application tables,
+ * the modifiable keys are picked up by the tiles of their table when these
+ * are created.  Keys not listed here redo everything.
+ */
+static const struct {
+	const gchar *key;
+	guint        changes;
+} lockdown_key_changes [] = {
+	{ MORE_LINK_VIS_SETTINGS_KEY,      LOCKDOWN_MORE_LINKS },
+	{ SEARCH_VIS_SETTINGS_KEY,         LOCKDOWN_SEARCH_AREA },
+	{ STATUS_VIS_SETTINGS_KEY,         LOCKDOWN_STATUS_AREA },
+	{ SYSTEM_VIS_SETTINGS_KEY,         LOCKDOWN_SYSTEM_AREA },
+	{ USER_APPS_VIS_SETTINGS_KEY,      LOCKDOWN_VISIBLE (USER_APPS_TABLE) },
+	{ RCNT_APPS_VIS_SETTINGS_KEY,      LOCKDOWN_VISIBLE (RCNT_APPS_TABLE) },
+	{ USER_DOCS_VIS_SETTINGS_KEY,      LOCKDOWN_VISIBLE (USER_DOCS_TABLE) },
+	{ RCNT_DOCS_VIS_SETTINGS_KEY,      LOCKDOWN_VISIBLE (RCNT_DOCS_TABLE) },
+	{ USER_DIRS_VIS_SETTINGS_KEY,      LOCKDOWN_VISIBLE (USER_DIRS_TABLE) },
+	{ MODIFIABLE_SYSTEM_SETTINGS_KEY,  LOCKDOWN_RELOAD_SYSTEM },
+	{ MODIFIABLE_APPS_SETTINGS_KEY,    LOCKDOWN_RELOAD (USER_APPS_TABLE) },
+	{ MODIFIABLE_DOCS_SETTINGS_KEY,    LOCKDOWN_RELOAD (USER_DOCS_TABLE) },
+	{ MODIFIABLE_DIRS_SETTINGS_KEY,    LOCKDOWN_RELOAD (USER_DIRS_TABLE) },
+	{ DISABLE_TERMINAL_SETTINGS_KEY,   LOCKDOWN_RELOAD_SYSTEM | LOCKDOWN_RELOAD (USER_APPS_TABLE) | LOCKDOWN_RELOAD (RCNT_APPS_TABLE) },
+	{ DISABLE_LOCKSCREEN_SETTINGS_KEY, LOCKDOWN_RELOAD_SYSTEM | LOCKDOWN_RELOAD (USER_APPS_TABLE) | LOCKDOWN_RELOAD (RCNT_APPS_TABLE) },
+	{ DISABLE_LOGOUT_SETTINGS_KEY,     LOCKDOWN_RELOAD_SYSTEM | LOCKDOWN_RELOAD (USER_APPS_TABLE) | LOCKDOWN_RELOAD (RCNT_APPS_TABLE) }
+};
+
 static gboolean
 main_menu_delayed_setup (MainMenuUI *this)
 {
@@ -276,44 +458,56 @@ main_menu_delayed_setup (MainMenuUI *this)
 	if (priv->recently_used_store_monitor != NULL)
 		return FALSE; /* already setup */
 
-	libslab_checkpoint ("main_menu_ui_new(): setup_recently_used_store_monitor");
+	CHECKPOINT ("main_menu_ui_new(): setup_recently_used_store_monitor");
 	setup_recently_used_store_monitor (this, TRUE);
-	libslab_checkpoint ("main_menu_ui_new(): setup_bookmark_agents");
+	CHECKPOINT ("main_menu_ui_new(): setup_bookmark_agents");
 	setup_bookmark_agents    (this);
-	libslab_checkpoint ("main_menu_ui_new(): create_slab_window");
+	CHECKPOINT ("main_menu_ui_new(): create_slab_window");
 	create_slab_window       (this);
-	libslab_checkpoint ("main_menu_ui_new(): create_search_section");
+	CHECKPOINT ("main_menu_ui_new(): create_search_section");
 	create_search_section    (this);
-	libslab_checkpoint ("main_menu_ui_new(): create_file_section");
+	CHECKPOINT ("main_menu_ui_new(): create_file_section");
 	create_file_section      (this);
-	libslab_checkpoint ("main_menu_ui_new(): create_user_apps_section");
+	CHECKPOINT ("main_menu_ui_new(): create_user_apps_section");
 	create_user_apps_section (this);
-	libslab_checkpoint ("main_menu_ui_new(): create_rct_apps_section");
+	CHECKPOINT ("main_menu_ui_new(): create_rct_apps_section");
 	create_rct_apps_section  (this);
-	libslab_checkpoint ("main_menu_ui_new(): create_user_docs_section");
+	CHECKPOINT ("main_menu_ui_new(): setup_mount_tracker");
+	setup_mount_tracker      (this);
+	CHECKPOINT ("main_menu_ui_new(): setup_app_prefetch");
+	setup_app_prefetch       (this);
+	CHECKPOINT ("main_menu_ui_new(): create_user_docs_section");
 	create_user_docs_section (this);
-	libslab_checkpoint ("main_menu_ui_new(): create_rct_docs_section");
+	CHECKPOINT ("main_menu_ui_new(): create_rct_docs_section");
 	create_rct_docs_section  (this);
-	libslab_checkpoint ("main_menu_ui_new(): create_user_dirs_section");
+	CHECKPOINT ("main_menu_ui_new(): create_user_dirs_section");
 	create_user_dirs_section (this);
-	libslab_checkpoint ("main_menu_ui_new(): create_system_section");
+	CHECKPOINT ("main_menu_ui_new(): create_system_section");
 	create_system_section    (this);
-	libslab_checkpoint ("main_menu_ui_new(): create_status_section");
+	CHECKPOINT ("main_menu_ui_new(): create_status_section");
 	create_status_section    (this);
-	libslab_checkpoint ("main_menu_ui_new(): create_more_buttons");
+	CHECKPOINT ("main_menu_ui_new(): create_more_buttons");
 	create_more_buttons      (this);
-	libslab_checkpoint ("main_menu_ui_new(): setup_file_tables");
+	CHECKPOINT ("main_menu_ui_new(): setup_file_tables");
 	setup_file_tables        (this);
-	libslab_checkpoint ("main_menu_ui_new(): setup_lock_down");
+	CHECKPOINT ("main_menu_ui_new(): setup_lock_down");
 	setup_lock_down          (this);
 
-	libslab_checkpoint ("main_menu_ui_new(): bind_beagle_search_key");
+	CHECKPOINT ("main_menu_ui_new(): bind_beagle_search_key");
 	bind_beagle_search_key  (this);
-	libslab_checkpoint ("main_menu_ui_new(): select_page");
+	CHECKPOINT ("main_menu_ui_new(): select_page");
 	select_page             (this);
-	libslab_checkpoint ("main_menu_ui_new(): apply_lockdown_settings");
+	CHECKPOINT ("main_menu_ui_new(): apply_lockdown_settings");
 	apply_lockdown_settings (this);
 
+	/* the first refresh fills the status tiles */
+	refresh_models (this);
+
+	priv->model_refresh_id = g_timeout_add_seconds (MODEL_REFRESH_SECONDS, refresh_models_cb, this);
+
+	if (g_settings_get_boolean (priv->settings, PREWARM_WINDOW_SETTINGS_KEY))
+		priv->warm_up_id = g_idle_add_full (G_PRIORITY_LOW, warm_up_slab_window_cb, this, NULL);
+
 	return FALSE;
 }
 
@@ -337,6 +531,18 @@ main_menu_ui_new (MatePanelApplet *applet)
 	priv->mate_lockdown_settings = g_settings_new (MATE_LOCKDOWN_SCHEMA);
 	priv->panel_settings = g_settings_new (PANEL_SCHEMA);
 
+	/* connected first, so the snapshot is current for every other handler */
+	g_signal_connect (priv->settings,               "changed", G_CALLBACK (snapshot_notify_cb), this);
+	g_signal_connect (priv->filearea_settings,      "changed", G_CALLBACK (snapshot_notify_cb), this);
+	g_signal_connect (priv->mate_lockdown_settings, "changed", G_CALLBACK (snapshot_notify_cb), this);
+	g_signal_connect (priv->panel_settings,         "changed", G_CALLBACK (snapshot_notify_cb), this);
+
+	load_settings_snapshot (this);
+
+	stall_watchdog_set_budget (MAX (g_settings_get_int (priv->settings, STALL_BUDGET_SETTINGS_KEY), 0));
+	g_signal_connect (priv->settings, "changed::" STALL_BUDGET_SETTINGS_KEY,
+		G_CALLBACK (stall_budget_notify_cb), this);
+
 	window_ui_path = g_build_filename (DATADIR, PACKAGE, "slab-window.ui", NULL);
 	button_ui_path = g_build_filename (DATADIR, PACKAGE, "slab-button.ui", NULL);
 
@@ -347,7 +553,7 @@ main_menu_ui_new (MatePanelApplet *applet)
 	g_free (window_ui_path);
 	g_free (button_ui_path);
 
-	libslab_checkpoint ("main_menu_ui_new(): create_panel_button");
+	CHECKPOINT ("main_menu_ui_new(): create_panel_button");
 	create_panel_button (this);
 	g_timeout_add_seconds (5, (GSourceFunc) main_menu_delayed_setup, this);
 
@@ -388,6 +594,12 @@ main_menu_ui_init (MainMenuUI *this)
 
 	priv->search_section                             = NULL;
 	priv->search_entry                               = NULL;
+	priv->menu_search                                = NULL;
+	priv->external_search_available                  = FALSE;
+	priv->search_cmd_cache.valid                     = FALSE;
+	priv->search_cmd_cache.cmd                       = NULL;
+	priv->search_cmd_cache.argv                      = NULL;
+	priv->search_helper                              = NULL;
 
 	priv->file_section                               = NULL;
 	priv->page_selectors [APPS_PAGE]                 = NULL;
@@ -423,12 +635,34 @@ main_menu_ui_init (MainMenuUI *this)
 	priv->more_sections [DIRS_PAGE]                  = NULL;
 
 	priv->max_total_items                            = 8;
+	priv->recent_limits [0]                          = -1;
+	priv->recent_limits [1]                          = -1;
+	priv->limits_id                                  = 0;
 
 	priv->status_section                             = NULL;
 	priv->system_section                             = NULL;
 	priv->network_status                             = NULL;
-
-	priv->volume_mon                                 = NULL;
+	priv->hard_drive_status                          = NULL;
+
+	priv->mount_tracker                              = NULL;
+	priv->app_prefetch                               = NULL;
+
+	priv->bg_surface                                 = NULL;
+	priv->n_bg_renders                               = 0;
+	priv->n_exposes                                  = 0;
+
+	priv->warm_up_id                                 = 0;
+	priv->is_warm                                    = FALSE;
+	priv->slab_pos_valid                             = FALSE;
+	priv->present_timer                              = NULL;
+	priv->awaiting_first_frame                       = FALSE;
+	priv->presenting                                 = FALSE;
+	priv->model_refresh_id                           = 0;
+	priv->hover_refresh_id                           = 0;
+	priv->models_refreshed_at                        = 0;
+	priv->refreshing                                 = FALSE;
+	priv->refresh_pending                            = 0;
+	priv->held_refresh                               = NULL;
 
 	priv->settings                                   = NULL;
 	priv->filearea_settings                          = NULL;
@@ -436,6 +670,12 @@ main_menu_ui_init (MainMenuUI *this)
 	priv->mate_lockdown_settings                     = NULL;
 	priv->panel_settings                             = NULL;
 
+	memset (& priv->snapshot, 0, sizeof (SettingsSnapshot));
+	priv->file_class_write_id                        = 0;
+
+	priv->lockdown_changes                           = 0;
+	priv->lockdown_changes_id                        = 0;
+
 	priv->ptr_is_grabbed                             = FALSE;
 	priv->kbd_is_grabbed                             = FALSE;
 }
@@ -450,6 +690,8 @@ main_menu_ui_finalize (GObject *g_obj)
 	if (priv->recently_used_store_monitor)
 		g_file_monitor_cancel (priv->recently_used_store_monitor);
 
+	g_signal_handlers_disconnect_by_func (usage_journal_get_instance (), usage_journal_changed_cb, g_obj);
+
 	for (i = 0; i < 4; ++i) {
 		g_object_unref (G_OBJECT (g_object_get_data (
 			G_OBJECT (priv->more_buttons [i]), "double-click-detector")));
@@ -460,6 +702,18 @@ main_menu_ui_finalize (GObject *g_obj)
 		g_object_unref (priv->panel_buttons [i]);
 	}
 
+	if (priv->file_class_write_id)
+		g_source_remove (priv->file_class_write_id);
+
+	if (priv->lockdown_changes_id)
+		g_source_remove (priv->lockdown_changes_id);
+
+	if (priv->limits_id)
+		g_source_remove (priv->limits_id);
+
+	g_free      (priv->snapshot.search_cmd);
+	g_strfreev  (priv->snapshot.file_blacklist);
+
 	g_object_unref (priv->settings);
 	g_object_unref (priv->filearea_settings);
 	g_object_unref (priv->lockdown_settings);
@@ -469,9 +723,37 @@ main_menu_ui_finalize (GObject *g_obj)
 	for (i = 0; i < BOOKMARK_STORE_N_TYPES; ++i)
 		g_object_unref (priv->bm_agents [i]);
 
-	g_list_foreach (priv->mounts, (GFunc) g_object_unref, NULL);
-	g_list_free (priv->mounts);
-	g_object_unref (priv->volume_mon);
+	if (priv->mount_tracker)
+		g_object_unref (priv->mount_tracker);
+
+	if (priv->app_prefetch)
+		g_object_unref (priv->app_prefetch);
+
+	if (priv->menu_search)
+		g_object_unref (priv->menu_search);
+
+	if (priv->search_helper)
+		g_object_unref (priv->search_helper);
+
+	g_signal_handlers_disconnect_by_func (launcher_get_instance (), launcher_launching_cb, g_obj);
+
+	g_free     (priv->search_cmd_cache.cmd);
+	g_strfreev (priv->search_cmd_cache.argv);
+
+	if (priv->bg_surface)
+		cairo_surface_destroy (priv->bg_surface);
+
+	if (priv->warm_up_id)
+		g_source_remove (priv->warm_up_id);
+
+	if (priv->present_timer)
+		g_timer_destroy (priv->present_timer);
+
+	if (priv->model_refresh_id)
+		g_source_remove (priv->model_refresh_id);
+
+	if (priv->hover_refresh_id)
+		g_source_remove (priv->hover_refresh_id);
 
 	G_OBJECT_CLASS (main_menu_ui_parent_class)->finalize (g_obj);
 }
@@ -526,6 +808,14 @@ create_panel_button (MainMenuUI *this)
 			G_OBJECT (priv->panel_buttons [i]), "button_press_event",
 			G_CALLBACK (panel_button_button_press_cb), this);
 
+		g_signal_connect (
+			G_OBJECT (priv->panel_buttons [i]), "enter-notify-event",
+			G_CALLBACK (panel_button_enter_notify_cb), this);
+
+		g_signal_connect (
+			G_OBJECT (priv->panel_buttons [i]), "leave-notify-event",
+			G_CALLBACK (panel_button_leave_notify_cb), this);
+
 		gtk_drag_dest_set (
 			GTK_WIDGET (priv->panel_buttons [i]),
 			GTK_DEST_DEFAULT_ALL, NULL, 0, GDK_ACTION_COPY | GDK_ACTION_MOVE);
@@ -558,6 +848,10 @@ create_panel_button (MainMenuUI *this)
 	g_signal_connect (
 		G_OBJECT (priv->panel_applet), "change_background",
 		G_CALLBACK (panel_applet_change_background_cb), this);
+
+	g_signal_connect (
+		G_OBJECT (priv->panel_applet), "destroy",
+		G_CALLBACK (panel_applet_destroy_cb), this);
 }
 
 static GtkWidget *
@@ -596,6 +890,22 @@ create_slab_window (MainMenuUI *this)
 		G_OBJECT (priv->slab_window), "expose-event",
 		G_CALLBACK (slab_window_expose_cb), this);
 
+	g_signal_connect (
+		G_OBJECT (priv->slab_window), "style-set",
+		G_CALLBACK (slab_window_style_set_cb), this);
+
+	g_signal_connect (
+		G_OBJECT (priv->slab_window), "size-allocate",
+		G_CALLBACK (slab_pane_allocate_cb), this);
+
+	g_signal_connect (
+		G_OBJECT (priv->top_pane), "size-allocate",
+		G_CALLBACK (slab_pane_allocate_cb), this);
+
+	g_signal_connect (
+		G_OBJECT (priv->left_pane), "size-allocate",
+		G_CALLBACK (slab_pane_allocate_cb), this);
+
 	g_signal_connect (
 		G_OBJECT (priv->slab_window), "key-press-event",
 		G_CALLBACK (slab_window_key_press_cb), this);
@@ -626,17 +936,66 @@ create_search_section (MainMenuUI *this)
 {
 	MainMenuUIPrivate *priv = PRIVATE (this);
 
+	GtkWidget *notebook;
+	GtkWidget *results;
+	gint       position;
+
+
 	priv->search_section = get_widget (priv, "search-section");
 	priv->search_entry   = get_widget (priv, "search-entry");
 
 	g_signal_connect (
 		G_OBJECT (priv->search_entry), "activate",
 		G_CALLBACK (search_entry_activate_cb), this);
+	g_signal_connect (
+		G_OBJECT (priv->search_entry), "changed",
+		G_CALLBACK (search_entry_changed_cb), this);
+	g_signal_connect (
+		G_OBJECT (priv->search_entry), "key-press-event",
+		G_CALLBACK (search_entry_key_press_cb), this);
+
+	/* the results pane takes the place of the file area while there is a
+	 * query */
+	priv->menu_search = menu_search_new ();
+
+	menu_search_add_bookmarks (priv->menu_search,
+		bookmark_layer_get_for_agent (priv->bm_agents [BOOKMARK_STORE_USER_APPS]),
+		MENU_SEARCH_FAVORITE_APPS);
+	menu_search_add_bookmarks (priv->menu_search,
+		bookmark_layer_get_for_agent (priv->bm_agents [BOOKMARK_STORE_USER_DOCS]),
+		MENU_SEARCH_FAVORITE_DOCS);
+	menu_search_add_bookmarks (priv->menu_search,
+		bookmark_layer_get_for_agent (priv->bm_agents [BOOKMARK_STORE_RECENT_DOCS]),
+		MENU_SEARCH_RECENT_DOCS);
+
+	g_signal_connect (
+		G_OBJECT (priv->menu_search), "result-activated",
+		G_CALLBACK (search_result_activated_cb), this);
+
+	notebook = get_widget (priv, "file-area-notebook");
+	results  = menu_search_get_widget (priv->menu_search);
+
+	gtk_container_child_get (
+		GTK_CONTAINER (gtk_widget_get_parent (notebook)), notebook, "position", & position, NULL);
+
+	gtk_box_pack_start (GTK_BOX (gtk_widget_get_parent (notebook)), results, TRUE, TRUE, 0);
+	gtk_box_reorder_child (GTK_BOX (gtk_widget_get_parent (notebook)), results, position + 1);
 
 	set_search_section_visible (this);
 
 	g_signal_connect (priv->settings, "changed::" SEARCH_CMD_SETTINGS_KEY,
 		G_CALLBACK (search_cmd_notify_cb), this);
+
+	search_helper_notify_cb (priv->settings, SEARCH_HELPER_SETTINGS_KEY, this);
+
+	g_signal_connect (priv->settings, "changed::" SEARCH_HELPER_SETTINGS_KEY,
+		G_CALLBACK (search_helper_notify_cb), this);
+
+	/* the providers themselves only start with the first search */
+	search_providers_notify_cb (priv->settings, SEARCH_PROVIDERS_SETTINGS_KEY, this);
+
+	g_signal_connect (priv->settings, "changed::" SEARCH_PROVIDERS_SETTINGS_KEY,
+		G_CALLBACK (search_providers_notify_cb), this);
 }
 
 static void
@@ -731,6 +1090,7 @@ create_status_section (MainMenuUI *this)
 	ctnr = GTK_CONTAINER (gtk_builder_get_object (
 		priv->main_menu_ui, "hard-drive-status-container"));
 	tile = hard_drive_status_tile_new ();
+	priv->hard_drive_status = tile;
 
 	gtk_icon_size_lookup (GTK_ICON_SIZE_DND, & icon_width, NULL);
 	g_signal_connect (
@@ -829,12 +1189,34 @@ create_rct_docs_section (MainMenuUI *this)
 		item_to_recent_doc_tile, this, NULL, NULL));
 
 	gtk_container_add (ctnr, GTK_WIDGET (priv->file_tables [RCNT_DOCS_TABLE]));
+}
+
+static void
+setup_mount_tracker (MainMenuUI *this)
+{
+	MainMenuUIPrivate *priv = PRIVATE (this);
+
+
+	priv->mount_tracker = mount_tracker_new ();
+
+	g_signal_connect (priv->mount_tracker, "health-changed", G_CALLBACK (mount_health_changed_cb), this);
+}
+
+static void
+setup_app_prefetch (MainMenuUI *this)
+{
+	MainMenuUIPrivate *priv = PRIVATE (this);
+
 
-	priv->volume_mon = g_volume_monitor_get ();
-	priv->mounts = g_volume_monitor_get_mounts (priv->volume_mon);
+	priv->app_prefetch = app_prefetch_new (
+		bookmark_layer_get_for_agent (priv->bm_agents [BOOKMARK_STORE_USER_APPS]),
+		bookmark_layer_get_for_agent (priv->bm_agents [BOOKMARK_STORE_RECENT_APPS]));
 
-	g_signal_connect (priv->volume_mon, "mount-added", G_CALLBACK (volume_monitor_mount_cb), this);
-	g_signal_connect (priv->volume_mon, "mount-removed", G_CALLBACK (volume_monitor_mount_cb), this);
+	/* the first pass waits a while, the session is still starting up */
+	prefetch_budget_notify_cb (priv->settings, PREFETCH_BUDGET_SETTINGS_KEY, this);
+
+	g_signal_connect (priv->settings, "changed::" PREFETCH_BUDGET_SETTINGS_KEY,
+		G_CALLBACK (prefetch_budget_notify_cb), this);
 }
 
 static void
@@ -880,6 +1262,11 @@ create_more_buttons (MainMenuUI *this)
 	priv->more_sections [0] = get_widget (priv, "more-apps-section");
 	priv->more_sections [1] = get_widget (priv, "more-docs-section");
 	priv->more_sections [2] = get_widget (priv, "more-dirs-section");
+
+	/* the launcher gets the menu out of the way before it spawns */
+	g_signal_connect (
+		G_OBJECT (launcher_get_instance ()), "launching",
+		G_CALLBACK (launcher_launching_cb), this);
 }
 
 static void
@@ -923,15 +1310,45 @@ setup_bookmark_agents (MainMenuUI *this)
 	for (i = 0; i < BOOKMARK_STORE_N_TYPES; ++i) {
 		priv->bm_agents [i] = bookmark_agent_get_instance (i);
 
+		/* the stores the user reorders by drag and drop */
+		if (i == BOOKMARK_STORE_SYSTEM || i == BOOKMARK_STORE_USER_APPS || i == BOOKMARK_STORE_USER_DOCS)
+			bookmark_layer_enable_journal (
+				bookmark_layer_get_for_agent (priv->bm_agents [i]),
+				i == BOOKMARK_STORE_SYSTEM    ? "system-items" :
+				i == BOOKMARK_STORE_USER_APPS ? "user-apps"    : "user-docs");
+
+		/* the recent stores show the most frecent items first */
+		if (i == BOOKMARK_STORE_RECENT_APPS || i == BOOKMARK_STORE_RECENT_DOCS)
+			bookmark_layer_set_sort_func (
+				bookmark_layer_get_for_agent (priv->bm_agents [i]),
+				frecency_compare_items, frecency_get_instance ());
+
+	}
+
+	/* the favorite layers run ahead of their agents while changes are
+	 * pending, so the recent layers follow the layers */
+	for (i = 0; i < BOOKMARK_STORE_N_TYPES; ++i) {
 		if (i == BOOKMARK_STORE_USER_APPS || i == BOOKMARK_STORE_SYSTEM)
 			g_signal_connect (
-				G_OBJECT (priv->bm_agents [i]), "notify::" BOOKMARK_AGENT_ITEMS_PROP,
-				G_CALLBACK (user_app_agent_notify_cb), this);
+				G_OBJECT (bookmark_layer_get_for_agent (priv->bm_agents [i])), "items-changed",
+				G_CALLBACK (user_app_layer_changed_cb), this);
 		else if (i == BOOKMARK_STORE_USER_DOCS)
 			g_signal_connect (
-				G_OBJECT (priv->bm_agents [i]), "notify::" BOOKMARK_AGENT_ITEMS_PROP,
-				G_CALLBACK (user_doc_agent_notify_cb), this);
+				G_OBJECT (bookmark_layer_get_for_agent (priv->bm_agents [i])), "items-changed",
+				G_CALLBACK (user_doc_layer_changed_cb), this);
 	}
+
+	bookmark_layer_set_filter_func (
+		bookmark_layer_get_for_agent (priv->bm_agents [BOOKMARK_STORE_RECENT_APPS]),
+		recent_app_is_shown, this);
+	bookmark_layer_set_filter_func (
+		bookmark_layer_get_for_agent (priv->bm_agents [BOOKMARK_STORE_RECENT_DOCS]),
+		recent_doc_is_shown, this);
+
+	/* the recent applications come from the menu's own journal */
+	g_signal_connect (
+		G_OBJECT (usage_journal_get_instance ()), "changed",
+		G_CALLBACK (usage_journal_changed_cb), this);
 }
 
 static void
@@ -997,6 +1414,7 @@ setup_recently_used_store_monitor (MainMenuUI *this, gboolean is_startup)
 	GFileMonitor *monitor;
 
 	priv->recently_used_store_has_changed = TRUE; /* ensure the store gets read the first time we need it */
+	priv->usage_journal_has_changed       = TRUE;
 
 	path = get_recently_used_store_filename ();
 	file = g_file_new_for_path (path);
@@ -1037,22 +1455,33 @@ item_to_user_app_tile (BookmarkItem *item, gpointer data)
 static Tile *
 item_to_recent_app_tile (BookmarkItem *item, gpointer data)
 {
-	MainMenuUIPrivate *priv = PRIVATE (data);
-
-	Tile *tile = NULL;
+	if (app_is_in_blacklist (item->uri, data))
+		return NULL;
 
-	gboolean blacklisted;
+	return TILE (application_tile_new (item->uri));
+}
 
+/* The recent sections leave out what the favorite sections already show.
+ * Their layers filter it, so that a change of the favorites comes out as
+ * deltas of the recent layers instead of a reload of their tables.
+ */
+static gboolean
+recent_app_is_shown (BookmarkItem *item, gpointer data)
+{
+	MainMenuUIPrivate *priv = PRIVATE (data);
 
-	blacklisted =
-		bookmark_agent_has_item (priv->bm_agents [BOOKMARK_STORE_SYSTEM],    item->uri) ||
-		bookmark_agent_has_item (priv->bm_agents [BOOKMARK_STORE_USER_APPS], item->uri) ||
-		app_is_in_blacklist (item->uri, data);
+	return ! (
+		bookmark_layer_has_item (bookmark_layer_get_for_agent (priv->bm_agents [BOOKMARK_STORE_SYSTEM]),    item->uri) ||
+		bookmark_layer_has_item (bookmark_layer_get_for_agent (priv->bm_agents [BOOKMARK_STORE_USER_APPS]), item->uri));
+}
 
-	if (! blacklisted)
-		tile = TILE (application_tile_new (item->uri));
+static gboolean
+recent_doc_is_shown (BookmarkItem *item, gpointer data)
+{
+	MainMenuUIPrivate *priv = PRIVATE (data);
 
-	return tile;
+	return ! bookmark_layer_has_item (
+		bookmark_layer_get_for_agent (priv->bm_agents [BOOKMARK_STORE_USER_DOCS]), item->uri);
 }
 
 static Tile *
@@ -1068,54 +1497,100 @@ item_to_user_doc_tile (BookmarkItem *item, gpointer data)
 			return TILE (document_tile_new_force_icon (item->uri, item->mime_type,
 				item->mtime, "gnome-mime-application-vnd.oasis.opendocument.text-template"));
 	}
-	return TILE (document_tile_new (BOOKMARK_STORE_USER_DOCS, item->uri, item->mime_type, item->mtime));
+	return create_document_tile (MAIN_MENU_UI (data), BOOKMARK_STORE_USER_DOCS, item);
 }
 
 static Tile *
 item_to_recent_doc_tile (BookmarkItem *item, gpointer data)
 {
-	MainMenuUIPrivate *priv = PRIVATE (data);
+	return create_document_tile (MAIN_MENU_UI (data), BOOKMARK_STORE_RECENT_DOCS, item);
+}
+
+/* Returns the name of a themed icon for mime_type, cached per mime type since
+ * the Documents page asks for the same handful of types over and over.
+ */
+static const gchar *
+get_mime_type_icon_name (const gchar *mime_type)
+{
+	static GHashTable *icon_names = NULL;
 
-	GMount         *mount;
-	GVolume        *volume;
-	GFile          *file;
-	char           *nfs_id;
-	gboolean        is_nfs = FALSE;
-	gboolean        is_local = TRUE;
+	GIcon        *icon;
+	const gchar **names;
+	gchar        *icon_name;
 
-	GList *node;
+	gint i;
 
-	/* we no longer do our own thumbnailing so this "should" not hang on stale mounts, slow endpoints ... */
-	/*
-	if (! g_str_has_prefix (item->uri, "file://"))
-		return NULL;
 
-	for (node = priv->mounts; ! is_nfs && node; node = node->next) {
-		mount = node->data;
-		volume = g_mount_get_volume (mount); //need to check for null here
+	if (! icon_names)
+		icon_names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	icon_name = g_hash_table_lookup (icon_names, mime_type);
+
+	if (icon_name)
+		return icon_name;
+
+	icon = g_content_type_get_icon (mime_type);
 
-		nfs_id = g_volume_get_identifier (volume, G_VOLUME_IDENTIFIER_KIND_NFS_MOUNT);
-		is_nfs = (nfs_id != NULL);
+	if (G_IS_THEMED_ICON (icon)) {
+		names = (const gchar **) g_themed_icon_get_names (G_THEMED_ICON (icon));
 
-		g_free (nfs_id);
-		g_object_unref (volume);
+		for (i = 0; ! icon_name && names && names [i]; ++i)
+			if (gtk_icon_theme_has_icon (gtk_icon_theme_get_default (), names [i]))
+				icon_name = g_strdup (names [i]);
 	}
 
-	if (is_nfs)
-		return NULL;
+	if (icon)
+		g_object_unref (icon);
 
-	file = g_file_new_for_uri (item->uri);
-	is_local = g_file_is_native (file);
-	g_object_unref (file);
+	if (! icon_name)
+		icon_name = g_strdup ("gnome-fs-regular");
 
-	if (! is_local)
-		return NULL;
-	*/
+	g_hash_table_insert (icon_names, g_strdup (mime_type), icon_name);
 
-	if (bookmark_agent_has_item (priv->bm_agents [BOOKMARK_STORE_USER_DOCS], item->uri))
-		return NULL;
+	return icon_name;
+}
+
+/* Document tiles start out with the icon for their mime type, so that the
+ * Documents page can be shown without waiting on the thumbnail factory.  The
+ * thumbnail is looked up (or generated) by the ThumbnailLoader's worker pool
+ * and replaces the icon once it is ready.
+ *
+ * Documents on a mount that the MountTracker considers unresponsive are built
+ * purely from what the bookmark store tells us, since any file access there
+ * could block on a dead server.
+ */
+static Tile *
+create_document_tile (MainMenuUI *this, BookmarkStoreType type, BookmarkItem *item)
+{
+	MainMenuUIPrivate *priv = PRIVATE (this);
+
+	Tile        *tile;
+	const gchar *icon;
+	gboolean     healthy;
+
+
+	healthy = mount_tracker_uri_is_healthy (priv->mount_tracker, item->uri);
+
+	if (healthy && ! (item->mime_type && g_str_has_prefix (item->uri, "file://")))
+		return TILE (document_tile_new (type, item->uri, item->mime_type, item->mtime));
 
-	return TILE (document_tile_new (BOOKMARK_STORE_RECENT_DOCS, item->uri, item->mime_type, item->mtime));
+	icon = item->mime_type ? get_mime_type_icon_name (item->mime_type) : "gnome-fs-regular";
+
+	/* a forced icon keeps libslab from looking the thumbnail up itself when
+	 * the tile gets its style */
+#ifdef HAVE_DOCUMENT_TILE_NEW_WITH_ICON
+	tile = TILE (document_tile_new_with_icon (type, item->uri, item->mime_type, item->mtime, icon));
+#else
+	/* without patch/libslab-document-tile-with-icon.patch, at the cost of the
+	 * store type: the tile gets the actions of a favorite */
+	tile = TILE (document_tile_new_force_icon (item->uri, item->mime_type, item->mtime, icon));
+#endif
+
+	if (tile && healthy)
+		thumbnail_loader_request (
+			thumbnail_loader_get_instance (), tile, item->mime_type, item->mtime);
+
+	return tile;
 }
 
 static Tile *
@@ -1222,42 +1697,32 @@ app_is_in_blacklist (const gchar *uri, MainMenuUI *this)
 	gchar **blacklist;
 	gint i;
 
-	gboolean disable_term;
-	gboolean disable_logout;
-	gboolean disable_lockscreen;
-
 	gboolean blacklisted;
 
-	disable_term = g_settings_get_boolean (priv->mate_lockdown_settings, DISABLE_TERMINAL_SETTINGS_KEY);
-	blacklisted  = disable_term && libslab_desktop_item_is_a_terminal (uri);
+	blacklisted = priv->snapshot.disable_terminal && libslab_desktop_item_is_a_terminal (uri);
 
 	if (blacklisted)
 		return TRUE;
 
-	disable_logout = g_settings_get_boolean (priv->panel_settings, DISABLE_LOGOUT_SETTINGS_KEY);
-	blacklisted    = disable_logout && libslab_desktop_item_is_logout (uri);
+	blacklisted = priv->snapshot.disable_logout && libslab_desktop_item_is_logout (uri);
 
 	if (blacklisted)
 		return TRUE;
 
-	disable_lockscreen = g_settings_get_boolean (priv->mate_lockdown_settings, DISABLE_LOCKSCREEN_SETTINGS_KEY);
 	/* Dont allow lock screen if root - same as gnome-panel */
 	blacklisted = libslab_desktop_item_is_lockscreen (uri) &&
-		( (geteuid () == 0) || disable_lockscreen );
+		( (geteuid () == 0) || priv->snapshot.disable_lockscreen );
 
 	if (blacklisted)
 		return TRUE;
 
-	blacklist = g_settings_get_strv (priv->filearea_settings, APP_BLACKLIST_SETTINGS_KEY);
+	blacklist = priv->snapshot.file_blacklist;
 
-	for (i = 0; blacklist[i] != NULL; i++) {
+	for (i = 0; blacklist && blacklist[i] != NULL; i++) {
 		if (! blacklisted && strstr (uri, blacklist[i]))
 			blacklisted = TRUE;
 	}
 
-	if (blacklist)
-		g_strfreev (blacklist);
-
 	return blacklisted;
 }
 
@@ -1269,16 +1734,21 @@ select_page (MainMenuUI *this)
 	GtkToggleButton *button;
 	gint curr_page;
 
-	curr_page = g_settings_get_int (priv->filearea_settings, CURRENT_PAGE_SETTINGS_KEY);
+	curr_page = priv->snapshot.file_class;
 	button    = GTK_TOGGLE_BUTTON (priv->page_selectors [curr_page]);
 
 	if (gtk_toggle_button_get_active (button) == FALSE)
 		gtk_toggle_button_set_active (button, TRUE);
 }
 
-static void
-update_limits (MainMenuUI *this)
+/* Lays out the file area in one pass: gathers the size and visibility of the
+ * favorite tables, works out the limits of both recent tables together, and
+ * touches a recent table only if its limit actually changed.
+ */
+static gboolean
+apply_limits_cb (gpointer data)
 {
+	MainMenuUI        *this = MAIN_MENU_UI (data);
 	MainMenuUIPrivate *priv = PRIVATE (this);
 
 	GObject   *user_tables   [2];
@@ -1292,10 +1762,13 @@ update_limits (MainMenuUI *this)
 	gint max_total_items_default;
 	gint max_total_items_new;
 	gint min_recent_items;
+	gint limit;
 
 	gint i;
 
 
+	priv->limits_id = 0;
+
 	user_tables [0] = G_OBJECT (priv->file_tables [USER_APPS_TABLE]);
 	user_tables [1] = G_OBJECT (priv->file_tables [USER_DOCS_TABLE]);
 
@@ -1307,10 +1780,8 @@ update_limits (MainMenuUI *this)
 
 /* TODO: make this instant apply */
 
-	max_total_items_default =
-		g_settings_get_int (priv->filearea_settings, MAX_TOTAL_ITEMS_SETTINGS_KEY);
-	min_recent_items =
-		g_settings_get_int (priv->filearea_settings, MIN_RECENT_ITEMS_SETTINGS_KEY);
+	max_total_items_default = priv->snapshot.max_total_items;
+	min_recent_items        = priv->snapshot.min_recent_items;
 
 	priv->max_total_items = max_total_items_default;
 
@@ -1337,11 +1808,31 @@ update_limits (MainMenuUI *this)
 	if (priv->max_total_items < (n_rows * n_cols))
 		priv->max_total_items = n_rows * n_cols;
 
-	for (i = 0; i < 2; ++i)
-		g_object_set (
-			recent_tables [i],
-			TILE_TABLE_LIMIT_PROP, priv->max_total_items - n_user_bins [i],
-			NULL);
+	for (i = 0; i < 2; ++i) {
+		limit = priv->max_total_items - n_user_bins [i];
+
+		if (limit == priv->recent_limits [i])
+			continue;
+
+		priv->recent_limits [i] = limit;
+
+		g_object_set (recent_tables [i], TILE_TABLE_LIMIT_PROP, limit, NULL);
+	}
+
+	return FALSE;
+}
+
+/* Schedules a layout pass.  All requests made while handling one batch of
+ * events end up in the same pass, which runs before GTK+ resizes and redraws.
+ */
+static void
+update_limits (MainMenuUI *this)
+{
+	MainMenuUIPrivate *priv = PRIVATE (this);
+
+	if (! priv->limits_id)
+		priv->limits_id = g_idle_add_full (
+			G_PRIORITY_HIGH_IDLE, apply_limits_cb, this, NULL);
 }
 
 static void
@@ -1378,7 +1869,7 @@ hide_slab_if_urgent_close (MainMenuUI *this)
 {
 	MainMenuUIPrivate *priv = PRIVATE (this);
 
-	if (! g_settings_get_boolean (priv->settings, URGENT_CLOSE_SETTINGS_KEY))
+	if (! priv->snapshot.urgent_close)
 		return;
 
 	gtk_toggle_button_set_active (priv->panel_button, FALSE);
@@ -1392,23 +1883,15 @@ set_search_section_visible (MainMenuUI *this)
 	gboolean allowable;
 	gboolean visible;
 
-	gchar **argv;
-	gchar  *found_cmd = NULL;
-
 
 	allowable = g_settings_get_boolean (priv->lockdown_settings, SEARCH_VIS_SETTINGS_KEY);
 
-	if (allowable) {
-		argv = get_search_argv (NULL);
-		found_cmd = g_find_program_in_path (argv [0]);
-
-		visible = (found_cmd != NULL);
+	/* the search runs in the menu, the command is only what Enter falls back to */
+	priv->external_search_available = allowable && (
+		(priv->search_helper && search_helper_is_available (priv->search_helper)) ||
+		search_command_available (this));
 
-		g_strfreev (argv);
-		g_free (found_cmd);
-	}
-	else
-		visible = FALSE;
+	visible = allowable;
 
 	if (visible)
 		gtk_widget_show (priv->search_section);
@@ -1455,46 +1938,83 @@ set_table_section_visible (MainMenuUI *this, TileTable *table)
 		gtk_widget_hide (priv->page_selectors [DIRS_PAGE]);
 }
 
+/* Returns search-command parsed, or NULL if it can't be.  The result is kept
+ * until the setting changes, so that lockdown changes and searches do not go
+ * through the parser each time.
+ */
 static gchar **
-get_search_argv (const gchar *search_txt)
+parse_search_command (MainMenuUI *this)
 {
-	gchar  *cmd;
-	gint    argc;
-	gchar **argv_parsed = NULL;
-
-	gchar **argv = NULL;
-
-	gint i;
+	MainMenuUIPrivate  *priv  = PRIVATE (this);
+	SearchCommandCache *cache = & priv->search_cmd_cache;
 
-	GSettings *settings = NULL;
 
-	settings = g_settings_new (SETTINGS_SCHEMA);
+	if (cache->valid && ! g_strcmp0 (cache->cmd, priv->snapshot.search_cmd))
+		return cache->argv;
 
-	cmd = g_settings_get_string (settings, SEARCH_CMD_SETTINGS_KEY);
+	g_free     (cache->cmd);
+	g_strfreev (cache->argv);
 
-	g_object_unref (settings);
+	cache->valid = TRUE;
+	cache->cmd   = g_strdup (priv->snapshot.search_cmd);
+	cache->argv  = NULL;
 
-	if (! cmd) {
+	if (! cache->cmd) {
 		g_warning ("could not find search command in gsettings [" SEARCH_CMD_SETTINGS_KEY "]\n");
 
 		return NULL;
 	}
 
-	if (! g_shell_parse_argv (cmd, & argc, & argv_parsed, NULL))
-		goto exit;
+	if (! g_shell_parse_argv (cache->cmd, NULL, & cache->argv, NULL))
+		cache->argv = NULL;
 
-	argv = g_new0 (gchar *, argc + 1);
+	return cache->argv;
+}
 
-	for (i = 0; i < argc; ++i) {
-		argv [i] = g_strdup_printf (argv_parsed [i], (search_txt == NULL) ? "" : search_txt);
-	}
+static gboolean
+search_command_available (MainMenuUI *this)
+{
+	gchar    **template;
+	gchar     *program;
+	gboolean   found;
 
-	argv [argc] = NULL;
 
-exit:
+	if (! (template = parse_search_command (this)))
+		return FALSE;
+
+	program = path_cache_lookup (path_cache_get_instance (), template [0]);
+	found   = program != NULL;
+	g_free (program);
+
+	return found;
+}
+
+/* Returns search-command with its program looked up in PATH and search_txt
+ * filled in, or NULL if there is no such program.
+ */
+static gchar **
+get_search_argv (MainMenuUI *this, const gchar *search_txt)
+{
+	gchar **template;
+	gchar **argv;
+	gchar  *program;
+
+	gint i;
 
-	g_free (cmd);
-	g_strfreev (argv_parsed);
+
+	if (! (template = parse_search_command (this)))
+		return NULL;
+
+	if (! (program = path_cache_lookup (path_cache_get_instance (), template [0])))
+		return NULL;
+
+	argv = g_new0 (gchar *, g_strv_length (template) + 1);
+
+	/* only the arguments take the search text */
+	argv [0] = program;
+
+	for (i = 1; template [i]; ++i)
+		argv [i] = g_strdup_printf (template [i], (search_txt == NULL) ? "" : search_txt);
 
 	return argv;
 }
@@ -1552,18 +2072,28 @@ launch_search (MainMenuUI *this)
 
 	search_txt = gtk_entry_get_text (GTK_ENTRY (priv->search_entry));
 
-	argv = get_search_argv (search_txt);
+	/* a resident helper only needs to be told, otherwise start the tool, and
+	 * without either open the best match in the menu */
+	if (! (priv->search_helper && search_helper_send (priv->search_helper, search_txt))) {
+		argv = get_search_argv (this, search_txt);
 
-	g_spawn_async (NULL, argv, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL, NULL, & error);
+		if (argv)
+			g_spawn_async (NULL, argv, NULL, 0, NULL, NULL, NULL, & error);
+		else if (search_txt [0]) {
+			menu_search_activate_first (priv->menu_search);
 
-	if (error) {
-		cmd = g_strjoinv (" ", argv);
-		libslab_handle_g_error (
-			& error, "%s: can't execute search [%s]\n", G_STRFUNC, cmd);
-		g_free (cmd);
-	}
+			return;
+		}
+
+		if (error) {
+			cmd = g_strjoinv (" ", argv);
+			libslab_handle_g_error (
+				& error, "%s: can't execute search [%s]\n", G_STRFUNC, cmd);
+			g_free (cmd);
+		}
 
-	g_strfreev (argv);
+		g_strfreev (argv);
+	}
 
 	hide_slab_if_urgent_close (this);
 
@@ -1581,7 +2111,7 @@ grab_pointer_and_keyboard (MainMenuUI *this, guint32 time)
 	if (time == 0)
 		time = GDK_CURRENT_TIME;
 
-	if (g_settings_get_boolean (priv->settings, URGENT_CLOSE_SETTINGS_KEY)) {
+	if (priv->snapshot.urgent_close) {
 		gtk_widget_grab_focus (priv->slab_window);
 		gtk_grab_add          (priv->slab_window);
 
@@ -1610,8 +2140,12 @@ grab_pointer_and_keyboard (MainMenuUI *this, guint32 time)
 	}
 }
 
+/* Applies the lockdown settings behind the given LockdownChange flags, and
+ * nothing else: only the affected sections are re-shown and only the affected
+ * tables are reloaded.
+ */
 static void
-apply_lockdown_settings (MainMenuUI *this)
+apply_lockdown_changes (MainMenuUI *this, guint changes)
 {
 	MainMenuUIPrivate *priv = PRIVATE (this);
 
@@ -1620,71 +2154,117 @@ apply_lockdown_settings (MainMenuUI *this)
 	gboolean      system_area_visible;
 	gint          i;
 
-	libslab_checkpoint ("apply_lockdown_settings(): start");
+	CHECKPOINT ("apply_lockdown_settings(): start");
 
-	more_link_visible    = g_settings_get_boolean (priv->lockdown_settings, MORE_LINK_VIS_SETTINGS_KEY);
-	status_area_visible  = g_settings_get_boolean (priv->lockdown_settings, STATUS_VIS_SETTINGS_KEY);
-	system_area_visible  = g_settings_get_boolean (priv->lockdown_settings, SYSTEM_VIS_SETTINGS_KEY);
+	if (changes & LOCKDOWN_MORE_LINKS) {
+		more_link_visible = g_settings_get_boolean (priv->lockdown_settings, MORE_LINK_VIS_SETTINGS_KEY);
 
-	for (i = 0; i < 3; ++i)
-		if (more_link_visible)
-			gtk_widget_show (priv->more_sections [i]);
+		for (i = 0; i < 3; ++i)
+			if (more_link_visible)
+				gtk_widget_show (priv->more_sections [i]);
+			else
+				gtk_widget_hide (priv->more_sections [i]);
+	}
+
+	if (changes & LOCKDOWN_SEARCH_AREA)
+		set_search_section_visible (this);
+
+	if (changes & LOCKDOWN_STATUS_AREA) {
+		status_area_visible = g_settings_get_boolean (priv->lockdown_settings, STATUS_VIS_SETTINGS_KEY);
+
+		if (status_area_visible)
+			gtk_widget_show (priv->status_section);
 		else
-			gtk_widget_hide (priv->more_sections [i]);
+			gtk_widget_hide (priv->status_section);
+	}
 
-	set_search_section_visible (this);
+	if (changes & LOCKDOWN_SYSTEM_AREA) {
+		system_area_visible = g_settings_get_boolean (priv->lockdown_settings, SYSTEM_VIS_SETTINGS_KEY);
 
-	if (status_area_visible)
-		gtk_widget_show (priv->status_section);
-	else
-		gtk_widget_hide (priv->status_section);
+		if (system_area_visible)
+			gtk_widget_show (priv->system_section);
+		else
+			gtk_widget_hide (priv->system_section);
+	}
+
+	for (i = 0; i < 5; ++i) {
+		if (! (changes & LOCKDOWN_VISIBLE (i)))
+			continue;
+
+		priv->allowable_types [i] =
+			g_settings_get_boolean (priv->lockdown_settings, table_visibility_keys [i]);
 
-	if (system_area_visible)
-		gtk_widget_show (priv->system_section);
-	else
-		gtk_widget_hide (priv->system_section);
-
-	priv->allowable_types [USER_APPS_TABLE] =
-		g_settings_get_boolean (priv->lockdown_settings, USER_APPS_VIS_SETTINGS_KEY);
-	priv->allowable_types [RCNT_APPS_TABLE] =
-		g_settings_get_boolean (priv->lockdown_settings, RCNT_APPS_VIS_SETTINGS_KEY);
-	priv->allowable_types [USER_DOCS_TABLE] =
-		g_settings_get_boolean (priv->lockdown_settings, USER_DOCS_VIS_SETTINGS_KEY);
-	priv->allowable_types [RCNT_DOCS_TABLE] =
-		g_settings_get_boolean (priv->lockdown_settings, RCNT_DOCS_VIS_SETTINGS_KEY);
-	priv->allowable_types [USER_DIRS_TABLE] =
-		g_settings_get_boolean (priv->lockdown_settings, USER_DIRS_VIS_SETTINGS_KEY);
-
-	for (i = 0; i < 5; ++i)
 		set_table_section_visible (this, priv->file_tables [i]);
+	}
+
+	if (changes & LOCKDOWN_RELOAD_SYSTEM) {
+		CHECKPOINT ("apply_lockdown_settings(): loading sys_table");
+		tile_table_reload (priv->sys_table);
+	}
 
-	libslab_checkpoint ("apply_lockdown_settings(): loading sys_table");
-	tile_table_reload (priv->sys_table);
+	if (changes & LOCKDOWN_RELOAD (USER_APPS_TABLE)) {
+		CHECKPOINT ("apply_lockdown_settings(): loading user_apps_table");
+		tile_table_reload (priv->file_tables [USER_APPS_TABLE]);
+	}
 
-	libslab_checkpoint ("apply_lockdown_settings(): loading user_apps_table");
-	tile_table_reload (priv->file_tables [USER_APPS_TABLE]);
+	if (changes & LOCKDOWN_RELOAD (RCNT_APPS_TABLE)) {
+		CHECKPOINT ("apply_lockdown_settings(): loading rcnt_apps_table");
+		tile_table_reload (priv->file_tables [RCNT_APPS_TABLE]);
+	}
 
-	libslab_checkpoint ("apply_lockdown_settings(): loading user_docs_table");
-	tile_table_reload (priv->file_tables [USER_DOCS_TABLE]);
+	if (changes & LOCKDOWN_RELOAD (USER_DOCS_TABLE)) {
+		CHECKPOINT ("apply_lockdown_settings(): loading user_docs_table");
+		tile_table_reload (priv->file_tables [USER_DOCS_TABLE]);
+	}
 
-	libslab_checkpoint ("apply_lockdown_settings(): loading user_dirs_table");
-	tile_table_reload (priv->file_tables [USER_DIRS_TABLE]);
+	if (changes & LOCKDOWN_RELOAD (USER_DIRS_TABLE)) {
+		CHECKPOINT ("apply_lockdown_settings(): loading user_dirs_table");
+		tile_table_reload (priv->file_tables [USER_DIRS_TABLE]);
+	}
 
-	libslab_checkpoint ("apply_lockdown_settings(): update_limits");
-	update_limits (this);
+	/* the limits only depend on the favorite sections */
+	if (changes & (
+		LOCKDOWN_VISIBLE (USER_APPS_TABLE) | LOCKDOWN_VISIBLE (USER_DOCS_TABLE) |
+		LOCKDOWN_RELOAD  (USER_APPS_TABLE) | LOCKDOWN_RELOAD  (USER_DOCS_TABLE))
+	) {
+		CHECKPOINT ("apply_lockdown_settings(): update_limits");
+		update_limits (this);
+	}
 
-	libslab_checkpoint ("apply_lockdown_settings(): end");
+	CHECKPOINT ("apply_lockdown_settings(): end");
 }
 
 static void
-bind_beagle_search_key (MainMenuUI *this)
+apply_lockdown_settings (MainMenuUI *this)
 {
-	xmlDocPtr  doc;
-	xmlNodePtr node;
+	apply_lockdown_changes (this, LOCKDOWN_ALL);
+}
 
-	gchar    *path;
-	gchar    *contents;
-	gsize     length;
+static gboolean
+apply_lockdown_changes_cb (gpointer data)
+{
+	MainMenuUIPrivate *priv = PRIVATE (data);
+
+	guint changes = priv->lockdown_changes;
+
+
+	priv->lockdown_changes    = 0;
+	priv->lockdown_changes_id = 0;
+
+	apply_lockdown_changes (MAIN_MENU_UI (data), changes);
+
+	return FALSE;
+}
+
+static void
+bind_beagle_search_key (MainMenuUI *this)
+{
+	xmlDocPtr  doc;
+	xmlNodePtr node;
+
+	gchar    *path;
+	gchar    *contents;
+	gsize     length;
 	gboolean  success;
 
 	gchar *key;
@@ -1752,97 +2332,392 @@ exit:
 	xmlFreeDoc (doc);
 }
 
-static GBookmarkFile *
-load_recently_used_store (void)
+/* Updates the bookmark agents for the recently-used documents, from store, the
+ * recently-used store read by a refresh job, and for the recently-used apps,
+ * from the usage journal.  The journal starts out with the apps of the
+ * recently-used store.
+ */
+static void
+update_recently_used_bookmark_agents (MainMenuUI *this, GBookmarkFile *store, gboolean apps)
 {
-	GBookmarkFile *store;
-	char *filename;
+	MainMenuUIPrivate *priv = PRIVATE (this);
+	UsageJournal  *journal = usage_journal_get_instance ();
+	GBookmarkFile *app_store;
+	gboolean       reranked;
 
-	store = g_bookmark_file_new ();
+	if (store && usage_journal_needs_import (journal)) {
+		usage_journal_import (journal, store);
+		apps = TRUE;
+	}
+
+	/* frecency before the agents, so the layers sort their new items by the
+	 * new ranks; ranks can change while the agents' items stay the same */
+	if (apps) {
+		app_store = usage_journal_get_store (journal);
+		reranked  = frecency_update_from_store (frecency_get_instance (), app_store, FRECENCY_APPS);
 
-	filename = get_recently_used_store_filename ();
+		bookmark_agent_update_from_bookmark_file (priv->bm_agents[BOOKMARK_STORE_RECENT_APPS], app_store);
 
-	/* FIXME: if we can't load the store, do we need to hide the
-	 * recently-used sections in the GUI?  If so, do that in the caller(s)
-	 * of this function, not here.
-	 */
+		if (reranked)
+			bookmark_layer_refresh (bookmark_layer_get_for_agent (priv->bm_agents[BOOKMARK_STORE_RECENT_APPS]));
+	}
 
-	libslab_checkpoint ("main-menu-ui.c: load_recently_used_store(): start loading %s", filename);
-	g_bookmark_file_load_from_file (store, filename, NULL); /* NULL-GError */
-	libslab_checkpoint ("main-menu-ui.c: load_recently_used_store(): end loading %s", filename);
+	if (store) {
+		reranked = frecency_update_from_store (frecency_get_instance (), store, FRECENCY_DOCS);
 
-	g_free (filename);
+		bookmark_agent_update_from_bookmark_file (priv->bm_agents[BOOKMARK_STORE_RECENT_DOCS], store);
 
-	return store;
+		if (reranked)
+			bookmark_layer_refresh (bookmark_layer_get_for_agent (priv->bm_agents[BOOKMARK_STORE_RECENT_DOCS]));
+	}
 }
 
-/* Updates the bookmark agents for the recently-used apps and documents, by reading the
- * recently-used store.
+/* If the recently-used store or the usage journal has changed since the last
+ * time we updated from it, this has a refresh job update our view of it and
+ * the corresponding sections in the slab_window.  The job parses the store in
+ * its thread; the journal is only read, for what was appended, once the job
+ * is back on the main loop.
  */
 static void
-update_recently_used_bookmark_agents (MainMenuUI *this)
+update_recently_used_sections (MainMenuUI *this)
 {
 	MainMenuUIPrivate *priv = PRIVATE (this);
-	GBookmarkFile *store;
+	guint what = 0;
+
+	CHECKPOINT ("main-menu-ui.c: update_recently_used_sections() start");
+
+	if (priv->recently_used_store_has_changed)
+		what |= REFRESH_RECENT_STORE;
+
+	if (priv->usage_journal_has_changed)
+		what |= REFRESH_RECENT_APPS;
 
-	store = load_recently_used_store ();
+	if (what)
+		start_refresh (this, what);
 
-	bookmark_agent_update_from_bookmark_file (priv->bm_agents[BOOKMARK_STORE_RECENT_APPS], store);
-	bookmark_agent_update_from_bookmark_file (priv->bm_agents[BOOKMARK_STORE_RECENT_DOCS], store);
+	if (!priv->recently_used_store_monitor)
+		setup_recently_used_store_monitor (this, FALSE);
 
-	g_bookmark_file_free (store);
+	CHECKPOINT ("main-menu-ui.c: update_recently_used_sections() end");
 }
 
-/* Updates the recently-used tile tables from their corresponding bookmark agents */
+/* Brings the models behind the slab_window up to date: the network status
+ * when it has to be polled, the disk usage and, if the recently-used store
+ * could not be monitored, the recent sections.  The I/O runs in a refresh
+ * job's thread; presenting just shows the result.
+ */
 static void
-update_recently_used_tables (MainMenuUI *this)
+refresh_models (MainMenuUI *this)
 {
 	MainMenuUIPrivate *priv = PRIVATE (this);
 
-	tile_table_reload (priv->file_tables[RCNT_APPS_TABLE]);
-	tile_table_reload (priv->file_tables[RCNT_DOCS_TABLE]);
+	guint what = REFRESH_DISK;
+
+
+	CHECKPOINT ("main-menu-ui.c: refresh_models()");
+
+#ifdef HAVE_NETWORK
+	if (network_tile_needs_polling (priv->network_status))
+		what |= REFRESH_NETWORK;
+#endif
+
+	start_refresh (this, what);
+
+	if (! priv->recently_used_store_monitor) {
+		priv->recently_used_store_has_changed = TRUE;
+		priv->usage_journal_has_changed       = TRUE;
+	}
+
+	update_recently_used_sections (this);
+
+	priv->models_refreshed_at = g_get_monotonic_time ();
 }
 
-/* If the recently-used store has changed since the last time we updated from
- * it, this updates our view of the store and the corresponding sections in the
- * slab_window.
+/* only runs while the slab_window is hidden, so that the models are current
+ * when it is shown */
+static gboolean
+refresh_models_cb (gpointer data)
+{
+	refresh_models (MAIN_MENU_UI (data));
+
+	return TRUE;
+}
+
+/* Runs what in a thread of its own, or once the running job is done, as the
+ * tiles and agents it feeds can only take one set of results at a time.
  */
 static void
-update_recently_used_sections (MainMenuUI *this)
+start_refresh (MainMenuUI *this, guint what)
 {
 	MainMenuUIPrivate *priv = PRIVATE (this);
 
-	libslab_checkpoint ("main-menu-ui.c: update_recently_used_sections() start");
+	RefreshJob *job;
+
 
-	if (priv->recently_used_store_has_changed) {
-		update_recently_used_bookmark_agents (this);
-		update_recently_used_tables (this);
+	if (priv->refreshing) {
+		priv->refresh_pending |= what;
 
-		priv->recently_used_store_has_changed = FALSE;
+		return;
 	}
 
-	if (!priv->recently_used_store_monitor)
-		setup_recently_used_store_monitor (this, FALSE);
+	priv->refreshing = TRUE;
+
+	job = g_new0 (RefreshJob, 1);
+	job->ui   = g_object_ref (this);
+	job->what = what;
 
-	libslab_checkpoint ("main-menu-ui.c: update_recently_used_sections() end");
+	/* the journal needs no thread, but goes through idle all the same */
+	if (what & ~REFRESH_RECENT_APPS)
+		g_thread_unref (g_thread_new ("menu-refresh", refresh_thread, job));
+	else
+		g_idle_add (refresh_done_cb, job);
 }
 
-/* Updates the slab_window's sections that need updating and presents the window */
-static void
-present_slab_window (MainMenuUI *this)
+/* runs in its own thread */
+static gpointer
+refresh_thread (gpointer data)
+{
+	RefreshJob *job = data;
+
+	gchar *filename;
+
+
+#ifdef HAVE_NETWORK
+	if (job->what & REFRESH_NETWORK)
+		job->network_info = network_status_agent_poll_device_info ();
+#endif
+
+	if (job->what & REFRESH_DISK)
+		hard_drive_status_get_usage (& job->available_bytes, & job->capacity_bytes);
+
+	if (job->what & REFRESH_RECENT_STORE) {
+		filename   = get_recently_used_store_filename ();
+		job->store = g_bookmark_file_new ();
+
+		/* FIXME: if we can't load the store, do we need to hide the
+		 * recently-used sections in the GUI? */
+		g_bookmark_file_load_from_file (job->store, filename, NULL); /* NULL-GError */
+
+		g_free (filename);
+	}
+
+	g_idle_add (refresh_done_cb, job);
+
+	return NULL;
+}
+
+/* Hands the results of a refresh job to the tiles and the agents.  While the
+ * slab_window is being presented they wait for the first frame, so that a
+ * click right after the job started is not kept waiting by it.
+ */
+static gboolean
+refresh_done_cb (gpointer data)
 {
+	RefreshJob        *job  = data;
+	MainMenuUI        *this = job->ui;
 	MainMenuUIPrivate *priv = PRIVATE (this);
 
+	guint what;
+
+
+	if (priv->presenting) {
+		priv->held_refresh = job;
+
+		return FALSE;
+	}
+
+	priv->refreshing = FALSE;
+
 #ifdef HAVE_NETWORK
-	network_tile_update_status (priv->network_status);
+	if (job->what & REFRESH_NETWORK)
+		network_tile_set_status (priv->network_status, job->network_info);
 #endif
 
-	update_recently_used_sections (this);
+	if (job->what & REFRESH_DISK)
+		hard_drive_status_tile_set_usage (
+			HARD_DRIVE_STATUS_TILE (priv->hard_drive_status), job->available_bytes, job->capacity_bytes);
+
+	/* a journal that has yet to be started needs the store */
+	if (
+		(job->what & REFRESH_RECENT_APPS) && ! job->store &&
+		usage_journal_needs_import (usage_journal_get_instance ())
+	)
+		priv->refresh_pending |= REFRESH_RECENT_STORE;
+	else if (job->what & (REFRESH_RECENT_STORE | REFRESH_RECENT_APPS)) {
+		/* whatever changed since the job started is picked up by the next */
+		if (job->store)
+			priv->recently_used_store_has_changed = FALSE;
+
+		update_recently_used_bookmark_agents (this, job->store, priv->usage_journal_has_changed);
+
+		priv->usage_journal_has_changed = FALSE;
+	}
+
+	if (job->store)
+		g_bookmark_file_free (job->store);
+
+	if (priv->refresh_pending) {
+		what = priv->refresh_pending;
+		priv->refresh_pending = 0;
+
+		start_refresh (this, what);
+	}
+
+	g_object_unref (this);
+	g_free (job);
+
+	return FALSE;
+}
+
+/* Presents the slab_window as it is.  Everything shown has been computed in
+ * the background, so nothing here touches a file, D-Bus or a socket; run with
+ * IO_GUARD_ENV_VAR set to have any such access reported until the first frame
+ * is on screen.
+ */
+static void
+present_slab_window (MainMenuUI *this)
+{
+	MainMenuUIPrivate *priv = PRIVATE (this);
+
+	io_guard_enter ("present_slab_window()");
+	app_prefetch_set_presenting (priv->app_prefetch, TRUE);
+
+	priv->presenting = TRUE;
+
+	priv->awaiting_first_frame = TRUE;
 
 	gtk_window_set_screen (GTK_WINDOW (priv->slab_window), gtk_widget_get_screen (GTK_WIDGET (priv->panel_applet)));
+
+	/* a warmed-up window already knows its size, so place it before mapping
+	 * rather than moving it from slab_window_allocate_cb () afterwards */
+	if (priv->is_warm) {
+		compute_slab_window_position (this, & priv->slab_x, & priv->slab_y);
+		priv->slab_pos_valid = TRUE;
+
+		gtk_window_move (GTK_WINDOW (priv->slab_window), priv->slab_x, priv->slab_y);
+	}
+
 	gtk_window_present_with_time (GTK_WINDOW (priv->slab_window), gtk_get_current_event_time ());
 }
 
+/* Walks the slab window's widget tree, realizing every visible widget and
+ * drawing each label's layout into cr so that Pango's shaping and the glyph
+ * caches are filled before the window is shown for the first time.
+ */
+static void
+warm_up_widget (GtkWidget *widget, gpointer data)
+{
+	cairo_t *cr = data;
+
+
+	if (! gtk_widget_get_visible (widget))
+		return;
+
+	gtk_widget_realize (widget);
+
+	if (GTK_IS_LABEL (widget)) {
+		cairo_move_to (cr, widget->allocation.x, widget->allocation.y);
+		pango_cairo_show_layout (cr, gtk_label_get_layout (GTK_LABEL (widget)));
+	}
+
+	if (GTK_IS_CONTAINER (widget))
+		gtk_container_forall (GTK_CONTAINER (widget), warm_up_widget, cr);
+}
+
+/* Lays the hidden slab window out once from idle.  Size requests load the
+ * themed icons and measure every label, and the offscreen pass over the
+ * labels renders their glyphs, so presenting the window only has to map it.
+ */
+static gboolean
+warm_up_slab_window_cb (gpointer data)
+{
+	MainMenuUI        *this = MAIN_MENU_UI (data);
+	MainMenuUIPrivate *priv = PRIVATE (this);
+
+	GtkRequisition   req;
+	GtkAllocation    alloc;
+	cairo_surface_t *surface;
+	cairo_t         *cr;
+	GTimer          *timer;
+
+
+	priv->warm_up_id = 0;
+
+	if (gtk_widget_get_visible (priv->slab_window))
+		return FALSE;
+
+	timer = g_timer_new ();
+
+	gtk_widget_size_request (priv->slab_window, & req);
+
+	alloc.x      = 0;
+	alloc.y      = 0;
+	alloc.width  = req.width;
+	alloc.height = req.height;
+
+	gtk_widget_size_allocate (priv->slab_window, & alloc);
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, MAX (req.width, 1), MAX (req.height, 1));
+	cr = cairo_create (surface);
+
+	gtk_widget_realize (priv->slab_window);
+	gtk_container_forall (GTK_CONTAINER (priv->slab_window), warm_up_widget, cr);
+
+	cairo_destroy (cr);
+	cairo_surface_destroy (surface);
+
+	compute_slab_window_position (this, & priv->slab_x, & priv->slab_y);
+	priv->slab_pos_valid = TRUE;
+
+	gtk_window_move (GTK_WINDOW (priv->slab_window), priv->slab_x, priv->slab_y);
+
+	priv->is_warm = TRUE;
+
+	CHECKPOINT ("warm_up_slab_window_cb(): slab window warmed up in %.1f ms",
+		g_timer_elapsed (timer, NULL) * 1000.0);
+
+	g_timer_destroy (timer);
+
+	return FALSE;
+}
+
+/* Runs once the redraw triggered by presenting the window has been handled,
+ * i.e. right after the first complete frame.
+ */
+static gboolean
+first_frame_done_cb (gpointer data)
+{
+	MainMenuUIPrivate *priv = PRIVATE (data);
+
+	CHECKPOINT ("present_slab_window(): first frame %.1f ms after the click (%s window)",
+		g_timer_elapsed (priv->present_timer, NULL) * 1000.0,
+		priv->is_warm ? "warm" : "cold");
+
+	end_presenting (MAIN_MENU_UI (data));
+
+	return FALSE;
+}
+
+/* The first frame is on screen, or the window went away before it was */
+static void
+end_presenting (MainMenuUI *this)
+{
+	MainMenuUIPrivate *priv = PRIVATE (this);
+
+	RefreshJob *job;
+
+
+	io_guard_leave ();
+	app_prefetch_set_presenting (priv->app_prefetch, FALSE);
+
+	priv->presenting = FALSE;
+
+	if ((job = priv->held_refresh)) {
+		priv->held_refresh = NULL;
+		refresh_done_cb (job);
+	}
+}
+
 static void
 panel_button_clicked_cb (GtkButton *button, gpointer user_data)
 {
@@ -1855,6 +2730,15 @@ panel_button_clicked_cb (GtkButton *button, gpointer user_data)
 
 	gboolean visible;
 
+
+	/* the first frame is timed from here, a cold open's delayed setup
+	 * being part of what the user waits for; the hotkey comes through
+	 * here as well */
+	if (! priv->present_timer)
+		priv->present_timer = g_timer_new ();
+	else
+		g_timer_start (priv->present_timer);
+
 	main_menu_delayed_setup (this);
 
 	detector = DOUBLE_CLICK_DETECTOR (
@@ -1874,6 +2758,61 @@ panel_button_clicked_cb (GtkButton *button, gpointer user_data)
 	gtk_toggle_button_set_active (priv->panel_button, visible);
 }
 
+/* Fires once the pointer has rested on the panel button briefly, and does
+ * the work a click would otherwise wait for: the delayed setup if it hasn't
+ * run yet, or else starts a refresh of models that have gone stale.  That
+ * runs in a job, and a click that comes first presents what the models hold
+ * so far; the job's results follow the first frame.
+ */
+static gboolean
+hover_refresh_cb (gpointer data)
+{
+	MainMenuUI        *this = MAIN_MENU_UI (data);
+	MainMenuUIPrivate *priv = PRIVATE (this);
+
+
+	priv->hover_refresh_id = 0;
+
+	if (! priv->recently_used_store_monitor) {
+		CHECKPOINT ("hover_refresh_cb(): running delayed setup");
+		main_menu_delayed_setup (this);
+	}
+	else if (
+		! gtk_widget_get_visible (priv->slab_window) &&
+		(priv->recently_used_store_has_changed || priv->usage_journal_has_changed ||
+			g_get_monotonic_time () - priv->models_refreshed_at > MODEL_STALE_SECONDS * G_USEC_PER_SEC)
+	)
+		refresh_models (this);
+
+	return FALSE;
+}
+
+static gboolean
+panel_button_enter_notify_cb (GtkWidget *widget, GdkEventCrossing *event, gpointer user_data)
+{
+	MainMenuUIPrivate *priv = PRIVATE (user_data);
+
+	if (! priv->hover_refresh_id && ! (priv->slab_window && gtk_widget_get_visible (priv->slab_window)))
+		priv->hover_refresh_id = g_timeout_add (
+			HOVER_REFRESH_DELAY_MILLISECONDS, hover_refresh_cb, user_data);
+
+	return FALSE;
+}
+
+static gboolean
+panel_button_leave_notify_cb (GtkWidget *widget, GdkEventCrossing *event, gpointer user_data)
+{
+	MainMenuUIPrivate *priv = PRIVATE (user_data);
+
+	/* only the pending refresh is dropped, one that already ran stands */
+	if (priv->hover_refresh_id) {
+		g_source_remove (priv->hover_refresh_id);
+		priv->hover_refresh_id = 0;
+	}
+
+	return FALSE;
+}
+
 static gboolean
 panel_button_button_press_cb (GtkWidget *widget, GdkEventButton *event, gpointer user_data)
 {
@@ -1896,8 +2835,10 @@ panel_button_drag_data_rcv_cb (GtkWidget *widget, GdkDragContext *context, gint
 {
 	MainMenuUIPrivate *priv = PRIVATE (user_data);
 
-	gchar **uris;
-	gint    uri_len;
+	gchar     **uris;
+	gint        uri_len;
+	GPtrArray  *app_uris;
+	GPtrArray  *doc_uris;
 
 	gint i;
 
@@ -1913,6 +2854,9 @@ panel_button_drag_data_rcv_cb (GtkWidget *widget, GdkDragContext *context, gint
 	if (! uris)
 		return;
 
+	app_uris = g_ptr_array_new ();
+	doc_uris = g_ptr_array_new ();
+
 	for (i = 0; uris [i]; ++i) {
 		if (strncmp (uris [i], "file://", 7))
 			continue;
@@ -1920,32 +2864,37 @@ panel_button_drag_data_rcv_cb (GtkWidget *widget, GdkDragContext *context, gint
 		uri_len = strlen (uris [i]);
 
 		if (! strcmp (& uris [i] [uri_len - 8], ".desktop"))
-			tile_table_add_uri (priv->file_tables [USER_APPS_TABLE], uris [i]);
+			g_ptr_array_add (app_uris, uris [i]);
 		else
-			tile_table_add_uri (priv->file_tables [USER_DOCS_TABLE], uris [i]);
+			g_ptr_array_add (doc_uris, uris [i]);
 	}
 
+	g_ptr_array_add (app_uris, NULL);
+	g_ptr_array_add (doc_uris, NULL);
+
+	tile_table_add_uris (
+		priv->file_tables [USER_APPS_TABLE], (const gchar * const *) app_uris->pdata);
+	tile_table_add_uris (
+		priv->file_tables [USER_DOCS_TABLE], (const gchar * const *) doc_uris->pdata);
+
+	g_ptr_array_free (app_uris, TRUE);
+	g_ptr_array_free (doc_uris, TRUE);
+
 	g_strfreev (uris);
 }
 
-static gboolean
-slab_window_expose_cb (GtkWidget *widget, GdkEventExpose *event, gpointer user_data)
+/* Draws the window decoration (pane fills, outlines and the top pane gradient)
+ * into cr.  None of it depends on what is being exposed, so it is drawn into
+ * priv->bg_surface once per size or style change and only copied on expose.
+ */
+static void
+render_background (MainMenuUI *this, GtkWidget *widget, cairo_t *cr)
 {
-	MainMenuUIPrivate *priv = PRIVATE (user_data);
+	MainMenuUIPrivate *priv = PRIVATE (this);
 
-	cairo_t         *cr;
 	cairo_pattern_t *gradient;
 
 
-	cr = gdk_cairo_create (widget->window);
-
-	cairo_rectangle (
-		cr,
-		event->area.x, event->area.y,
-		event->area.width, event->area.height);
-
-	cairo_clip (cr);
-
 /* draw window background */
 
 	cairo_rectangle (
@@ -2046,11 +2995,81 @@ slab_window_expose_cb (GtkWidget *widget, GdkEventExpose *event, gpointer user_d
 	cairo_fill_preserve (cr);
 
 	cairo_pattern_destroy (gradient);
+}
+
+static void
+invalidate_background (MainMenuUI *this)
+{
+	MainMenuUIPrivate *priv = PRIVATE (this);
+
+	if (priv->bg_surface) {
+		cairo_surface_destroy (priv->bg_surface);
+		priv->bg_surface = NULL;
+	}
+}
+
+static gboolean
+slab_window_expose_cb (GtkWidget *widget, GdkEventExpose *event, gpointer user_data)
+{
+	MainMenuUI        *this = MAIN_MENU_UI (user_data);
+	MainMenuUIPrivate *priv = PRIVATE (this);
+
+	cairo_t *cr;
+	cairo_t *bg_cr;
+
+
+	cr = gdk_cairo_create (widget->window);
+
+	if (! priv->bg_surface) {
+		priv->bg_surface = cairo_surface_create_similar (
+			cairo_get_target (cr), CAIRO_CONTENT_COLOR,
+			widget->allocation.x + widget->allocation.width,
+			widget->allocation.y + widget->allocation.height);
+
+		bg_cr = cairo_create (priv->bg_surface);
+		render_background (this, widget, bg_cr);
+		cairo_destroy (bg_cr);
+
+		priv->n_bg_renders++;
+
+		CHECKPOINT (
+			"slab_window_expose_cb(): rendered background (%u renders, %u exposes)",
+			priv->n_bg_renders, priv->n_exposes);
+	}
+
+	priv->n_exposes++;
+
+	if (priv->awaiting_first_frame) {
+		priv->awaiting_first_frame = FALSE;
+
+		/* the children are exposed right after us, before any lower priority source */
+		g_idle_add_full (GDK_PRIORITY_REDRAW + 1, first_frame_done_cb, this, NULL);
+	}
+
+	gdk_cairo_region (cr, event->region);
+	cairo_clip (cr);
+
+	cairo_set_source_surface (cr, priv->bg_surface, 0, 0);
+	cairo_paint (cr);
+
 	cairo_destroy (cr);
 
 	return FALSE;
 }
 
+static void
+slab_window_style_set_cb (GtkWidget *widget, GtkStyle *prev_style, gpointer user_data)
+{
+	invalidate_background (MAIN_MENU_UI (user_data));
+}
+
+/* the decoration traces the window, left pane and top pane allocations */
+static void
+slab_pane_allocate_cb (GtkWidget *widget, GtkAllocation *alloc, gpointer user_data)
+{
+	invalidate_background (MAIN_MENU_UI (user_data));
+}
+
 static gboolean
 slab_window_key_press_cb (GtkWidget *widget, GdkEventKey *event, gpointer user_data)
 {
@@ -2096,11 +3115,13 @@ slab_window_button_press_cb (GtkWidget *widget, GdkEventButton *event, gpointer
 	return FALSE;
 }
 
+/* Computes where the slab window goes, next to the panel button and within
+ * the button's monitor, from the window's current allocation.
+ */
 static void
-slab_window_allocate_cb (GtkWidget *widget, GtkAllocation *alloc, gpointer user_data)
+compute_slab_window_position (MainMenuUI *this, gint *x, gint *y)
 {
-	MainMenuUI        *this = MAIN_MENU_UI (user_data);
-	MainMenuUIPrivate *priv = PRIVATE      (this);
+	MainMenuUIPrivate *priv = PRIVATE (this);
 
 	GdkScreen *panel_button_screen;
 
@@ -2164,13 +3185,43 @@ slab_window_allocate_cb (GtkWidget *widget, GtkAllocation *alloc, gpointer user_
 			slab_geom.y = MAX (monitor_geom.y, monitor_geom.y + monitor_geom.height - slab_geom.height);
 	}
 
-	gtk_window_move (GTK_WINDOW (priv->slab_window), slab_geom.x, slab_geom.y);
+	*x = slab_geom.x;
+	*y = slab_geom.y;
+}
+
+static void
+slab_window_allocate_cb (GtkWidget *widget, GtkAllocation *alloc, gpointer user_data)
+{
+	MainMenuUI        *this = MAIN_MENU_UI (user_data);
+	MainMenuUIPrivate *priv = PRIVATE      (this);
+
+	gint x;
+	gint y;
+
+
+	compute_slab_window_position (this, & x, & y);
+
+	if (priv->slab_pos_valid && x == priv->slab_x && y == priv->slab_y)
+		return;
+
+	priv->slab_x         = x;
+	priv->slab_y         = y;
+	priv->slab_pos_valid = TRUE;
+
+	gtk_window_move (GTK_WINDOW (priv->slab_window), x, y);
 }
 
 static void
 slab_window_map_event_cb (GtkWidget *widget, GdkEvent *event, gpointer user_data)
 {
+	MainMenuUIPrivate *priv = PRIVATE (user_data);
+
 	grab_pointer_and_keyboard (MAIN_MENU_UI (user_data), gdk_event_get_time (event));
+
+	if (priv->model_refresh_id) {
+		g_source_remove (priv->model_refresh_id);
+		priv->model_refresh_id = 0;
+	}
 }
 
 static void
@@ -2178,6 +3229,14 @@ slab_window_unmap_event_cb (GtkWidget *widget, GdkEvent *event, gpointer user_da
 {
 	MainMenuUIPrivate *priv = PRIVATE (user_data);
 
+	end_presenting (MAIN_MENU_UI (user_data));
+
+	/* catch up on anything that changed while we were showing */
+	refresh_models (MAIN_MENU_UI (user_data));
+
+	if (! priv->model_refresh_id)
+		priv->model_refresh_id = g_timeout_add_seconds (MODEL_REFRESH_SECONDS, refresh_models_cb, user_data);
+
 	if (priv->ptr_is_grabbed) {
 		gdk_pointer_ungrab (gdk_event_get_time (event));
 		priv->ptr_is_grabbed = FALSE;
@@ -2226,8 +3285,81 @@ search_entry_activate_cb (GtkEntry *entry, gpointer user_data)
 {
 	const gchar *entry_text = gtk_entry_get_text (entry);
 
-	if (entry_text && strlen (entry_text) >= 1)
+	if (! (entry_text && strlen (entry_text) >= 1))
+		return;
+
+	if (PRIVATE (user_data)->external_search_available)
 		launch_search (MAIN_MENU_UI (user_data));
+	else
+		menu_search_activate_first (PRIVATE (user_data)->menu_search);
+}
+
+static void
+search_entry_changed_cb (GtkEditable *editable, gpointer user_data)
+{
+	MainMenuUIPrivate *priv = PRIVATE (user_data);
+
+	const gchar *query;
+	GtkWidget   *notebook;
+	GtkWidget   *results;
+
+
+	query    = gtk_entry_get_text (GTK_ENTRY (editable));
+	notebook = GTK_WIDGET (priv->file_section);
+	results  = menu_search_get_widget (priv->menu_search);
+
+	menu_search_set_query (priv->menu_search, query);
+
+	/* have the helper up by the time Enter is pressed */
+	if (query [0] && priv->search_helper)
+		search_helper_warm_up (priv->search_helper);
+
+	if (! query [0]) {
+		/* the next search takes the file area's size as it is then */
+		gtk_widget_set_size_request (results, -1, -1);
+
+		gtk_widget_hide (results);
+		gtk_widget_show (notebook);
+	}
+	else if (gtk_widget_get_visible (notebook)) {
+		/* take over the file area's size, so the window does not jump */
+		gtk_widget_set_size_request (
+			results, notebook->allocation.width, notebook->allocation.height);
+
+		gtk_widget_hide (notebook);
+		gtk_widget_show (results);
+	}
+}
+
+static gboolean
+search_entry_key_press_cb (GtkWidget *widget, GdkEventKey *event, gpointer user_data)
+{
+	MainMenuUIPrivate *priv = PRIVATE (user_data);
+
+	if (event->keyval != GDK_Down && event->keyval != GDK_KP_Down)
+		return FALSE;
+
+	/* without a query Down moves through the menu as usual */
+	if (
+		! gtk_entry_get_text (GTK_ENTRY (widget)) [0] ||
+		! gtk_widget_get_visible (menu_search_get_widget (priv->menu_search))
+	)
+		return FALSE;
+
+	menu_search_focus_results (priv->menu_search);
+
+	return TRUE;
+}
+
+static void
+search_result_activated_cb (MenuSearch *search, gpointer user_data)
+{
+	MainMenuUI        *this = MAIN_MENU_UI (user_data);
+	MainMenuUIPrivate *priv = PRIVATE      (this);
+
+	hide_slab_if_urgent_close (this);
+
+	gtk_entry_set_text (GTK_ENTRY (priv->search_entry), "");
 }
 
 static void
@@ -2239,39 +3371,42 @@ page_button_clicked_cb (GtkButton *button, gpointer user_data)
 	gint curr_page;
 
 	page_type = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (button), "page-type"));
-	curr_page = g_settings_get_int (priv->filearea_settings, CURRENT_PAGE_SETTINGS_KEY);
+	curr_page = priv->snapshot.file_class;
 
 	if (page_type != curr_page) {
 		gtk_notebook_set_current_page (priv->file_section, priv->notebook_page_ids [page_type]);
-		g_settings_set_int (priv->filearea_settings, CURRENT_PAGE_SETTINGS_KEY, page_type);
+
+		/* the page is written back lazily, so flipping through the pages only
+		 * costs a single dconf write */
+		priv->snapshot.file_class = page_type;
+
+		if (priv->file_class_write_id)
+			g_source_remove (priv->file_class_write_id);
+
+		priv->file_class_write_id = g_timeout_add_seconds (
+			FILE_CLASS_WRITE_DELAY_SECONDS, write_file_class_cb, user_data);
 	}
 }
 
-static void
-tile_table_notify_cb (GObject *g_obj, GParamSpec *pspec, gpointer user_data)
+static gboolean
+write_file_class_cb (gpointer user_data)
 {
-	MainMenuUI        *this = MAIN_MENU_UI (user_data);
-	MainMenuUIPrivate *priv = PRIVATE      (this);
-
-	gint table_id;
+	MainMenuUIPrivate *priv = PRIVATE (user_data);
 
+	priv->file_class_write_id = 0;
 
-	connect_to_tile_triggers (this, TILE_TABLE (g_obj));
+	g_settings_set_int (priv->filearea_settings, CURRENT_PAGE_SETTINGS_KEY, priv->snapshot.file_class);
 
-	table_id = GPOINTER_TO_INT (g_object_get_data (g_obj, "table-id"));
+	return FALSE;
+}
 
-	switch (table_id) {
-		case USER_APPS_TABLE:
-			tile_table_reload (priv->file_tables [RCNT_APPS_TABLE]);
-			break;
+static void
+tile_table_notify_cb (GObject *g_obj, GParamSpec *pspec, gpointer user_data)
+{
+	MainMenuUI *this = MAIN_MENU_UI (user_data);
 
-		case USER_DOCS_TABLE:
-			tile_table_reload (priv->file_tables [RCNT_DOCS_TABLE]);
-			break;
 
-		default:
-			break;
-	}
+	connect_to_tile_triggers (this, TILE_TABLE (g_obj));
 
 	set_table_section_visible (this, TILE_TABLE (g_obj));
 
@@ -2355,6 +3490,11 @@ more_buttons_clicked_cb (GtkButton *button, gpointer user_data)
 		else
 			ditem_id = g_settings_get_string (priv->settings, FILE_BROWSER_SETTINGS_KEY);
 
+		if (ditem_id != NULL && launcher_launch (launcher_get_instance (), ditem_id, gtk_get_current_event_time ())) {
+			g_free (ditem_id);
+			ditem_id = NULL;
+		}
+
 		if (ditem_id != NULL) {
 			ditem = g_desktop_app_info_new (ditem_id);
 
@@ -2373,12 +3513,49 @@ more_buttons_clicked_cb (GtkButton *button, gpointer user_data)
 	}
 }
 
+static void
+launcher_launching_cb (Launcher *launcher, const gchar *uri, gpointer user_data)
+{
+	hide_slab_if_urgent_close (MAIN_MENU_UI (user_data));
+}
+
 static void
 search_cmd_notify_cb (GSettings *settings, gchar *key, gpointer user_data)
 {
 	set_search_section_visible (MAIN_MENU_UI (user_data));
 }
 
+static void
+search_providers_notify_cb (GSettings *settings, gchar *key, gpointer user_data)
+{
+	gchar **commands;
+
+
+	commands = g_settings_get_strv (settings, SEARCH_PROVIDERS_SETTINGS_KEY);
+
+	menu_search_set_providers (PRIVATE (user_data)->menu_search, (const gchar * const *) commands);
+
+	g_strfreev (commands);
+}
+
+static void
+search_helper_notify_cb (GSettings *settings, gchar *key, gpointer user_data)
+{
+	MainMenuUIPrivate *priv = PRIVATE (user_data);
+
+	gchar *command;
+
+
+	if (priv->search_helper)
+		g_object_unref (priv->search_helper);
+
+	command = g_settings_get_string (settings, SEARCH_HELPER_SETTINGS_KEY);
+	priv->search_helper = search_helper_new (command);
+	g_free (command);
+
+	set_search_section_visible (MAIN_MENU_UI (user_data));
+}
+
 static void
 current_page_notify_cb (GSettings *settings, gchar *key, gpointer user_data)
 {
@@ -2386,10 +3563,105 @@ current_page_notify_cb (GSettings *settings, gchar *key, gpointer user_data)
 	/*select_page (MAIN_MENU_UI (user_data));*/
 }
 
+/* Policy is often pushed in bulk, so the changes are accumulated and applied
+ * once from idle, before the next redraw.
+ */
 static void
 lockdown_notify_cb (GSettings *settings, gchar *key, gpointer user_data)
 {
-	apply_lockdown_settings (MAIN_MENU_UI (user_data));
+	MainMenuUIPrivate *priv = PRIVATE (user_data);
+
+	guint changes = LOCKDOWN_ALL;
+	gint  i;
+
+
+	for (i = 0; i < G_N_ELEMENTS (lockdown_key_changes); ++i)
+		if (! strcmp (key, lockdown_key_changes [i].key)) {
+			changes = lockdown_key_changes [i].changes;
+			break;
+		}
+
+	priv->lockdown_changes |= changes;
+
+	if (! priv->lockdown_changes_id)
+		priv->lockdown_changes_id = g_idle_add_full (
+			G_PRIORITY_HIGH_IDLE, apply_lockdown_changes_cb, user_data, NULL);
+}
+
+static void
+load_settings_snapshot (MainMenuUI *this)
+{
+	MainMenuUIPrivate *priv = PRIVATE (this);
+
+	SettingsSnapshot *snap = & priv->snapshot;
+
+
+	snap->urgent_close       = g_settings_get_boolean (priv->settings, URGENT_CLOSE_SETTINGS_KEY);
+	snap->search_cmd         = g_settings_get_string  (priv->settings, SEARCH_CMD_SETTINGS_KEY);
+
+	snap->file_class         = g_settings_get_int     (priv->filearea_settings, CURRENT_PAGE_SETTINGS_KEY);
+	snap->max_total_items    = g_settings_get_int     (priv->filearea_settings, MAX_TOTAL_ITEMS_SETTINGS_KEY);
+	snap->min_recent_items   = g_settings_get_int     (priv->filearea_settings, MIN_RECENT_ITEMS_SETTINGS_KEY);
+	snap->file_blacklist     = g_settings_get_strv    (priv->filearea_settings, APP_BLACKLIST_SETTINGS_KEY);
+
+	snap->disable_terminal   = g_settings_get_boolean (priv->mate_lockdown_settings, DISABLE_TERMINAL_SETTINGS_KEY);
+	snap->disable_lockscreen = g_settings_get_boolean (priv->mate_lockdown_settings, DISABLE_LOCKSCREEN_SETTINGS_KEY);
+	snap->disable_logout     = g_settings_get_boolean (priv->panel_settings, DISABLE_LOGOUT_SETTINGS_KEY);
+}
+
+static void
+snapshot_notify_cb (GSettings *settings, gchar *key, gpointer user_data)
+{
+	MainMenuUIPrivate *priv = PRIVATE (user_data);
+
+	SettingsSnapshot *snap = & priv->snapshot;
+
+
+	if (settings == priv->settings) {
+		if (! strcmp (key, URGENT_CLOSE_SETTINGS_KEY))
+			snap->urgent_close = g_settings_get_boolean (settings, key);
+		else if (! strcmp (key, SEARCH_CMD_SETTINGS_KEY)) {
+			g_free (snap->search_cmd);
+			snap->search_cmd = g_settings_get_string (settings, key);
+		}
+	}
+	else if (settings == priv->filearea_settings) {
+		if (! strcmp (key, CURRENT_PAGE_SETTINGS_KEY)) {
+			/* a page switch of ours that is still to be written wins */
+			if (! priv->file_class_write_id)
+				snap->file_class = g_settings_get_int (settings, key);
+		}
+		else if (! strcmp (key, MAX_TOTAL_ITEMS_SETTINGS_KEY))
+			snap->max_total_items = g_settings_get_int (settings, key);
+		else if (! strcmp (key, MIN_RECENT_ITEMS_SETTINGS_KEY))
+			snap->min_recent_items = g_settings_get_int (settings, key);
+		else if (! strcmp (key, APP_BLACKLIST_SETTINGS_KEY)) {
+			g_strfreev (snap->file_blacklist);
+			snap->file_blacklist = g_settings_get_strv (settings, key);
+		}
+	}
+	else if (settings == priv->mate_lockdown_settings) {
+		if (! strcmp (key, DISABLE_TERMINAL_SETTINGS_KEY))
+			snap->disable_terminal = g_settings_get_boolean (settings, key);
+		else if (! strcmp (key, DISABLE_LOCKSCREEN_SETTINGS_KEY))
+			snap->disable_lockscreen = g_settings_get_boolean (settings, key);
+	}
+	else if (settings == priv->panel_settings) {
+		if (! strcmp (key, DISABLE_LOGOUT_SETTINGS_KEY))
+			snap->disable_logout = g_settings_get_boolean (settings, key);
+	}
+}
+
+static void
+stall_budget_notify_cb (GSettings *settings, gchar *key, gpointer user_data)
+{
+	stall_watchdog_set_budget (MAX (g_settings_get_int (settings, key), 0));
+}
+
+static void
+prefetch_budget_notify_cb (GSettings *settings, gchar *key, gpointer user_data)
+{
+	app_prefetch_set_budget (PRIVATE (user_data)->app_prefetch, g_settings_get_int (settings, key));
 }
 
 static void
@@ -2436,6 +3708,27 @@ panel_applet_change_orient_cb (MatePanelApplet *applet, MatePanelAppletOrient or
 	reorient_panel_button (MAIN_MENU_UI (user_data));
 }
 
+/* Nothing ever drops the last reference to the MainMenuUI, so the applet
+ * going away is the last chance to finish writes that are still pending.
+ */
+static void
+panel_applet_destroy_cb (GtkWidget *widget, gpointer user_data)
+{
+	MainMenuUIPrivate *priv = PRIVATE (user_data);
+
+	gint i;
+
+	if (priv->file_class_write_id) {
+		g_source_remove (priv->file_class_write_id);
+		write_file_class_cb (user_data);
+	}
+
+	g_settings_sync ();
+
+	for (i = 0; i < BOOKMARK_STORE_N_TYPES; ++i)
+		bookmark_layer_flush (bookmark_layer_get_for_agent (priv->bm_agents [i]));
+}
+
 static void
 panel_applet_change_background_cb (MatePanelApplet *applet, MatePanelAppletBackgroundType type, GdkColor *color,
                                    GdkPixmap *pixmap, gpointer user_data)
@@ -2525,23 +3818,36 @@ slab_gdk_message_filter (GdkXEvent *gdk_xevent, GdkEvent *event, gpointer user_d
 }
 
 static void
-user_app_agent_notify_cb (GObject *g_obj, GParamSpec *pspec, gpointer user_data)
+user_app_layer_changed_cb (BookmarkLayer *layer, const GArray *deltas, gpointer user_data)
 {
-	tile_table_reload (PRIVATE (user_data)->file_tables [RCNT_APPS_TABLE]);
+	bookmark_layer_refresh (bookmark_layer_get_for_agent (PRIVATE (user_data)->bm_agents [BOOKMARK_STORE_RECENT_APPS]));
 }
 
 static void
-user_doc_agent_notify_cb (GObject *g_obj, GParamSpec *pspec, gpointer user_data)
+usage_journal_changed_cb (UsageJournal *journal, gpointer user_data)
 {
-	tile_table_reload (PRIVATE (user_data)->file_tables [RCNT_DOCS_TABLE]);
+	MainMenuUI        *this = MAIN_MENU_UI (user_data);
+	MainMenuUIPrivate *priv = PRIVATE (this);
+
+
+	priv->usage_journal_has_changed = TRUE;
+
+	/* before the delayed setup, that reads the journal anyway */
+	if (priv->recently_used_store_monitor)
+		update_recently_used_sections (this);
+}
+
+static void
+user_doc_layer_changed_cb (BookmarkLayer *layer, const GArray *deltas, gpointer user_data)
+{
+	bookmark_layer_refresh (bookmark_layer_get_for_agent (PRIVATE (user_data)->bm_agents [BOOKMARK_STORE_RECENT_DOCS]));
 }
 
 static void
-volume_monitor_mount_cb (GVolumeMonitor *mon, GMount *mount, gpointer data)
+mount_health_changed_cb (MountTracker *tracker, gpointer data)
 {
 	MainMenuUIPrivate *priv = PRIVATE (data);
 
-	g_list_foreach (priv->mounts, (GFunc) g_object_unref, NULL);
-	g_list_free (priv->mounts);
-	priv->mounts = g_volume_monitor_get_mounts (mon);
+	tile_table_reload (priv->file_tables [USER_DOCS_TABLE]);
+	tile_table_reload (priv->file_tables [RCNT_DOCS_TABLE]);
 }
@@ -29,6 +29,7 @@
 #include <libslab/slab.h>
 
 #include "main-menu-ui.h"
+#include "stall-watchdog.h"
 
 static gboolean main_menu_applet_init (MatePanelApplet *, const gchar *, gpointer);
 
@@ -45,7 +46,7 @@ main_menu_applet_init (MatePanelApplet *applet, const gchar *iid, gpointer user_
 
 	libslab_checkpoint_init (CHECKPOINT_CONFIG_BASENAME, CHECKPOINT_FILE_BASENAME);
 
-	libslab_checkpoint ("Main-menu starts up");
+	CHECKPOINT ("Main-menu starts up");
 
 	if (strcmp (iid, "GNOMEMainMenu") != 0)
 		return FALSE;
@@ -65,14 +66,15 @@ main_menu_applet_init (MatePanelApplet *applet, const gchar *iid, gpointer user_
 
 	g_set_application_name (_("GNOME Main Menu"));
 
-	libslab_checkpoint ("Creating user interface for whole applet");
+	CHECKPOINT ("Creating user interface for whole applet");
 	main_menu_ui_new (applet);
 
-	libslab_checkpoint ("Showing all widgets in applet");
+	CHECKPOINT ("Showing all widgets in applet");
 	gtk_widget_show_all (GTK_WIDGET (applet));
 
-	libslab_thumbnail_factory_preinit ();
+	/* the thumbnail factory is created by the ThumbnailLoader once the first
+	 * document tile asks for a thumbnail */
 
-	libslab_checkpoint ("Finished initializing applet");
+	CHECKPOINT ("Finished initializing applet");
 	return TRUE;
 }
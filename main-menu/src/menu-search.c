@@ -0,0 +1,846 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#include "menu-search.h"
+
+#include <string.h>
+#include <glib/gi18n.h>
+#include <gio/gdesktopappinfo.h>
+
+#include "app-index.h"
+#include "doc-index.h"
+#include "frecency.h"
+#include "launcher.h"
+#include "search-provider.h"
+#include "usage-journal.h"
+#include "stall-watchdog.h"
+
+/* The as-you-type results pane.  Everything a query looks at is in memory by
+ * the time the user types: the installed applications come from the
+ * AppIndex, the favorites and recent documents straight from their bookmark
+ * layers and any other file in the document directories from the mapped
+ * DocIndex.  A keystroke therefore costs two index lookups, one pass over a
+ * few dozen bookmarks and refilling a list of MAX_RESULTS rows.
+ *
+ * The query also goes out to the configured SearchProviders.  Their results
+ * trickle in afterwards, for up to PROVIDER_DEADLINE_MS, and each batch is
+ * merged by running the local part of the query again, which is cheap.
+ */
+
+#define MAX_RESULTS          12
+#define PROVIDER_DEADLINE_MS 1500
+
+G_DEFINE_TYPE (MenuSearch, menu_search, G_TYPE_OBJECT)
+
+typedef struct {
+	GtkWidget    *pane;
+	GtkWidget    *view;
+	GtkListStore *store;
+
+	BookmarkLayer *layers [MENU_SEARCH_RECENT_DOCS + 1];
+
+	AppIndex *index;
+	DocIndex *doc_index;
+
+	GList  *providers;
+	GArray *provider_hits;
+
+	gchar *query;
+} MenuSearchPrivate;
+
+typedef struct {
+	gint              score;
+	gdouble           rank;
+	gint              weight;
+	MenuSearchSource  source;
+	gchar            *name;
+	gchar            *name_key;
+	GIcon            *icon;
+	GAppInfo         *app;
+	gchar            *uri;
+} SearchHit;
+
+enum {
+	COLUMN_ICON,
+	COLUMN_MARKUP,
+	COLUMN_APP,
+	COLUMN_URI,
+	N_COLUMNS
+};
+
+enum {
+	RESULT_ACTIVATED,
+	LAST_SIGNAL
+};
+
+static guint menu_search_signals [LAST_SIGNAL] = { 0 };
+
+#define PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), MENU_SEARCH_TYPE, MenuSearchPrivate))
+
+static void      menu_search_finalize (GObject *);
+static void      run_query            (MenuSearch *);
+static void      index_changed_cb     (GObject *, gpointer);
+static void      provider_results_cb  (SearchProvider *, GPtrArray *, gpointer);
+static gint      match_score          (const gchar *, const gchar *);
+static void      add_hit              (GArray *, gint, gint, MenuSearchSource, gchar *, gchar *,
+                                       GIcon *, GAppInfo *, const gchar *);
+static void      add_bookmark_hits    (MenuSearch *, MenuSearchSource, const gchar *, GArray *, GHashTable *);
+static void      add_app_hits         (MenuSearch *, const gchar *, GArray *, GHashTable *);
+static void      add_file_hits        (MenuSearch *, const gchar *, GArray *, GHashTable *);
+static void      add_provider_hits    (MenuSearch *, GArray *, GHashTable *);
+static gint      compare_hits         (gconstpointer, gconstpointer);
+static void      fill_store           (MenuSearch *, GArray *);
+static void      clear_hits           (GArray *);
+static void      row_activated_cb     (GtkTreeView *, GtkTreePath *, GtkTreeViewColumn *, gpointer);
+
+MenuSearch *
+menu_search_new (void)
+{
+	return g_object_new (MENU_SEARCH_TYPE, NULL);
+}
+
+GtkWidget *
+menu_search_get_widget (MenuSearch *this)
+{
+	return PRIVATE (this)->pane;
+}
+
+void
+menu_search_add_bookmarks (MenuSearch *this, BookmarkLayer *layer, MenuSearchSource source)
+{
+	PRIVATE (this)->layers [source] = layer;
+}
+
+/* Replaces the search providers with one per command */
+void
+menu_search_set_providers (MenuSearch *this, const gchar * const *commands)
+{
+	MenuSearchPrivate *priv = PRIVATE (this);
+
+	SearchProvider *provider;
+	GList          *node;
+	gint            i;
+
+
+	for (node = priv->providers; node; node = node->next) {
+		g_signal_handlers_disconnect_by_func (node->data, provider_results_cb, this);
+		g_object_unref (node->data);
+	}
+
+	g_list_free (priv->providers);
+	priv->providers = NULL;
+
+	for (i = 0; commands && commands [i]; ++i) {
+		if (! (provider = search_provider_new (commands [i])))
+			continue;
+
+		g_signal_connect (
+			G_OBJECT (provider), "results",
+			G_CALLBACK (provider_results_cb), this);
+
+		priv->providers = g_list_append (priv->providers, provider);
+	}
+}
+
+void
+menu_search_set_query (MenuSearch *this, const gchar *query)
+{
+	MenuSearchPrivate *priv = PRIVATE (this);
+
+	gchar *key;
+	GList *node;
+
+
+	key = app_index_get_key (query);
+
+	if (! g_strcmp0 (key, priv->query)) {
+		g_free (key);
+
+		return;
+	}
+
+	g_free (priv->query);
+	priv->query = key;
+
+	clear_hits (priv->provider_hits);
+
+	if (! key || ! key [0]) {
+		gtk_list_store_clear (priv->store);
+
+		return;
+	}
+
+	/* providers get what the user typed, and answer it in their own way */
+	for (node = priv->providers; node; node = node->next)
+		search_provider_query (SEARCH_PROVIDER (node->data), query, PROVIDER_DEADLINE_MS);
+
+	run_query (this);
+}
+
+/* Moves the keyboard focus from the entry to the first result */
+void
+menu_search_focus_results (MenuSearch *this)
+{
+	MenuSearchPrivate *priv = PRIVATE (this);
+
+	GtkTreePath *path;
+
+
+	if (! gtk_tree_model_iter_n_children (GTK_TREE_MODEL (priv->store), NULL))
+		return;
+
+	path = gtk_tree_path_new_first ();
+	gtk_tree_view_set_cursor (GTK_TREE_VIEW (priv->view), path, NULL, FALSE);
+	gtk_tree_path_free (path);
+
+	gtk_widget_grab_focus (priv->view);
+}
+
+/* Opens the best result, as if the user had picked it; returns FALSE if there
+ * is none.
+ */
+gboolean
+menu_search_activate_first (MenuSearch *this)
+{
+	MenuSearchPrivate *priv = PRIVATE (this);
+
+	GtkTreePath *path;
+
+
+	if (! gtk_tree_model_iter_n_children (GTK_TREE_MODEL (priv->store), NULL))
+		return FALSE;
+
+	path = gtk_tree_path_new_first ();
+	row_activated_cb (GTK_TREE_VIEW (priv->view), path, NULL, this);
+	gtk_tree_path_free (path);
+
+	return TRUE;
+}
+
+static void
+menu_search_class_init (MenuSearchClass *this_class)
+{
+	GObjectClass *g_obj_class = G_OBJECT_CLASS (this_class);
+
+	g_obj_class->finalize = menu_search_finalize;
+
+	menu_search_signals [RESULT_ACTIVATED] = g_signal_new (
+		"result-activated", G_TYPE_FROM_CLASS (this_class),
+		G_SIGNAL_RUN_LAST, G_STRUCT_OFFSET (MenuSearchClass, result_activated),
+		NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+	g_type_class_add_private (this_class, sizeof (MenuSearchPrivate));
+}
+
+static void
+menu_search_init (MenuSearch *this)
+{
+	MenuSearchPrivate *priv = PRIVATE (this);
+
+	GtkTreeViewColumn *column;
+	GtkCellRenderer   *renderer;
+
+
+	priv->store = gtk_list_store_new (
+		N_COLUMNS, G_TYPE_ICON, G_TYPE_STRING, G_TYPE_APP_INFO, G_TYPE_STRING);
+
+	priv->view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (priv->store));
+	gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (priv->view), FALSE);
+
+	column = gtk_tree_view_column_new ();
+
+	renderer = gtk_cell_renderer_pixbuf_new ();
+	g_object_set (G_OBJECT (renderer), "stock-size", GTK_ICON_SIZE_DND, NULL);
+	gtk_tree_view_column_pack_start (column, renderer, FALSE);
+	gtk_tree_view_column_add_attribute (column, renderer, "gicon", COLUMN_ICON);
+
+	renderer = gtk_cell_renderer_text_new ();
+	g_object_set (G_OBJECT (renderer), "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+	gtk_tree_view_column_pack_start (column, renderer, TRUE);
+	gtk_tree_view_column_add_attribute (column, renderer, "markup", COLUMN_MARKUP);
+
+	gtk_tree_view_append_column (GTK_TREE_VIEW (priv->view), column);
+
+	g_signal_connect (
+		G_OBJECT (priv->view), "row-activated",
+		G_CALLBACK (row_activated_cb), this);
+
+	priv->pane = gtk_scrolled_window_new (NULL, NULL);
+	gtk_scrolled_window_set_policy (
+		GTK_SCROLLED_WINDOW (priv->pane), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (priv->pane), GTK_SHADOW_NONE);
+	gtk_container_add (GTK_CONTAINER (priv->pane), priv->view);
+
+	/* the owner decides when the pane shows */
+	gtk_widget_show (priv->view);
+	gtk_widget_set_no_show_all (priv->pane, TRUE);
+
+	g_object_ref_sink (priv->pane);
+
+	memset (priv->layers, 0, sizeof (priv->layers));
+
+	priv->index         = g_object_ref (app_index_get_instance ());
+	priv->doc_index     = g_object_ref (doc_index_get_instance ());
+	priv->providers     = NULL;
+	priv->provider_hits = g_array_new (FALSE, FALSE, sizeof (SearchHit));
+	priv->query         = NULL;
+
+	g_signal_connect (
+		G_OBJECT (priv->index), "changed",
+		G_CALLBACK (index_changed_cb), this);
+
+	g_signal_connect (
+		G_OBJECT (priv->doc_index), "changed",
+		G_CALLBACK (index_changed_cb), this);
+}
+
+static void
+menu_search_finalize (GObject *g_obj)
+{
+	MenuSearchPrivate *priv = PRIVATE (g_obj);
+
+	g_object_unref (priv->pane);
+	g_object_unref (priv->store);
+
+	g_signal_handlers_disconnect_by_func (priv->index, index_changed_cb, g_obj);
+	g_object_unref (priv->index);
+
+	g_signal_handlers_disconnect_by_func (priv->doc_index, index_changed_cb, g_obj);
+	g_object_unref (priv->doc_index);
+
+	menu_search_set_providers (MENU_SEARCH (g_obj), NULL);
+
+	clear_hits (priv->provider_hits);
+	g_array_free (priv->provider_hits, TRUE);
+
+	g_free (priv->query);
+
+	G_OBJECT_CLASS (menu_search_parent_class)->finalize (g_obj);
+}
+
+/* Matches the current query against everything and refills the pane */
+static void
+run_query (MenuSearch *this)
+{
+	MenuSearchPrivate *priv = PRIVATE (this);
+
+	const gchar *key = priv->query;
+
+	GArray     *hits;
+	GHashTable *favorite_apps;
+	GHashTable *seen;
+
+
+	if (! key || ! key [0])
+		return;
+
+	CHECKPOINT ("run_query(): matching");
+
+	hits          = g_array_new (FALSE, FALSE, sizeof (SearchHit));
+	favorite_apps = g_hash_table_new (g_str_hash, g_str_equal);
+	seen          = g_hash_table_new (g_str_hash, g_str_equal);
+
+	/* a favorite app is matched through its installed entry, which has the
+	 * proper name; add_app_hits () takes those out of favorite_apps */
+	add_bookmark_hits (this, MENU_SEARCH_FAVORITE_APPS, key, NULL, favorite_apps);
+	add_app_hits      (this, key, hits, favorite_apps);
+	add_bookmark_hits (this, MENU_SEARCH_FAVORITE_APPS, key, hits, favorite_apps);
+	add_bookmark_hits (this, MENU_SEARCH_FAVORITE_DOCS, key, hits, seen);
+	add_bookmark_hits (this, MENU_SEARCH_RECENT_DOCS,   key, hits, seen);
+	add_file_hits     (this, key, hits, seen);
+	add_provider_hits (this, hits, seen);
+
+	g_array_sort (hits, compare_hits);
+
+	fill_store (this, hits);
+
+	clear_hits (hits);
+	g_array_free (hits, TRUE);
+	g_hash_table_destroy (favorite_apps);
+	g_hash_table_destroy (seen);
+}
+
+/* applications or files were added or removed; redo the query if there is
+ * one */
+static void
+index_changed_cb (GObject *index, gpointer user_data)
+{
+	run_query (MENU_SEARCH (user_data));
+}
+
+/* Keeps a provider's results for the current query and merges them in */
+static void
+provider_results_cb (SearchProvider *provider, GPtrArray *results, gpointer user_data)
+{
+	MenuSearch        *this = MENU_SEARCH (user_data);
+	MenuSearchPrivate *priv = PRIVATE (this);
+
+	SearchProviderResult *result;
+	gchar                *name_key;
+	GIcon                *icon = NULL;
+	gint                  i;
+
+
+	if (! priv->query || ! priv->query [0])
+		return;
+
+	for (i = 0; i < results->len; ++i) {
+		result = g_ptr_array_index (results, i);
+
+		name_key = app_index_get_key (result->title);
+
+		if (result->icon)
+			icon = g_icon_new_for_string (result->icon, NULL);
+
+		if (! icon)
+			icon = g_themed_icon_new ("text-x-generic");
+
+		/* the provider found it, so it is a match even if the name
+		 * does not show why */
+		add_hit (
+			priv->provider_hits, MAX (match_score (name_key, priv->query), 1), result->score,
+			MENU_SEARCH_PROVIDERS, g_strdup (result->title), name_key, icon, NULL, result->uri);
+
+		g_object_unref (icon);
+		icon = NULL;
+	}
+
+	run_query (this);
+}
+
+/* Ranks how well name_key matches query: 3 for a prefix of the whole name,
+ * 2 for a prefix of any later word, 1 for anywhere else and 0 for no match.
+ */
+static gint
+match_score (const gchar *name_key, const gchar *query)
+{
+	const gchar *match;
+	gint         score = 0;
+
+
+	if (! name_key)
+		return 0;
+
+	if (g_str_has_prefix (name_key, query))
+		return 3;
+
+	for (match = strstr (name_key, query); match; match = strstr (match + 1, query)) {
+		if (! g_unichar_isalnum (g_utf8_get_char (g_utf8_prev_char (match))))
+			return 2;
+
+		score = 1;
+	}
+
+	return score;
+}
+
+static void
+add_hit (GArray *hits, gint score, gint weight, MenuSearchSource source, gchar *name, gchar *name_key,
+         GIcon *icon, GAppInfo *app, const gchar *uri)
+{
+	SearchHit hit;
+
+
+	hit.score    = score;
+	hit.rank     = frecency_get_rank (frecency_get_instance (), uri);
+	hit.weight   = weight;
+	hit.source   = source;
+	hit.name     = name;
+	hit.name_key = name_key;
+	hit.icon     = icon ? g_object_ref (icon) : NULL;
+	hit.app      = app  ? g_object_ref (app)  : NULL;
+	hit.uri      = g_strdup (uri);
+
+	g_array_append_val (hits, hit);
+}
+
+/* Adds the items of the source's layer that match query to hits, skipping the
+ * uris in seen and adding the others to it.  For favorite apps seen works the
+ * other way round: with hits NULL it is filled with all of them, and with hits
+ * set the ones still in it get matched by title.
+ */
+static void
+add_bookmark_hits (MenuSearch *this, MenuSearchSource source, const gchar *query, GArray *hits, GHashTable *seen)
+{
+	MenuSearchPrivate *priv = PRIVATE (this);
+
+	BookmarkItem **items;
+	gchar         *name;
+	gchar         *name_key;
+	gchar         *content_type;
+	GIcon         *icon;
+	gint           score;
+	gint           i;
+
+
+	if (! priv->layers [source])
+		return;
+
+	items = bookmark_layer_get_items (priv->layers [source]);
+
+	for (i = 0; items && items [i]; ++i) {
+		if (source == MENU_SEARCH_FAVORITE_APPS) {
+			if (! hits) {
+				g_hash_table_insert (seen, items [i]->uri, items [i]);
+
+				continue;
+			}
+
+			if (! (g_hash_table_lookup (seen, items [i]->uri) && items [i]->title))
+				continue;
+		}
+		else if (g_hash_table_lookup (seen, items [i]->uri))
+			continue;
+		else
+			g_hash_table_insert (seen, items [i]->uri, items [i]);
+
+		if (items [i]->title)
+			name = g_strdup (items [i]->title);
+		else
+			name = g_filename_display_basename (items [i]->uri);
+
+		name_key = app_index_get_key (name);
+
+		if (! (score = match_score (name_key, query))) {
+			g_free (name);
+			g_free (name_key);
+
+			continue;
+		}
+
+		if (source == MENU_SEARCH_FAVORITE_APPS && items [i]->icon)
+			icon = g_themed_icon_new (items [i]->icon);
+		else if (items [i]->mime_type) {
+			content_type = g_content_type_from_mime_type (items [i]->mime_type);
+			icon = g_content_type_get_icon (content_type);
+			g_free (content_type);
+		}
+		else
+			icon = g_themed_icon_new ("text-x-generic");
+
+		add_hit (hits, score, 0, source, name, name_key, icon, NULL, items [i]->uri);
+
+		g_object_unref (icon);
+	}
+}
+
+/* Adds the installed applications that match query, but only the best
+ * MAX_RESULTS of them: no more can make it into the pane, and a one-letter
+ * query matches most of the menu.  The others are scored and dropped without
+ * copying anything.
+ */
+static void
+add_app_hits (MenuSearch *this, const gchar *query, GArray *hits, GHashTable *favorite_apps)
+{
+	MenuSearchPrivate *priv = PRIVATE (this);
+
+	GPtrArray        *matches;
+	AppIndexEntry    *entry;
+	SearchHit         top [MAX_RESULTS];
+	AppIndexEntry    *top_entries [MAX_RESULTS];
+	SearchHit         candidate;
+	gint              n_top = 0;
+	gint              i;
+	gint              j;
+
+
+	matches = app_index_lookup (priv->index, query);
+
+	candidate.weight = 0;
+
+	for (i = 0; i < matches->len; ++i) {
+		entry = g_ptr_array_index (matches, i);
+
+		candidate.source = MENU_SEARCH_INSTALLED_APPS;
+
+		/* taken out even if it does not make the cut, so it is not
+		 * matched again as a bookmark */
+		if (entry->uri && g_hash_table_lookup (favorite_apps, entry->uri)) {
+			g_hash_table_remove (favorite_apps, entry->uri);
+			candidate.source = MENU_SEARCH_FAVORITE_APPS;
+		}
+
+		/* a match on the generic name, keywords or command name only
+		 * counts as a weak one */
+		candidate.score = MAX (match_score (entry->keys [APP_INDEX_FIELD_NAME], query), 1);
+
+		if (n_top == MAX_RESULTS && candidate.score < top [n_top - 1].score)
+			continue;
+
+		candidate.rank     = frecency_get_rank (frecency_get_instance (), entry->uri);
+		candidate.name_key = entry->keys [APP_INDEX_FIELD_NAME];
+
+		if (n_top == MAX_RESULTS && compare_hits (& candidate, & top [n_top - 1]) >= 0)
+			continue;
+
+		if (n_top < MAX_RESULTS)
+			++n_top;
+
+		for (j = n_top - 1; j > 0 && compare_hits (& candidate, & top [j - 1]) < 0; --j) {
+			top [j]         = top [j - 1];
+			top_entries [j] = top_entries [j - 1];
+		}
+
+		top [j]         = candidate;
+		top_entries [j] = entry;
+	}
+
+	for (j = 0; j < n_top; ++j) {
+		entry = top_entries [j];
+
+		add_hit (
+			hits, top [j].score, 0, top [j].source,
+			g_strdup (g_app_info_get_name (entry->info)),
+			g_strdup (entry->keys [APP_INDEX_FIELD_NAME]),
+			g_app_info_get_icon (entry->info), entry->info, entry->uri);
+	}
+
+	g_ptr_array_free (matches, TRUE);
+}
+
+/* Adds the files from the DocIndex that match query, skipping the uris in
+ * seen, i.e. the documents already matched as bookmarks.
+ */
+static void
+add_file_hits (MenuSearch *this, const gchar *query, GArray *hits, GHashTable *seen)
+{
+	MenuSearchPrivate *priv = PRIVATE (this);
+
+	GPtrArray *matches;
+	gchar     *path;
+	gchar     *uri;
+	gchar     *name;
+	gchar     *name_key;
+	gchar     *content_type;
+	GIcon     *icon;
+	gint       i;
+
+
+	/* room for the bookmarks that are bound to come back among them */
+	matches = doc_index_lookup (priv->doc_index, query, MAX_RESULTS + g_hash_table_size (seen));
+
+	for (i = 0; i < matches->len; ++i) {
+		path = g_ptr_array_index (matches, i);
+
+		if (! (uri = g_filename_to_uri (path, NULL, NULL)))
+			continue;
+
+		if (g_hash_table_lookup (seen, uri)) {
+			g_free (uri);
+
+			continue;
+		}
+
+		name     = g_filename_display_basename (path);
+		name_key = app_index_get_key (name);
+
+		/* guessed from the name alone, the file is not to be touched here */
+		content_type = g_content_type_guess (path, NULL, 0, NULL);
+		icon         = g_content_type_get_icon (content_type);
+
+		add_hit (hits, match_score (name_key, query), 0, MENU_SEARCH_FILES, name, name_key, icon, NULL, uri);
+
+		g_object_unref (icon);
+		g_free (content_type);
+		g_free (uri);
+	}
+
+	g_ptr_array_free (matches, TRUE);
+}
+
+/* Adds copies of the providers' results so far, skipping the uris in seen */
+static void
+add_provider_hits (MenuSearch *this, GArray *hits, GHashTable *seen)
+{
+	MenuSearchPrivate *priv = PRIVATE (this);
+
+	SearchHit *hit;
+	gint       i;
+
+
+	for (i = 0; i < priv->provider_hits->len; ++i) {
+		hit = & g_array_index (priv->provider_hits, SearchHit, i);
+
+		if (g_hash_table_lookup (seen, hit->uri))
+			continue;
+
+		g_hash_table_insert (seen, hit->uri, hit);
+
+		add_hit (
+			hits, hit->score, hit->weight, hit->source,
+			g_strdup (hit->name), g_strdup (hit->name_key), hit->icon, NULL, hit->uri);
+	}
+}
+
+static gint
+compare_hits (gconstpointer a, gconstpointer b)
+{
+	const SearchHit *hit_a = a;
+	const SearchHit *hit_b = b;
+
+
+	if (hit_a->score != hit_b->score)
+		return hit_b->score - hit_a->score;
+
+	/* among equally good matches, what the user opens most and latest */
+	if (hit_a->rank != hit_b->rank)
+		return hit_a->rank > hit_b->rank ? -1 : 1;
+
+	if (hit_a->source != hit_b->source)
+		return hit_a->source - hit_b->source;
+
+	if (hit_a->weight != hit_b->weight)
+		return hit_b->weight - hit_a->weight;
+
+	return g_strcmp0 (hit_a->name_key, hit_b->name_key);
+}
+
+static void
+fill_store (MenuSearch *this, GArray *hits)
+{
+	MenuSearchPrivate *priv = PRIVATE (this);
+
+	static const gchar *kinds [] = {
+		N_("Favorite Application"),
+		N_("Favorite Document"),
+		N_("Application"),
+		N_("Recent Document"),
+		N_("Document"),
+		N_("Search Result")
+	};
+
+	SearchHit   *hit;
+	GtkTreeIter  iter;
+	gchar       *markup;
+	gint         i;
+
+
+	gtk_list_store_clear (priv->store);
+
+	for (i = 0; i < hits->len && i < MAX_RESULTS; ++i) {
+		hit = & g_array_index (hits, SearchHit, i);
+
+		markup = g_markup_printf_escaped (
+			"%s\n<small>%s</small>", hit->name, _(kinds [hit->source]));
+
+		gtk_list_store_insert_with_values (
+			priv->store, & iter, i,
+			COLUMN_ICON,   hit->icon,
+			COLUMN_MARKUP, markup,
+			COLUMN_APP,    hit->app,
+			COLUMN_URI,    hit->uri,
+			-1);
+
+		g_free (markup);
+	}
+}
+
+/* Frees what the hits hold and empties the array */
+static void
+clear_hits (GArray *hits)
+{
+	SearchHit *hit;
+	gint       i;
+
+
+	for (i = 0; i < hits->len; ++i) {
+		hit = & g_array_index (hits, SearchHit, i);
+
+		g_free (hit->name);
+		g_free (hit->name_key);
+		g_free (hit->uri);
+
+		if (hit->icon)
+			g_object_unref (hit->icon);
+
+		if (hit->app)
+			g_object_unref (hit->app);
+	}
+
+	g_array_set_size (hits, 0);
+}
+
+static void
+row_activated_cb (GtkTreeView *view, GtkTreePath *path, GtkTreeViewColumn *column, gpointer user_data)
+{
+	MenuSearch        *this = MENU_SEARCH (user_data);
+	MenuSearchPrivate *priv = PRIVATE (this);
+
+	GtkTreeIter        iter;
+	GAppInfo          *app = NULL;
+	gchar             *uri = NULL;
+	gchar             *filename;
+	GAppLaunchContext *context;
+
+	GError *error = NULL;
+
+
+	if (! gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->store), & iter, path))
+		return;
+
+	gtk_tree_model_get (
+		GTK_TREE_MODEL (priv->store), & iter, COLUMN_APP, & app, COLUMN_URI, & uri, -1);
+
+	/* a favorite app without an installed entry */
+	if (! app && uri && g_str_has_suffix (uri, ".desktop")) {
+		if ((filename = g_filename_from_uri (uri, NULL, NULL))) {
+			app = G_APP_INFO (g_desktop_app_info_new_from_filename (filename));
+			g_free (filename);
+		}
+	}
+
+	/* the launcher spawns after the menu is gone */
+	if (
+		app && G_IS_DESKTOP_APP_INFO (app) &&
+		launcher_launch (
+			launcher_get_instance (), g_desktop_app_info_get_filename (G_DESKTOP_APP_INFO (app)),
+			gtk_get_current_event_time ())
+	)
+		goto exit;
+
+	context = G_APP_LAUNCH_CONTEXT (gdk_app_launch_context_new ());
+	gdk_app_launch_context_set_timestamp (
+		GDK_APP_LAUNCH_CONTEXT (context), gtk_get_current_event_time ());
+
+	if (app) {
+		g_app_info_launch (app, NULL, context, & error);
+
+		if (! error && G_IS_DESKTOP_APP_INFO (app))
+			usage_journal_record (
+				usage_journal_get_instance (), g_desktop_app_info_get_filename (G_DESKTOP_APP_INFO (app)));
+	}
+	else if (uri)
+		g_app_info_launch_default_for_uri (uri, context, & error);
+
+	if (error)
+		libslab_handle_g_error (& error, "%s: can't open [%s]\n", G_STRFUNC, uri);
+
+	g_object_unref (context);
+
+exit:
+
+	if (app)
+		g_object_unref (app);
+
+	g_free (uri);
+
+	g_signal_emit (this, menu_search_signals [RESULT_ACTIVATED], 0);
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef __MENU_SEARCH_H__
+#define __MENU_SEARCH_H__
+
+#include <gtk/gtk.h>
+
+#include "bookmark-layer.h"
+
+G_BEGIN_DECLS
+
+#define MENU_SEARCH_TYPE         (menu_search_get_type ())
+#define MENU_SEARCH(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), MENU_SEARCH_TYPE, MenuSearch))
+#define MENU_SEARCH_CLASS(c)     (G_TYPE_CHECK_CLASS_CAST ((c), MENU_SEARCH_TYPE, MenuSearchClass))
+#define IS_MENU_SEARCH(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), MENU_SEARCH_TYPE))
+#define IS_MENU_SEARCH_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE ((c), MENU_SEARCH_TYPE))
+#define MENU_SEARCH_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), MENU_SEARCH_TYPE, MenuSearchClass))
+
+/* in order of precedence among equally good matches */
+typedef enum {
+	MENU_SEARCH_FAVORITE_APPS,
+	MENU_SEARCH_FAVORITE_DOCS,
+	MENU_SEARCH_INSTALLED_APPS,
+	MENU_SEARCH_RECENT_DOCS,
+	MENU_SEARCH_FILES,
+	MENU_SEARCH_PROVIDERS
+} MenuSearchSource;
+
+typedef struct {
+	GObject g_object;
+} MenuSearch;
+
+typedef struct {
+	GObjectClass g_object_class;
+
+	void (* result_activated) (MenuSearch *);
+} MenuSearchClass;
+
+GType menu_search_get_type (void);
+
+MenuSearch *menu_search_new           (void);
+GtkWidget  *menu_search_get_widget    (MenuSearch *this);
+void        menu_search_add_bookmarks (MenuSearch *this, BookmarkLayer *layer, MenuSearchSource source);
+void        menu_search_set_providers (MenuSearch *this, const gchar * const *commands);
+void        menu_search_set_query     (MenuSearch *this, const gchar *query);
+void        menu_search_focus_results (MenuSearch *this);
+gboolean    menu_search_activate_first (MenuSearch *this);
+
+G_END_DECLS
+
+#endif
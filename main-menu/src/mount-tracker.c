@@ -0,0 +1,587 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "mount-tracker.h"
+
+#include "io-guard.h"
+#include "stall-watchdog.h"
+
+#include <string.h>
+#include <gio/gunixmounts.h>
+#include <libslab/slab.h>
+
+/* Network mounts are probed with an asynchronous query on their root.  A probe
+ * that hasn't answered after PROBE_TIMEOUT_SECONDS marks the mount as
+ * unresponsive; it stays that way until a probe comes back.  A probe that
+ * hangs in the kernel is never reissued, so a dead server costs us at most
+ * one blocked GIO worker thread per mount and never the main loop.
+ *
+ * Until the first enumeration has run, no uri is known to be healthy, so
+ * nothing starts work on a document that may sit on a dead mount.
+ */
+#define PROBE_INTERVAL_SECONDS 30
+#define PROBE_TIMEOUT_SECONDS   3
+
+G_DEFINE_TYPE (MountTracker, mount_tracker, G_TYPE_OBJECT)
+
+typedef struct {
+	GVolumeMonitor *volume_mon;
+	GHashTable     *entries;
+	gboolean        enumerated;
+	guint           enumerate_id;
+	guint           probe_timer_id;
+} MountTrackerPrivate;
+
+typedef struct {
+	MountTracker *tracker;
+
+	GMount    *mount;
+	gchar     *root_uri;
+	gboolean   is_network;
+	MountKind  kind;
+
+	GCancellable *probe;
+	guint         probe_timeout_id;
+	gboolean      removed;
+} MountEntry;
+
+enum {
+	HEALTH_CHANGED,
+	LAST_SIGNAL
+};
+
+static guint mount_tracker_signals [LAST_SIGNAL] = { 0 };
+
+#define PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), MOUNT_TRACKER_TYPE, MountTrackerPrivate))
+
+static void        mount_tracker_finalize (GObject *);
+static gboolean    enumerate_mounts_cb    (gpointer);
+static void        mount_added_cb         (GVolumeMonitor *, GMount *, gpointer);
+static void        mount_removed_cb       (GVolumeMonitor *, GMount *, gpointer);
+static gchar      *get_mount_key          (GMount *);
+static MountEntry *mount_entry_new        (MountTracker *, GMount *, gchar *, GHashTable *);
+static GHashTable *get_mount_fs_types     (void);
+static void        mount_entry_release    (gpointer);
+static void        mount_entry_free       (MountEntry *);
+static void        mount_entry_set_kind   (MountEntry *, MountKind);
+static void        probe_mount            (MountEntry *);
+static void        probe_done_cb          (GObject *, GAsyncResult *, gpointer);
+static gboolean    probe_timeout_cb       (gpointer);
+static gboolean    probe_timer_cb         (gpointer);
+
+static const gchar *network_fs_types [] = {
+	"nfs", "nfs4", "cifs", "smbfs", "smb3", "ncpfs", "afs", "coda", "9p",
+	"ceph", "glusterfs", "lustre", "davfs", "fuse.sshfs", "fuse.glusterfs",
+	NULL
+};
+
+MountTracker *
+mount_tracker_new (void)
+{
+	return g_object_new (MOUNT_TRACKER_TYPE, NULL);
+}
+
+/* Returns the kind of the innermost mount that contains uri, or
+ * MOUNT_KIND_UNKNOWN before the mounts have been enumerated.  Entries are
+ * keyed by their root uri, so this costs one hash lookup per path component of
+ * uri rather than a scan of the mount table.
+ */
+MountKind
+mount_tracker_get_uri_kind (MountTracker *this, const gchar *uri)
+{
+	MountTrackerPrivate *priv = PRIVATE (this);
+
+	MountEntry *entry = NULL;
+	gchar      *prefix;
+	gchar      *sep;
+	gchar      *path;
+
+
+	if (! priv->enumerated)
+		return MOUNT_KIND_UNKNOWN;
+
+	if (! uri || g_hash_table_size (priv->entries) == 0)
+		return MOUNT_KIND_LOCAL;
+
+	prefix = g_strdup (uri);
+
+	path = strstr (prefix, "://");
+	path = path ? path + 3 : prefix;
+
+	for (sep = prefix + strlen (prefix); sep > path && sep [-1] == '/'; --sep)
+		*(sep - 1) = '\0';
+
+	while (! (entry = g_hash_table_lookup (priv->entries, prefix))) {
+		sep = strrchr (path, '/');
+
+		if (! sep)
+			break;
+
+		*sep = '\0';
+	}
+
+	g_free (prefix);
+
+	return entry ? entry->kind : MOUNT_KIND_LOCAL;
+}
+
+gboolean
+mount_tracker_uri_is_healthy (MountTracker *this, const gchar *uri)
+{
+	MountKind kind = mount_tracker_get_uri_kind (this, uri);
+
+	return kind == MOUNT_KIND_LOCAL || kind == MOUNT_KIND_NETWORK;
+}
+
+static void
+mount_tracker_class_init (MountTrackerClass *this_class)
+{
+	GObjectClass *g_obj_class = G_OBJECT_CLASS (this_class);
+
+	g_obj_class->finalize = mount_tracker_finalize;
+
+	mount_tracker_signals [HEALTH_CHANGED] = g_signal_new (
+		"health-changed", G_TYPE_FROM_CLASS (this_class),
+		G_SIGNAL_RUN_LAST, G_STRUCT_OFFSET (MountTrackerClass, health_changed),
+		NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+	g_type_class_add_private (this_class, sizeof (MountTrackerPrivate));
+}
+
+static void
+mount_tracker_init (MountTracker *this)
+{
+	MountTrackerPrivate *priv = PRIVATE (this);
+
+	priv->volume_mon     = NULL;
+	priv->entries        = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, mount_entry_release);
+	priv->enumerated     = FALSE;
+	priv->enumerate_id   = g_idle_add_full (G_PRIORITY_LOW, enumerate_mounts_cb, this, NULL);
+	priv->probe_timer_id = g_timeout_add_seconds (PROBE_INTERVAL_SECONDS, probe_timer_cb, this);
+}
+
+static void
+mount_tracker_finalize (GObject *g_obj)
+{
+	MountTrackerPrivate *priv = PRIVATE (g_obj);
+
+	if (priv->enumerate_id)
+		g_source_remove (priv->enumerate_id);
+
+	if (priv->volume_mon) {
+		g_signal_handlers_disconnect_by_func (priv->volume_mon, mount_added_cb, g_obj);
+		g_signal_handlers_disconnect_by_func (priv->volume_mon, mount_removed_cb, g_obj);
+		g_object_unref (priv->volume_mon);
+	}
+
+	g_source_remove (priv->probe_timer_id);
+	g_hash_table_destroy (priv->entries);
+
+	G_OBJECT_CLASS (mount_tracker_parent_class)->finalize (g_obj);
+}
+
+/* Returns TRUE if documents on the new mount change health, which is the case
+ * for network mounts since they are distrusted until their first probe answers.
+ * fs_types maps mount points to file system types, as get_mount_fs_types ()
+ * returns them.
+ */
+static gboolean
+add_mount (MountTracker *this, GMount *mount, GHashTable *fs_types)
+{
+	MountTrackerPrivate *priv = PRIVATE (this);
+
+	MountEntry *entry;
+	gchar      *key;
+
+
+	key = get_mount_key (mount);
+
+	if (g_hash_table_lookup (priv->entries, key)) {
+		g_free (key);
+
+		return FALSE;
+	}
+
+	io_guard_check ("mount classification");
+
+	entry = mount_entry_new (this, mount, key, fs_types);
+	g_hash_table_insert (priv->entries, entry->root_uri, entry);
+
+	if (entry->is_network)
+		probe_mount (entry);
+
+	return entry->is_network;
+}
+
+/* The volume monitor is created and enumerated from idle, since the first
+ * g_volume_monitor_get () loads every GIO volume monitor implementation.
+ */
+static gboolean
+enumerate_mounts_cb (gpointer data)
+{
+	MountTracker        *this = MOUNT_TRACKER (data);
+	MountTrackerPrivate *priv = PRIVATE (this);
+
+	GList      *mounts;
+	GList      *node;
+	GHashTable *fs_types;
+
+
+	priv->enumerate_id = 0;
+
+	CHECKPOINT ("mount-tracker.c: enumerating mounts");
+
+	priv->volume_mon = g_volume_monitor_get ();
+
+	g_signal_connect (priv->volume_mon, "mount-added", G_CALLBACK (mount_added_cb), this);
+	g_signal_connect (priv->volume_mon, "mount-removed", G_CALLBACK (mount_removed_cb), this);
+
+	mounts   = g_volume_monitor_get_mounts (priv->volume_mon);
+	fs_types = get_mount_fs_types ();
+
+	for (node = mounts; node; node = node->next) {
+		add_mount (this, G_MOUNT (node->data), fs_types);
+		g_object_unref (node->data);
+	}
+
+	g_list_free (mounts);
+	g_hash_table_destroy (fs_types);
+
+	/* every uri was unknown so far, so everything may have changed */
+	priv->enumerated = TRUE;
+
+	g_signal_emit (this, mount_tracker_signals [HEALTH_CHANGED], 0);
+
+	return FALSE;
+}
+
+static void
+mount_added_cb (GVolumeMonitor *mon, GMount *mount, gpointer data)
+{
+	if (add_mount (MOUNT_TRACKER (data), mount, NULL))
+		g_signal_emit (data, mount_tracker_signals [HEALTH_CHANGED], 0);
+}
+
+static void
+mount_removed_cb (GVolumeMonitor *mon, GMount *mount, gpointer data)
+{
+	MountTracker        *this = MOUNT_TRACKER (data);
+	MountTrackerPrivate *priv = PRIVATE (this);
+
+	MountEntry *entry;
+	gchar      *key;
+	gboolean    was_local;
+
+
+	key = get_mount_key (mount);
+	entry = g_hash_table_lookup (priv->entries, key);
+	g_free (key);
+
+	if (! entry || entry->mount != mount)
+		return;
+
+	was_local = (entry->kind == MOUNT_KIND_LOCAL);
+
+	g_hash_table_remove (priv->entries, entry->root_uri);
+
+	if (! was_local)
+		g_signal_emit (this, mount_tracker_signals [HEALTH_CHANGED], 0);
+}
+
+/* Mount roots are keyed without a trailing slash, the form that
+ * mount_tracker_get_uri_kind () produces while walking up a document uri.
+ */
+static gchar *
+get_mount_key (GMount *mount)
+{
+	GFile *root;
+	gchar *key;
+	gchar *path;
+	gsize  len;
+
+
+	root = g_mount_get_root (mount);
+	key  = g_file_get_uri (root);
+	g_object_unref (root);
+
+	path = strstr (key, "://");
+	path = path ? path + 3 : key;
+
+	for (len = strlen (key); len > (gsize) (path - key) && key [len - 1] == '/'; --len)
+		key [len - 1] = '\0';
+
+	return key;
+}
+
+/* Returns the file system type of every mount point in the mount table, read
+ * once for a whole enumeration.
+ */
+static GHashTable *
+get_mount_fs_types (void)
+{
+	GHashTable *fs_types;
+	GList      *unix_mounts;
+	GList      *node;
+
+
+	fs_types = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	unix_mounts = g_unix_mounts_get (NULL);
+
+	for (node = unix_mounts; node; node = node->next) {
+		g_hash_table_insert (
+			fs_types, g_strdup (g_unix_mount_get_mount_path (node->data)),
+			g_strdup (g_unix_mount_get_fs_type (node->data)));
+
+		g_unix_mount_free (node->data);
+	}
+
+	g_list_free (unix_mounts);
+
+	return fs_types;
+}
+
+/* Decides whether a mount is backed by a remote server.  This only looks at
+ * the mount table and the volume identifiers, never at the mount itself.  The
+ * table comes from fs_types if given, or else is read for this mount alone.
+ */
+static gboolean
+mount_is_network (GMount *mount, GFile *root, GHashTable *fs_types)
+{
+	GVolume          *volume;
+	GUnixMountEntry  *unix_mount = NULL;
+	gchar            *nfs_id;
+	gchar            *path;
+	const gchar      *fs_type;
+
+	gboolean is_network = FALSE;
+
+	gint i;
+
+
+	if (! g_file_is_native (root))
+		return TRUE;
+
+	volume = g_mount_get_volume (mount);
+
+	if (volume) {
+		nfs_id = g_volume_get_identifier (volume, G_VOLUME_IDENTIFIER_KIND_NFS_MOUNT);
+		is_network = (nfs_id != NULL);
+
+		g_free (nfs_id);
+		g_object_unref (volume);
+	}
+
+	if (is_network)
+		return TRUE;
+
+	path = g_file_get_path (root);
+
+	if (! path)
+		return FALSE;
+
+	if (fs_types)
+		fs_type = g_hash_table_lookup (fs_types, path);
+	else if ((unix_mount = g_unix_mount_at (path, NULL)))
+		fs_type = g_unix_mount_get_fs_type (unix_mount);
+	else
+		fs_type = NULL;
+
+	g_free (path);
+
+	for (i = 0; ! is_network && fs_type && network_fs_types [i]; ++i)
+		is_network = ! strcmp (fs_type, network_fs_types [i]);
+
+	if (unix_mount)
+		g_unix_mount_free (unix_mount);
+
+	return is_network;
+}
+
+static MountEntry *
+mount_entry_new (MountTracker *tracker, GMount *mount, gchar *key, GHashTable *fs_types)
+{
+	MountEntry *entry;
+	GFile      *root;
+
+
+	entry = g_new0 (MountEntry, 1);
+
+	root = g_mount_get_root (mount);
+
+	entry->tracker    = tracker;
+	entry->mount      = g_object_ref (mount);
+	entry->root_uri   = key;
+	entry->is_network = mount_is_network (mount, root, fs_types);
+
+	/* network mounts are distrusted until the first probe answers */
+	entry->kind = entry->is_network ? MOUNT_KIND_UNRESPONSIVE : MOUNT_KIND_LOCAL;
+
+	g_object_unref (root);
+
+	return entry;
+}
+
+static void
+mount_entry_release (gpointer data)
+{
+	MountEntry *entry = data;
+
+	if (entry->probe) {
+		if (entry->probe_timeout_id) {
+			g_source_remove (entry->probe_timeout_id);
+			entry->probe_timeout_id = 0;
+		}
+
+		/* probe_done_cb () frees the entry once the probe returns */
+		entry->removed = TRUE;
+		g_cancellable_cancel (entry->probe);
+	}
+	else
+		mount_entry_free (entry);
+}
+
+static void
+mount_entry_free (MountEntry *entry)
+{
+	if (entry->probe_timeout_id)
+		g_source_remove (entry->probe_timeout_id);
+
+	if (entry->probe)
+		g_object_unref (entry->probe);
+
+	g_object_unref (entry->mount);
+	g_free (entry->root_uri);
+	g_free (entry);
+}
+
+static void
+mount_entry_set_kind (MountEntry *entry, MountKind kind)
+{
+	if (entry->kind == kind)
+		return;
+
+	CHECKPOINT ("mount-tracker.c: %s is now %s", entry->root_uri,
+		kind == MOUNT_KIND_UNRESPONSIVE ? "unresponsive" : "responsive");
+
+	entry->kind = kind;
+
+	g_signal_emit (entry->tracker, mount_tracker_signals [HEALTH_CHANGED], 0);
+}
+
+static void
+probe_mount (MountEntry *entry)
+{
+	GFile *root;
+
+
+	if (entry->probe)
+		return;
+
+	entry->probe = g_cancellable_new ();
+
+	root = g_file_new_for_uri (entry->root_uri);
+
+	g_file_query_info_async (
+		root, G_FILE_ATTRIBUTE_STANDARD_TYPE, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+		G_PRIORITY_LOW, entry->probe, probe_done_cb, entry);
+
+	g_object_unref (root);
+
+	entry->probe_timeout_id = g_timeout_add_seconds (PROBE_TIMEOUT_SECONDS, probe_timeout_cb, entry);
+}
+
+static void
+probe_done_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	MountEntry *entry = user_data;
+
+	GFileInfo *info;
+	GError    *error = NULL;
+
+	gboolean responsive;
+
+
+	info = g_file_query_info_finish (G_FILE (source), result, & error);
+
+	if (entry->removed) {
+		if (info)
+			g_object_unref (info);
+		if (error)
+			g_error_free (error);
+
+		mount_entry_free (entry);
+
+		return;
+	}
+
+	g_object_unref (entry->probe);
+	entry->probe = NULL;
+
+	if (entry->probe_timeout_id) {
+		g_source_remove (entry->probe_timeout_id);
+		entry->probe_timeout_id = 0;
+	}
+
+	/* any answer from the server, even a refusal, means it is alive */
+	responsive = info || g_error_matches (error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED);
+
+	if (responsive)
+		mount_entry_set_kind (entry, MOUNT_KIND_NETWORK);
+	else if (! g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		mount_entry_set_kind (entry, MOUNT_KIND_UNRESPONSIVE);
+
+	if (info)
+		g_object_unref (info);
+	if (error)
+		g_error_free (error);
+}
+
+static gboolean
+probe_timeout_cb (gpointer user_data)
+{
+	MountEntry *entry = user_data;
+
+	entry->probe_timeout_id = 0;
+
+	/* the probe itself stays outstanding, so that we notice when it returns */
+	mount_entry_set_kind (entry, MOUNT_KIND_UNRESPONSIVE);
+
+	return FALSE;
+}
+
+static gboolean
+probe_timer_cb (gpointer user_data)
+{
+	MountTrackerPrivate *priv = PRIVATE (user_data);
+
+	MountEntry *entry;
+
+	GHashTableIter iter;
+
+
+	g_hash_table_iter_init (& iter, priv->entries);
+
+	while (g_hash_table_iter_next (& iter, NULL, (gpointer *) & entry))
+		if (entry->is_network)
+			probe_mount (entry);
+
+	return TRUE;
+}
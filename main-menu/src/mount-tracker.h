@@ -0,0 +1,63 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __MOUNT_TRACKER_H__
+#define __MOUNT_TRACKER_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define MOUNT_TRACKER_TYPE         (mount_tracker_get_type ())
+#define MOUNT_TRACKER(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), MOUNT_TRACKER_TYPE, MountTracker))
+#define MOUNT_TRACKER_CLASS(c)     (G_TYPE_CHECK_CLASS_CAST ((c), MOUNT_TRACKER_TYPE, MountTrackerClass))
+#define IS_MOUNT_TRACKER(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), MOUNT_TRACKER_TYPE))
+#define IS_MOUNT_TRACKER_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE ((c), MOUNT_TRACKER_TYPE))
+#define MOUNT_TRACKER_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), MOUNT_TRACKER_TYPE, MountTrackerClass))
+
+/* MOUNT_KIND_UNKNOWN is what every uri gets until the mounts have been
+ * enumerated for the first time.
+ */
+typedef enum {
+	MOUNT_KIND_LOCAL,
+	MOUNT_KIND_NETWORK,
+	MOUNT_KIND_UNRESPONSIVE,
+	MOUNT_KIND_UNKNOWN
+} MountKind;
+
+typedef struct {
+	GObject g_object;
+} MountTracker;
+
+typedef struct {
+	GObjectClass g_object_class;
+
+	void (* health_changed) (MountTracker *);
+} MountTrackerClass;
+
+GType mount_tracker_get_type (void);
+
+MountTracker *mount_tracker_new            (void);
+MountKind     mount_tracker_get_uri_kind   (MountTracker *this, const gchar *uri);
+gboolean      mount_tracker_uri_is_healthy (MountTracker *this, const gchar *uri);
+
+G_END_DECLS
+
+#endif
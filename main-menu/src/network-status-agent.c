@@ -112,6 +112,16 @@ network_status_agent_get_first_active_device_info (NetworkStatusAgent * agent)
 	return info;
 }
 
+/* Looks for the first active interface through libgtop and the wireless
+ * extensions, as is done without NetworkManager.  Touches no agent, so it can
+ * run in a worker thread.
+ */
+NetworkStatusInfo *
+network_status_agent_poll_device_info (void)
+{
+	return gtop_get_first_active_device_info ();
+}
+
 static void
 network_status_agent_dispose (GObject * obj)
 {
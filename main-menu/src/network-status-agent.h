@@ -53,6 +53,7 @@ GType network_status_agent_get_type (void);
 NetworkStatusAgent *network_status_agent_new (void);
 
 NetworkStatusInfo *network_status_agent_get_first_active_device_info (NetworkStatusAgent * agent);
+NetworkStatusInfo *network_status_agent_poll_device_info (void);
 
 G_END_DECLS
 #endif /* __NETWORK_STATUS_AGENT_H_ */
@@ -276,16 +276,29 @@ tile_show_event_cb (GtkWidget * widget, gpointer user_data)
 	update_tile (tile);
 }
 
+/* Returns TRUE if nothing tells the tile about changes, so that the status
+ * has to be polled with network_status_agent_poll_device_info ().
+ */
+gboolean
+network_tile_needs_polling (GtkWidget * widget)
+{
+	NetworkStatusTilePrivate *priv = NETWORK_STATUS_TILE_GET_PRIVATE (widget);
+
+	return priv->agent && !priv->agent->nm_present;
+}
+
+/* Shows a polled status; takes info, which may be NULL */
 void
-network_tile_update_status (GtkWidget * widget)
+network_tile_set_status (GtkWidget * widget, NetworkStatusInfo * info)
 {
 	NetworkStatusTile *tile = NETWORK_STATUS_TILE (widget);
 	NetworkStatusTilePrivate *priv = NETWORK_STATUS_TILE_GET_PRIVATE (tile);
 
-	if (priv->agent->nm_present)
-		return;
+	if (priv->status_info)
+		g_object_unref (priv->status_info);
+
+	priv->status_info = info;
 
-	refresh_status (tile);
 	update_tile (tile);
 }
 
@@ -23,6 +23,8 @@
 
 #include <libslab/slab.h>
 
+#include "network-status-info.h"
+
 G_BEGIN_DECLS
 
 #define NETWORK_STATUS_TILE_TYPE         (network_status_tile_get_type ())
@@ -48,7 +50,8 @@ GType network_status_tile_get_type (void);
 
 GtkWidget *network_status_tile_new (void);
 
-void network_tile_update_status (GtkWidget * widget);
+gboolean network_tile_needs_polling (GtkWidget * widget);
+void network_tile_set_status (GtkWidget * widget, NetworkStatusInfo * info);
 
 G_END_DECLS
 #endif
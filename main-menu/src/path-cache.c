@@ -0,0 +1,208 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+
+#include "path-cache.h"
+
+#include <string.h>
+
+#include "io-guard.h"
+
+/* What g_find_program_in_path () answers, remembered.  Looking a program up
+ * means a stat () in every PATH directory before the one that has it, or in
+ * all of them if none does, and with a directory on a slow network mount that
+ * is where a search entry or launcher check spends its time.
+ *
+ * Answers, including the ones that found nothing, are kept for the current
+ * value of PATH.  Every directory in PATH is watched, and anything appearing,
+ * disappearing or changing mode in one of them throws all answers away; such
+ * changes come with package installs and are rare enough not to bother with
+ * finer invalidation.  A different PATH starts over from scratch.
+ */
+
+G_DEFINE_TYPE (PathCache, path_cache, G_TYPE_OBJECT)
+
+typedef struct {
+	gchar      *path_env;
+	GHashTable *programs;
+	GList      *monitors;
+} PathCachePrivate;
+
+#define PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PATH_CACHE_TYPE, PathCachePrivate))
+
+static void path_cache_finalize (GObject *);
+static void watch_path          (PathCache *, const gchar *);
+static void unwatch_path        (PathCache *);
+static void dir_changed_cb      (GFileMonitor *, GFile *, GFile *, GFileMonitorEvent, gpointer);
+
+static PathCache *instance = NULL;
+
+PathCache *
+path_cache_get_instance (void)
+{
+	if (! instance)
+		instance = g_object_new (PATH_CACHE_TYPE, NULL);
+
+	return instance;
+}
+
+/* Same as g_find_program_in_path (), but only goes to the disk the first time
+ * it is asked about program.  Free the result with g_free ().
+ */
+gchar *
+path_cache_lookup (PathCache *this, const gchar *program)
+{
+	PathCachePrivate *priv = PRIVATE (this);
+
+	const gchar *path_env;
+	gchar       *found;
+
+
+	if (! program)
+		return NULL;
+
+	path_env = g_getenv ("PATH");
+
+	if (g_strcmp0 (path_env, priv->path_env)) {
+		g_hash_table_remove_all (priv->programs);
+		watch_path (this, path_env);
+	}
+
+	if (g_hash_table_lookup_extended (priv->programs, program, NULL, (gpointer *) & found))
+		return g_strdup (found);
+
+	io_guard_check ("program lookup in PATH");
+
+	found = g_find_program_in_path (program);
+	g_hash_table_insert (priv->programs, g_strdup (program), found);
+
+	return g_strdup (found);
+}
+
+static void
+path_cache_class_init (PathCacheClass *this_class)
+{
+	GObjectClass *g_obj_class = G_OBJECT_CLASS (this_class);
+
+	g_obj_class->finalize = path_cache_finalize;
+
+	g_type_class_add_private (this_class, sizeof (PathCachePrivate));
+}
+
+static void
+path_cache_init (PathCache *this)
+{
+	PathCachePrivate *priv = PRIVATE (this);
+
+	priv->path_env = NULL;
+	priv->programs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	priv->monitors = NULL;
+}
+
+static void
+path_cache_finalize (GObject *g_obj)
+{
+	PathCachePrivate *priv = PRIVATE (g_obj);
+
+	unwatch_path (PATH_CACHE (g_obj));
+
+	g_hash_table_destroy (priv->programs);
+	g_free (priv->path_env);
+
+	G_OBJECT_CLASS (path_cache_parent_class)->finalize (g_obj);
+}
+
+static void
+watch_path (PathCache *this, const gchar *path_env)
+{
+	PathCachePrivate *priv = PRIVATE (this);
+
+	GFileMonitor *monitor;
+	GFile        *dir;
+	gchar       **dirs;
+
+	gint i;
+
+
+	unwatch_path (this);
+
+	priv->path_env = g_strdup (path_env);
+
+	if (! path_env)
+		return;
+
+	dirs = g_strsplit (path_env, G_SEARCHPATH_SEPARATOR_S, -1);
+
+	for (i = 0; dirs [i]; ++i) {
+		/* an empty entry means the current directory, which nobody
+		 * launching from a menu can mean to rely on */
+		if (! (dirs [i][0] && g_path_is_absolute (dirs [i])))
+			continue;
+
+		dir     = g_file_new_for_path (dirs [i]);
+		monitor = g_file_monitor_directory (dir, G_FILE_MONITOR_NONE, NULL, NULL);
+
+		if (monitor) {
+			g_signal_connect (monitor, "changed", G_CALLBACK (dir_changed_cb), this);
+			priv->monitors = g_list_prepend (priv->monitors, monitor);
+		}
+
+		g_object_unref (dir);
+	}
+
+	g_strfreev (dirs);
+}
+
+static void
+unwatch_path (PathCache *this)
+{
+	PathCachePrivate *priv = PRIVATE (this);
+
+	GList *node;
+
+
+	for (node = priv->monitors; node; node = node->next) {
+		g_file_monitor_cancel (G_FILE_MONITOR (node->data));
+		g_object_unref (node->data);
+	}
+
+	g_list_free (priv->monitors);
+	priv->monitors = NULL;
+
+	g_free (priv->path_env);
+	priv->path_env = NULL;
+}
+
+static void
+dir_changed_cb (GFileMonitor *monitor, GFile *file, GFile *other_file,
+                GFileMonitorEvent event_type, gpointer user_data)
+{
+	switch (event_type) {
+		case G_FILE_MONITOR_EVENT_CREATED:
+		case G_FILE_MONITOR_EVENT_DELETED:
+		case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+			g_hash_table_remove_all (PRIVATE (user_data)->programs);
+			break;
+
+		default:
+			break;
+	}
+}
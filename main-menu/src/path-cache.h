@@ -0,0 +1,51 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef __PATH_CACHE_H__
+#define __PATH_CACHE_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define PATH_CACHE_TYPE         (path_cache_get_type ())
+#define PATH_CACHE(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), PATH_CACHE_TYPE, PathCache))
+#define PATH_CACHE_CLASS(c)     (G_TYPE_CHECK_CLASS_CAST ((c), PATH_CACHE_TYPE, PathCacheClass))
+#define IS_PATH_CACHE(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), PATH_CACHE_TYPE))
+#define IS_PATH_CACHE_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE ((c), PATH_CACHE_TYPE))
+#define PATH_CACHE_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), PATH_CACHE_TYPE, PathCacheClass))
+
+typedef struct {
+	GObject g_object;
+} PathCache;
+
+typedef struct {
+	GObjectClass g_object_class;
+} PathCacheClass;
+
+GType path_cache_get_type (void);
+
+PathCache *path_cache_get_instance (void);
+gchar     *path_cache_lookup       (PathCache *this, const gchar *program);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,282 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+
+#include "search-helper.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <libslab/slab.h>
+
+#include "path-cache.h"
+
+/* A search tool kept running in the background, so that a search costs a
+ * write to a socket instead of starting a process.
+ *
+ * The helper is started ahead of time, when the user begins to type, with one
+ * end of a socket pair as its standard input.  Each search is sent as the
+ * search text on a line of its own, upon which the helper is expected to show
+ * its results.  search_helper_send () never blocks: if the helper is gone or
+ * not reading, it returns FALSE and the caller starts the search command the
+ * old way.
+ */
+
+#define MAX_SPAWNS 3
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+G_DEFINE_TYPE (SearchHelper, search_helper, G_TYPE_OBJECT)
+
+typedef struct {
+	gchar **argv;
+
+	GPid  pid;
+	gint  fd;
+	guint child_id;
+	guint n_spawns;
+} SearchHelperPrivate;
+
+#define PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), SEARCH_HELPER_TYPE, SearchHelperPrivate))
+
+static void     search_helper_finalize (GObject *);
+static gboolean spawn                  (SearchHelper *);
+static void     stop                   (SearchHelper *);
+static void     child_setup            (gpointer);
+static void     child_exited_cb        (GPid, gint, gpointer);
+static void     reap_cb                (GPid, gint, gpointer);
+
+/* Returns NULL if command can't be parsed */
+SearchHelper *
+search_helper_new (const gchar *command)
+{
+	SearchHelper *this;
+	gchar       **argv;
+
+
+	if (! (command && command [0] && g_shell_parse_argv (command, NULL, & argv, NULL)))
+		return NULL;
+
+	this = g_object_new (SEARCH_HELPER_TYPE, NULL);
+	PRIVATE (this)->argv = argv;
+
+	return this;
+}
+
+/* Starts the helper if it is not running */
+void
+search_helper_warm_up (SearchHelper *this)
+{
+	if (PRIVATE (this)->fd < 0)
+		spawn (this);
+}
+
+/* Returns TRUE if the helper's program can be found, and so started */
+gboolean
+search_helper_is_available (SearchHelper *this)
+{
+	gchar    *program;
+	gboolean  found;
+
+
+	program = path_cache_lookup (path_cache_get_instance (), PRIVATE (this)->argv [0]);
+	found   = (program != NULL);
+	g_free (program);
+
+	return found;
+}
+
+/* Hands query to the helper; returns FALSE if it could not take it */
+gboolean
+search_helper_send (SearchHelper *this, const gchar *query)
+{
+	SearchHelperPrivate *priv = PRIVATE (this);
+
+	gchar   *line;
+	gchar   *c;
+	gsize    len;
+	gssize   sent;
+
+
+	if (priv->fd < 0 && ! spawn (this))
+		return FALSE;
+
+	line = g_strconcat (query, "\n", NULL);
+
+	for (c = line; *c != '\n'; ++c)
+		if (*c == '\r')
+			*c = ' ';
+
+	len = strlen (line);
+
+	do
+		sent = send (priv->fd, line, len, MSG_NOSIGNAL);
+	while (sent < 0 && errno == EINTR);
+
+	g_free (line);
+
+	if (sent == (gssize) len)
+		return TRUE;
+
+	/* a partial line would garble the next one */
+	if (sent >= 0 || errno != EAGAIN)
+		stop (this);
+
+	return FALSE;
+}
+
+static void
+search_helper_class_init (SearchHelperClass *this_class)
+{
+	GObjectClass *g_obj_class = G_OBJECT_CLASS (this_class);
+
+	g_obj_class->finalize = search_helper_finalize;
+
+	g_type_class_add_private (this_class, sizeof (SearchHelperPrivate));
+}
+
+static void
+search_helper_init (SearchHelper *this)
+{
+	SearchHelperPrivate *priv = PRIVATE (this);
+
+	priv->argv     = NULL;
+	priv->pid      = 0;
+	priv->fd       = -1;
+	priv->child_id = 0;
+	priv->n_spawns = 0;
+}
+
+static void
+search_helper_finalize (GObject *g_obj)
+{
+	SearchHelperPrivate *priv = PRIVATE (g_obj);
+
+	/* the helper sees the end of its input and exits */
+	stop (SEARCH_HELPER (g_obj));
+
+	if (priv->child_id) {
+		g_source_remove (priv->child_id);
+		g_child_watch_add (priv->pid, reap_cb, NULL);
+	}
+
+	g_strfreev (priv->argv);
+
+	G_OBJECT_CLASS (search_helper_parent_class)->finalize (g_obj);
+}
+
+static gboolean
+spawn (SearchHelper *this)
+{
+	SearchHelperPrivate *priv = PRIVATE (this);
+
+	gchar **argv;
+	gchar  *program;
+
+	gint fds [2];
+
+	GError *error = NULL;
+
+
+	if (priv->n_spawns >= MAX_SPAWNS || priv->child_id)
+		return FALSE;
+
+	if (! (program = path_cache_lookup (path_cache_get_instance (), priv->argv [0])))
+		return FALSE;
+
+	if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds)) {
+		g_free (program);
+
+		return FALSE;
+	}
+
+	priv->n_spawns++;
+
+	argv = g_strdupv (priv->argv);
+	g_free (argv [0]);
+	argv [0] = program;
+
+	g_spawn_async (
+		g_get_home_dir (), argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+		child_setup, GINT_TO_POINTER (fds [1]), & priv->pid, & error);
+
+	g_strfreev (argv);
+	close (fds [1]);
+
+	if (error) {
+		close (fds [0]);
+
+		libslab_handle_g_error (
+			& error, "%s: can't start search helper [%s]\n", G_STRFUNC, priv->argv [0]);
+
+		return FALSE;
+	}
+
+	fcntl (fds [0], F_SETFD, FD_CLOEXEC);
+	fcntl (fds [0], F_SETFL, fcntl (fds [0], F_GETFL) | O_NONBLOCK);
+
+	priv->fd       = fds [0];
+	priv->child_id = g_child_watch_add (priv->pid, child_exited_cb, this);
+
+	return TRUE;
+}
+
+static void
+stop (SearchHelper *this)
+{
+	SearchHelperPrivate *priv = PRIVATE (this);
+
+	if (priv->fd >= 0)
+		close (priv->fd);
+
+	priv->fd = -1;
+}
+
+/* runs in the child, between fork () and exec () */
+static void
+child_setup (gpointer data)
+{
+	dup2 (GPOINTER_TO_INT (data), STDIN_FILENO);
+}
+
+static void
+child_exited_cb (GPid pid, gint status, gpointer user_data)
+{
+	SearchHelperPrivate *priv = PRIVATE (user_data);
+
+	g_spawn_close_pid (pid);
+
+	priv->child_id = 0;
+	priv->pid      = 0;
+
+	/* the next search starts it again */
+	stop (SEARCH_HELPER (user_data));
+}
+
+static void
+reap_cb (GPid pid, gint status, gpointer user_data)
+{
+	g_spawn_close_pid (pid);
+}
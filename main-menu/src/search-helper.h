@@ -0,0 +1,53 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef __SEARCH_HELPER_H__
+#define __SEARCH_HELPER_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define SEARCH_HELPER_TYPE         (search_helper_get_type ())
+#define SEARCH_HELPER(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), SEARCH_HELPER_TYPE, SearchHelper))
+#define SEARCH_HELPER_CLASS(c)     (G_TYPE_CHECK_CLASS_CAST ((c), SEARCH_HELPER_TYPE, SearchHelperClass))
+#define IS_SEARCH_HELPER(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), SEARCH_HELPER_TYPE))
+#define IS_SEARCH_HELPER_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE ((c), SEARCH_HELPER_TYPE))
+#define SEARCH_HELPER_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), SEARCH_HELPER_TYPE, SearchHelperClass))
+
+typedef struct {
+	GObject g_object;
+} SearchHelper;
+
+typedef struct {
+	GObjectClass g_object_class;
+} SearchHelperClass;
+
+GType search_helper_get_type (void);
+
+SearchHelper *search_helper_new          (const gchar *command);
+gboolean      search_helper_is_available (SearchHelper *this);
+void          search_helper_warm_up      (SearchHelper *this);
+gboolean      search_helper_send         (SearchHelper *this, const gchar *query);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,424 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+
+#include "search-provider.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <libslab/slab.h>
+
+#include "path-cache.h"
+
+/* An external command that answers queries for the search pane.
+ *
+ * The command is started on the first query and kept running from then on,
+ * so that it only pays its start-up cost once.  Its standard input is one end
+ * of a socket pair, so that a write to a provider that just died fails instead
+ * of raising SIGPIPE.  Each query is written to it as one line:
+ *
+ *     <serial> TAB <query> NEWLINE
+ *
+ * and it streams back any number of result lines on its standard output, in
+ * whatever order and at whatever pace it finds them:
+ *
+ *     <serial> TAB <score> TAB <uri> TAB <title> TAB <icon> NEWLINE
+ *
+ * where score runs from 0 to 100 and title and icon may be empty.  A result is
+ * only taken while its serial is the latest one and the deadline given with
+ * the query has not passed; everything else is dropped without blocking the
+ * main loop.  A provider should exit once its standard input is closed.
+ */
+
+#define MAX_SPAWNS             3
+#define MAX_RESULTS_PER_QUERY 20
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+G_DEFINE_TYPE (SearchProvider, search_provider, G_TYPE_OBJECT)
+
+typedef struct {
+	gchar **argv;
+
+	GPid        pid;
+	gint        fd;
+	GIOChannel *output;
+	guint       output_id;
+	guint       child_id;
+	guint       n_spawns;
+
+	guint  serial;
+	gint64 deadline;
+	guint  n_results;
+} SearchProviderPrivate;
+
+enum {
+	RESULTS,
+	LAST_SIGNAL
+};
+
+static guint search_provider_signals [LAST_SIGNAL] = { 0 };
+
+#define PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), SEARCH_PROVIDER_TYPE, SearchProviderPrivate))
+
+static void                  search_provider_finalize (GObject *);
+static gboolean              spawn                    (SearchProvider *);
+static void                  stop                     (SearchProvider *);
+static gboolean              output_cb                (GIOChannel *, GIOCondition, gpointer);
+static SearchProviderResult *parse_line               (SearchProvider *, gchar *);
+static void                  child_exited_cb          (GPid, gint, gpointer);
+static void                  reap_cb                  (GPid, gint, gpointer);
+static void                  child_setup              (gpointer);
+static void                  result_free              (gpointer);
+
+/* Returns NULL if command can't be parsed */
+SearchProvider *
+search_provider_new (const gchar *command)
+{
+	SearchProvider *this;
+	gchar         **argv;
+
+
+	if (! g_shell_parse_argv (command, NULL, & argv, NULL))
+		return NULL;
+
+	this = g_object_new (SEARCH_PROVIDER_TYPE, NULL);
+	PRIVATE (this)->argv = argv;
+
+	return this;
+}
+
+/* Sends query to the provider, starting it if need be.  Its results come in
+ * through "results" until deadline_ms have passed or the next query.
+ */
+void
+search_provider_query (SearchProvider *this, const gchar *query, guint deadline_ms)
+{
+	SearchProviderPrivate *priv = PRIVATE (this);
+
+	gchar  *text;
+	gchar  *line;
+	gchar  *c;
+	gsize   len;
+	gssize  sent;
+
+
+	priv->serial++;
+	priv->deadline  = g_get_monotonic_time () + (gint64) deadline_ms * 1000;
+	priv->n_results = 0;
+
+	if (! (priv->fd >= 0 || spawn (this)))
+		return;
+
+	/* the protocol is line and tab based */
+	text = g_strdup (query);
+
+	for (c = text; *c; ++c)
+		if (*c == '\t' || *c == '\n' || *c == '\r')
+			*c = ' ';
+
+	line = g_strdup_printf ("%u\t%s\n", priv->serial, text);
+	len  = strlen (line);
+
+	do
+		sent = send (priv->fd, line, len, MSG_NOSIGNAL);
+	while (sent < 0 && errno == EINTR);
+
+	/* the socket is non-blocking; a provider too busy to read loses the
+	 * query, rather than stalling the keystroke, but a partial line would
+	 * garble the next one */
+	if (sent != (gssize) len && (sent >= 0 || errno != EAGAIN))
+		stop (this);
+
+	g_free (line);
+	g_free (text);
+}
+
+static void
+search_provider_class_init (SearchProviderClass *this_class)
+{
+	GObjectClass *g_obj_class = G_OBJECT_CLASS (this_class);
+
+	g_obj_class->finalize = search_provider_finalize;
+
+	search_provider_signals [RESULTS] = g_signal_new (
+		"results", G_TYPE_FROM_CLASS (this_class),
+		G_SIGNAL_RUN_LAST, G_STRUCT_OFFSET (SearchProviderClass, results),
+		NULL, NULL, g_cclosure_marshal_VOID__POINTER, G_TYPE_NONE, 1, G_TYPE_POINTER);
+
+	g_type_class_add_private (this_class, sizeof (SearchProviderPrivate));
+}
+
+static void
+search_provider_init (SearchProvider *this)
+{
+	SearchProviderPrivate *priv = PRIVATE (this);
+
+	priv->argv      = NULL;
+	priv->pid       = 0;
+	priv->fd        = -1;
+	priv->output    = NULL;
+	priv->output_id = 0;
+	priv->child_id  = 0;
+	priv->n_spawns  = 0;
+	priv->serial    = 0;
+	priv->deadline  = 0;
+	priv->n_results = 0;
+}
+
+static void
+search_provider_finalize (GObject *g_obj)
+{
+	SearchProviderPrivate *priv = PRIVATE (g_obj);
+
+	stop (SEARCH_PROVIDER (g_obj));
+
+	/* the child may take a moment to exit; reap it without us */
+	if (priv->child_id) {
+		g_source_remove (priv->child_id);
+		g_child_watch_add (priv->pid, reap_cb, NULL);
+	}
+
+	g_strfreev (priv->argv);
+
+	G_OBJECT_CLASS (search_provider_parent_class)->finalize (g_obj);
+}
+
+static gboolean
+spawn (SearchProvider *this)
+{
+	SearchProviderPrivate *priv = PRIVATE (this);
+
+	gchar **argv;
+	gchar  *program;
+
+	gint fds [2];
+	gint output_fd;
+
+	GError *error = NULL;
+
+
+	/* a provider that keeps dying is not worth another try */
+	if (priv->n_spawns >= MAX_SPAWNS || priv->child_id)
+		return FALSE;
+
+	if (! (program = path_cache_lookup (path_cache_get_instance (), priv->argv [0])))
+		return FALSE;
+
+	if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds)) {
+		g_free (program);
+
+		return FALSE;
+	}
+
+	priv->n_spawns++;
+
+	argv = g_strdupv (priv->argv);
+	g_free (argv [0]);
+	argv [0] = program;
+
+	g_spawn_async_with_pipes (
+		g_get_home_dir (), argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+		child_setup, GINT_TO_POINTER (fds [1]),
+		& priv->pid, NULL, & output_fd, NULL, & error);
+
+	g_strfreev (argv);
+	close (fds [1]);
+
+	if (error) {
+		close (fds [0]);
+
+		libslab_handle_g_error (
+			& error, "%s: can't start search provider [%s]\n", G_STRFUNC, priv->argv [0]);
+
+		return FALSE;
+	}
+
+	fcntl (fds [0], F_SETFD, FD_CLOEXEC);
+	fcntl (fds [0], F_SETFL, fcntl (fds [0], F_GETFL) | O_NONBLOCK);
+
+	priv->fd     = fds [0];
+	priv->output = g_io_channel_unix_new (output_fd);
+
+	g_io_channel_set_close_on_unref (priv->output, TRUE);
+	g_io_channel_set_encoding (priv->output, NULL, NULL);
+	g_io_channel_set_flags (priv->output, G_IO_FLAG_NONBLOCK, NULL);
+
+	priv->output_id = g_io_add_watch (
+		priv->output, G_IO_IN | G_IO_HUP | G_IO_ERR, output_cb, this);
+	priv->child_id = g_child_watch_add (priv->pid, child_exited_cb, this);
+
+	return TRUE;
+}
+
+/* Closes the pipes and asks the provider to exit; the child watch reaps it */
+static void
+stop (SearchProvider *this)
+{
+	SearchProviderPrivate *priv = PRIVATE (this);
+
+	if (priv->output_id)
+		g_source_remove (priv->output_id);
+
+	priv->output_id = 0;
+
+	if (priv->fd >= 0)
+		close (priv->fd);
+
+	if (priv->output)
+		g_io_channel_unref (priv->output);
+
+	priv->fd     = -1;
+	priv->output = NULL;
+
+	if (priv->child_id)
+		kill (priv->pid, SIGTERM);
+}
+
+static gboolean
+output_cb (GIOChannel *channel, GIOCondition condition, gpointer user_data)
+{
+	SearchProvider        *this = SEARCH_PROVIDER (user_data);
+	SearchProviderPrivate *priv = PRIVATE (this);
+
+	GPtrArray            *results;
+	SearchProviderResult *result;
+	GIOStatus             status;
+	gchar                *line;
+
+
+	results = g_ptr_array_new_with_free_func (result_free);
+
+	/* take everything there is, and hand it on in one go */
+	while ((status = g_io_channel_read_line (channel, & line, NULL, NULL, NULL)) == G_IO_STATUS_NORMAL) {
+		if ((result = parse_line (this, line)))
+			g_ptr_array_add (results, result);
+
+		g_free (line);
+	}
+
+	if (results->len)
+		g_signal_emit (this, search_provider_signals [RESULTS], 0, results);
+
+	g_ptr_array_free (results, TRUE);
+
+	if (status == G_IO_STATUS_AGAIN && ! (condition & (G_IO_HUP | G_IO_ERR)))
+		return TRUE;
+
+	priv->output_id = 0;
+	stop (this);
+
+	return FALSE;
+}
+
+/* Returns the result on line, or NULL if it is malformed, late or one too
+ * many */
+static SearchProviderResult *
+parse_line (SearchProvider *this, gchar *line)
+{
+	SearchProviderPrivate *priv = PRIVATE (this);
+
+	SearchProviderResult *result;
+	gchar               **fields;
+	gchar                *end;
+	guint64               serial;
+
+
+	if (
+		priv->n_results >= MAX_RESULTS_PER_QUERY ||
+		g_get_monotonic_time () > priv->deadline ||
+		! g_utf8_validate (g_strchomp (line), -1, NULL)
+	)
+		return NULL;
+
+	fields = g_strsplit (line, "\t", 5);
+	serial = g_ascii_strtoull (fields [0], & end, 10);
+
+	if (g_strv_length (fields) < 3 || * end || serial != priv->serial || ! fields [2][0]) {
+		g_strfreev (fields);
+
+		return NULL;
+	}
+
+	result = g_new0 (SearchProviderResult, 1);
+
+	result->score = CLAMP (atoi (fields [1]), 0, 100);
+	result->uri   = g_strdup (fields [2]);
+
+	if (fields [3] && fields [3][0])
+		result->title = g_strdup (fields [3]);
+	else
+		result->title = g_filename_display_basename (fields [2]);
+
+	if (fields [3] && fields [4] && fields [4][0])
+		result->icon = g_strdup (fields [4]);
+
+	g_strfreev (fields);
+
+	priv->n_results++;
+
+	return result;
+}
+
+static void
+child_exited_cb (GPid pid, gint status, gpointer user_data)
+{
+	SearchProviderPrivate *priv = PRIVATE (user_data);
+
+	g_spawn_close_pid (pid);
+
+	priv->child_id = 0;
+	priv->pid      = 0;
+
+	/* the next query starts it again */
+	stop (SEARCH_PROVIDER (user_data));
+}
+
+static void
+reap_cb (GPid pid, gint status, gpointer user_data)
+{
+	g_spawn_close_pid (pid);
+}
+
+/* runs in the child, between fork () and exec () */
+static void
+child_setup (gpointer data)
+{
+	dup2 (GPOINTER_TO_INT (data), STDIN_FILENO);
+}
+
+static void
+result_free (gpointer data)
+{
+	SearchProviderResult *result = data;
+
+	g_free (result->uri);
+	g_free (result->title);
+	g_free (result->icon);
+	g_free (result);
+}
@@ -0,0 +1,62 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef __SEARCH_PROVIDER_H__
+#define __SEARCH_PROVIDER_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define SEARCH_PROVIDER_TYPE         (search_provider_get_type ())
+#define SEARCH_PROVIDER(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), SEARCH_PROVIDER_TYPE, SearchProvider))
+#define SEARCH_PROVIDER_CLASS(c)     (G_TYPE_CHECK_CLASS_CAST ((c), SEARCH_PROVIDER_TYPE, SearchProviderClass))
+#define IS_SEARCH_PROVIDER(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), SEARCH_PROVIDER_TYPE))
+#define IS_SEARCH_PROVIDER_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE ((c), SEARCH_PROVIDER_TYPE))
+#define SEARCH_PROVIDER_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), SEARCH_PROVIDER_TYPE, SearchProviderClass))
+
+/* score is the provider's own, from 0 to 100; icon is a themed icon name or
+ * a path, or NULL */
+typedef struct {
+	gint   score;
+	gchar *uri;
+	gchar *title;
+	gchar *icon;
+} SearchProviderResult;
+
+typedef struct {
+	GObject g_object;
+} SearchProvider;
+
+typedef struct {
+	GObjectClass g_object_class;
+
+	void (* results) (SearchProvider *, GPtrArray *);
+} SearchProviderClass;
+
+GType search_provider_get_type (void);
+
+SearchProvider *search_provider_new   (const gchar *command);
+void            search_provider_query (SearchProvider *this, const gchar *query, guint deadline_ms);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,391 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include "stall-watchdog.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <glib/gstdio.h>
+
+#ifdef HAVE_EXECINFO_H
+#	include <execinfo.h>
+#endif
+
+/* The watchdog wraps the default main context's poll function, so the main
+ * thread only notes when it leaves and re-enters poll () and never has to wake
+ * up for a heartbeat.  A separate thread checks every budget / 4 whether the
+ * current iteration has been running for longer than the budget, and if so
+ * remembers the active phase and has the main thread record its own backtrace
+ * from a signal handler.  Once the iteration finishes the stall is written to
+ * $XDG_CACHE_HOME/gnome-main-menu/stalls.log together with a histogram of
+ * all stall durations seen so far.  The phase is cleared whenever the main
+ * thread goes back to poll (), so a stall is only ever blamed on a phase that
+ * was entered during the iteration that stalled.
+ *
+ * Times are kept as 64 bit microseconds of the monotonic clock, which do not
+ * fit an atomic integer, so busy_since is guarded by busy_lock.
+ */
+
+#define LOG_DIR_NAME     "gnome-main-menu"
+#define LOG_BASENAME     "stalls.log"
+#define LOG_MAX_BYTES    (256 * 1024)
+#define MAX_FRAMES       64
+#define BACKTRACE_SIGNAL SIGUSR2
+
+static const guint histogram_bounds [] = { 50, 100, 250, 500, 1000, 2000, 5000 };
+
+#define N_BUCKETS (G_N_ELEMENTS (histogram_bounds) + 1)
+
+typedef struct {
+	gint64       start;
+	gint         duration;
+	const gchar *phase;
+	gchar      **frames;
+} StallReport;
+
+static gint          budget     = 0;
+static const gchar  *phase      = NULL;
+static GPollFunc     saved_poll = NULL;
+static GThread      *thread     = NULL;
+static gint          running    = 0;
+static pthread_t     main_thread;
+
+static GMutex        busy_lock;
+static gint64        busy_since = -1;
+
+static GMutex        finished_lock;
+static gint64        finished_start    = -1;
+static gint          finished_duration = 0;
+static const gchar  *finished_phase    = NULL;
+
+static guint         histogram [N_BUCKETS];
+
+#ifdef HAVE_EXECINFO_H
+static void *frames [MAX_FRAMES];
+static gint  n_frames    = 0;
+static gint  frames_done = 0;
+#endif
+
+static gint64
+get_busy_since (void)
+{
+	gint64 since;
+
+
+	g_mutex_lock (& busy_lock);
+	since = busy_since;
+	g_mutex_unlock (& busy_lock);
+
+	return since;
+}
+
+static void
+set_busy_since (gint64 since)
+{
+	g_mutex_lock (& busy_lock);
+	busy_since = since;
+	g_mutex_unlock (& busy_lock);
+}
+
+static gint
+watchdog_poll (GPollFD *fds, guint nfds, gint timeout)
+{
+	gint64 since;
+	gint64 now;
+	gint   ret;
+
+
+	since = get_busy_since ();
+	now   = g_get_monotonic_time ();
+
+	if (since >= 0 && now - since > (gint64) g_atomic_int_get (& budget) * 1000) {
+		g_mutex_lock (& finished_lock);
+		finished_start    = since;
+		finished_duration = (gint) ((now - since) / 1000);
+		finished_phase    = g_atomic_pointer_get (& phase);
+		g_mutex_unlock (& finished_lock);
+	}
+
+	set_busy_since (-1);
+
+	/* the dispatch is over, and with it whatever it was doing */
+	g_atomic_pointer_set (& phase, NULL);
+
+	ret = saved_poll (fds, nfds, timeout);
+
+	set_busy_since (g_get_monotonic_time ());
+
+	return ret;
+}
+
+#ifdef HAVE_EXECINFO_H
+static void
+backtrace_signal_handler (gint signum)
+{
+	n_frames = backtrace (frames, MAX_FRAMES);
+	g_atomic_int_set (& frames_done, 1);
+}
+
+/* Has the main thread fill in frames from its signal handler, waiting at most
+ * 100 ms for it, and returns them symbolized.
+ */
+static gchar **
+capture_main_thread_backtrace (void)
+{
+	gchar **symbols;
+	gchar **strv;
+	gint    i;
+
+
+	g_atomic_int_set (& frames_done, 0);
+
+	if (pthread_kill (main_thread, BACKTRACE_SIGNAL))
+		return NULL;
+
+	for (i = 0; i < 100 && ! g_atomic_int_get (& frames_done); ++i)
+		g_usleep (1000);
+
+	if (! g_atomic_int_get (& frames_done))
+		return NULL;
+
+	symbols = backtrace_symbols (frames, n_frames);
+
+	if (! symbols)
+		return NULL;
+
+	strv = g_new0 (gchar *, n_frames + 1);
+
+	for (i = 0; i < n_frames; ++i)
+		strv [i] = g_strdup (symbols [i]);
+
+	free (symbols);
+
+	return strv;
+}
+#else
+static gchar **
+capture_main_thread_backtrace (void)
+{
+	return NULL;
+}
+#endif
+
+static FILE *
+open_log (void)
+{
+	gchar   *dir;
+	gchar   *path;
+	gchar   *rotated;
+	GStatBuf st;
+	FILE    *log;
+
+
+	dir = g_build_filename (g_get_user_cache_dir (), LOG_DIR_NAME, NULL);
+	g_mkdir_with_parents (dir, 0700);
+
+	path = g_build_filename (dir, LOG_BASENAME, NULL);
+
+	if (! g_stat (path, & st) && st.st_size > LOG_MAX_BYTES) {
+		rotated = g_strconcat (path, ".1", NULL);
+		g_rename (path, rotated);
+		g_free (rotated);
+	}
+
+	log = g_fopen (path, "a");
+
+	g_free (path);
+	g_free (dir);
+
+	return log;
+}
+
+static void
+write_report (StallReport *report)
+{
+	FILE  *log;
+	gchar  stamp [64];
+	time_t now;
+	guint  i;
+
+
+	for (i = 0; i < G_N_ELEMENTS (histogram_bounds); ++i)
+		if (report->duration < histogram_bounds [i])
+			break;
+
+	histogram [i]++;
+
+	if (! (log = open_log ()))
+		return;
+
+	now = time (NULL);
+	strftime (stamp, sizeof (stamp), "%Y-%m-%d %H:%M:%S", localtime (& now));
+
+	fprintf (log, "%s: main loop stalled for %d ms in phase \"%s\"\n",
+		stamp, report->duration, report->phase ? report->phase : "(none)");
+
+	for (i = 0; report->frames && report->frames [i]; ++i)
+		fprintf (log, "\t#%-2u %s\n", i, report->frames [i]);
+
+	fprintf (log, "\thistogram:");
+
+	for (i = 0; i < N_BUCKETS; ++i) {
+		if (i < G_N_ELEMENTS (histogram_bounds))
+			fprintf (log, " <%ums:%u", histogram_bounds [i], histogram [i]);
+		else
+			fprintf (log, " more:%u", histogram [i]);
+	}
+
+	fprintf (log, "\n");
+
+	fclose (log);
+}
+
+static gpointer
+watchdog_thread (gpointer data)
+{
+	StallReport ongoing;
+	StallReport finished;
+	gint64      since;
+	gint        limit;
+
+
+	ongoing.start  = -1;
+	ongoing.frames = NULL;
+
+	while (g_atomic_int_get (& running)) {
+		limit = g_atomic_int_get (& budget);
+
+		g_usleep (MAX (limit / 4, 5) * 1000);
+
+		since = get_busy_since ();
+
+		if (since >= 0 && since != ongoing.start && g_get_monotonic_time () - since > (gint64) limit * 1000) {
+			g_strfreev (ongoing.frames);
+
+			ongoing.start  = since;
+			ongoing.phase  = g_atomic_pointer_get (& phase);
+			ongoing.frames = capture_main_thread_backtrace ();
+		}
+
+		g_mutex_lock (& finished_lock);
+
+		finished.start    = finished_start;
+		finished.duration = finished_duration;
+		finished.phase    = finished_phase;
+		finished.frames   = NULL;
+
+		finished_start = -1;
+
+		g_mutex_unlock (& finished_lock);
+
+		if (finished.start < 0)
+			continue;
+
+		/* stalls that ended before we caught them are logged without a backtrace,
+		 * blaming whatever phase was active when they ended */
+		if (finished.start == ongoing.start) {
+			finished.phase  = ongoing.phase;
+			finished.frames = ongoing.frames;
+
+			ongoing.start  = -1;
+			ongoing.frames = NULL;
+		}
+
+		write_report (& finished);
+
+		g_strfreev (finished.frames);
+	}
+
+	g_strfreev (ongoing.frames);
+
+	return NULL;
+}
+
+static void
+watchdog_start (void)
+{
+#ifdef HAVE_EXECINFO_H
+	struct sigaction action;
+
+
+	memset (& action, 0, sizeof (action));
+	action.sa_handler = backtrace_signal_handler;
+	action.sa_flags   = SA_RESTART;
+	sigemptyset (& action.sa_mask);
+	sigaction (BACKTRACE_SIGNAL, & action, NULL);
+
+	/* backtrace () loads libgcc on first use, which is not safe in a handler */
+	n_frames = backtrace (frames, MAX_FRAMES);
+#endif
+
+	main_thread = pthread_self ();
+
+	saved_poll = g_main_context_get_poll_func (NULL);
+	g_main_context_set_poll_func (NULL, watchdog_poll);
+
+	g_atomic_int_set (& running, 1);
+	thread = g_thread_new ("stall-watchdog", watchdog_thread, NULL);
+}
+
+static void
+watchdog_stop (void)
+{
+	g_atomic_int_set (& running, 0);
+	g_thread_join (thread);
+	thread = NULL;
+
+	g_main_context_set_poll_func (NULL, saved_poll);
+	set_busy_since (-1);
+
+#ifdef HAVE_EXECINFO_H
+	signal (BACKTRACE_SIGNAL, SIG_DFL);
+#endif
+}
+
+/* Turns the watchdog on for a budget of budget_ms per main loop iteration, or
+ * off if budget_ms is 0.  Must be called from the main thread.
+ */
+void
+stall_watchdog_set_budget (guint budget_ms)
+{
+	g_atomic_int_set (& budget, budget_ms);
+
+	if (budget_ms && ! thread) {
+		libslab_checkpoint ("stall_watchdog_set_budget(): watching for stalls over %u ms", budget_ms);
+		watchdog_start ();
+	}
+	else if (! budget_ms && thread)
+		watchdog_stop ();
+}
+
+void
+stall_watchdog_set_phase (const gchar *name)
+{
+	g_atomic_pointer_set (& phase, name);
+}
@@ -0,0 +1,45 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef __STALL_WATCHDOG_H__
+#define __STALL_WATCHDOG_H__
+
+#include <glib.h>
+#include <libslab/slab.h>
+
+G_BEGIN_DECLS
+
+/* Use CHECKPOINT () in place of libslab_checkpoint (): besides writing the
+ * checkpoint it names the phase the main loop is in, which is what a stall
+ * report blames.  The format string itself serves as the phase name.
+ */
+#define STALL_WATCHDOG_FIRST_ARG(first, ...) first
+#define CHECKPOINT(...) G_STMT_START {                                          \
+	stall_watchdog_set_phase (STALL_WATCHDOG_FIRST_ARG (__VA_ARGS__, NULL)); \
+	libslab_checkpoint (__VA_ARGS__);                                       \
+} G_STMT_END
+
+void stall_watchdog_set_budget (guint budget_ms);
+void stall_watchdog_set_phase  (const gchar *phase);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,349 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "thumbnail-loader.h"
+
+#include "io-guard.h"
+#include "stall-watchdog.h"
+
+#define MATE_DESKTOP_USE_UNSTABLE_API
+#include <libmate-desktop/mate-desktop-thumbnail.h>
+
+/* Thumbnail lookup may have to spawn an external thumbnailer, so it never
+ * runs on the main loop.  Jobs wait in a queue owned by the main thread and
+ * at most MAX_RUNNING_JOBS are handed to the worker pool at any time, which
+ * lets us pick the most urgent job (one on the visible notebook page) each
+ * time a worker becomes free.
+ */
+#define MAX_RUNNING_JOBS 2
+
+G_DEFINE_TYPE (ThumbnailLoader, thumbnail_loader, G_TYPE_OBJECT)
+
+typedef struct {
+	GThreadPool *pool;
+	GQueue      *pending;
+	gint         n_running;
+	guint        dispatch_id;
+
+	MateDesktopThumbnailFactory *factory;
+} ThumbnailLoaderPrivate;
+
+typedef struct {
+	ThumbnailLoader *loader;
+	GtkWidget       *tile;
+	gulong           destroy_id;
+
+	gchar  *uri;
+	gchar  *mime_type;
+	time_t  mtime;
+	gint    size;
+
+	gboolean  running;
+	gint      cancelled;
+	GdkPixbuf *pixbuf;
+} ThumbnailJob;
+
+#define PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), THUMBNAIL_LOADER_TYPE, ThumbnailLoaderPrivate))
+
+static void     thumbnail_loader_finalize (GObject *);
+static void     queue_dispatch            (ThumbnailLoader *);
+static gboolean dispatch_jobs             (gpointer);
+static void     job_run                   (gpointer, gpointer);
+static gboolean job_done_cb               (gpointer);
+static void     job_free                  (ThumbnailJob *);
+static void     tile_destroy_cb           (GtkWidget *, gpointer);
+
+static ThumbnailLoader *instance = NULL;
+
+ThumbnailLoader *
+thumbnail_loader_get_instance (void)
+{
+	if (! instance)
+		instance = g_object_new (THUMBNAIL_LOADER_TYPE, NULL);
+
+	return instance;
+}
+
+void
+thumbnail_loader_request (ThumbnailLoader *this, Tile *tile, const gchar *mime_type, time_t mtime)
+{
+	ThumbnailLoaderPrivate *priv = PRIVATE (this);
+
+	ThumbnailJob *job;
+
+
+	if (! (tile && tile->uri && g_str_has_prefix (tile->uri, "file://")))
+		return;
+
+	if (! priv->factory) {
+		CHECKPOINT ("thumbnail_loader_request(): initializing thumbnail factory");
+		io_guard_check ("thumbnail factory initialization");
+		priv->factory = g_object_ref (libslab_thumbnail_factory_get ());
+	}
+
+	job = g_new0 (ThumbnailJob, 1);
+
+	job->loader    = this;
+	job->tile      = GTK_WIDGET (tile);
+	job->uri       = g_strdup (tile->uri);
+	job->mime_type = g_strdup (mime_type);
+	job->mtime     = mtime;
+
+	gtk_icon_size_lookup (GTK_ICON_SIZE_DND, & job->size, NULL);
+
+	job->destroy_id = g_signal_connect (
+		G_OBJECT (tile), "destroy", G_CALLBACK (tile_destroy_cb), job);
+
+	g_queue_push_tail (priv->pending, job);
+
+	queue_dispatch (this);
+}
+
+static void
+thumbnail_loader_class_init (ThumbnailLoaderClass *this_class)
+{
+	GObjectClass *g_obj_class = G_OBJECT_CLASS (this_class);
+
+	g_obj_class->finalize = thumbnail_loader_finalize;
+
+	g_type_class_add_private (this_class, sizeof (ThumbnailLoaderPrivate));
+}
+
+static void
+thumbnail_loader_init (ThumbnailLoader *this)
+{
+	ThumbnailLoaderPrivate *priv = PRIVATE (this);
+
+	priv->pool        = g_thread_pool_new (job_run, this, MAX_RUNNING_JOBS, FALSE, NULL);
+	priv->pending     = g_queue_new ();
+	priv->n_running   = 0;
+	priv->dispatch_id = 0;
+	priv->factory     = NULL;
+}
+
+static void
+thumbnail_loader_finalize (GObject *g_obj)
+{
+	ThumbnailLoaderPrivate *priv = PRIVATE (g_obj);
+
+	ThumbnailJob *job;
+
+
+	if (priv->dispatch_id)
+		g_source_remove (priv->dispatch_id);
+
+	while ((job = g_queue_pop_head (priv->pending)))
+		job_free (job);
+
+	g_queue_free (priv->pending);
+
+	/* running jobs still hold a pointer to us, so wait for them */
+	g_thread_pool_free (priv->pool, TRUE, TRUE);
+
+	if (priv->factory)
+		g_object_unref (priv->factory);
+
+	G_OBJECT_CLASS (thumbnail_loader_parent_class)->finalize (g_obj);
+}
+
+static void
+queue_dispatch (ThumbnailLoader *this)
+{
+	ThumbnailLoaderPrivate *priv = PRIVATE (this);
+
+	/* dispatch from idle so that freshly created tiles have been placed into
+	 * their table (and thus onto a notebook page) before we rank them */
+	if (! priv->dispatch_id)
+		priv->dispatch_id = g_idle_add (dispatch_jobs, this);
+}
+
+/* Returns FALSE if the widget sits on a notebook page that is not the current
+ * one, i.e. the user cannot see it without switching pages first.
+ */
+static gboolean
+widget_is_on_current_page (GtkWidget *widget)
+{
+	GtkWidget *child;
+	GtkWidget *parent;
+
+	child = widget;
+
+	for (parent = gtk_widget_get_parent (child); parent; parent = gtk_widget_get_parent (parent)) {
+		if (
+			GTK_IS_NOTEBOOK (parent) &&
+			gtk_notebook_page_num (GTK_NOTEBOOK (parent), child) !=
+				gtk_notebook_get_current_page (GTK_NOTEBOOK (parent))
+		)
+			return FALSE;
+
+		child = parent;
+	}
+
+	return TRUE;
+}
+
+static ThumbnailJob *
+pop_most_urgent_job (ThumbnailLoader *this)
+{
+	ThumbnailLoaderPrivate *priv = PRIVATE (this);
+
+	ThumbnailJob *job;
+	GList        *node;
+
+
+	for (node = priv->pending->head; node; node = node->next) {
+		job = node->data;
+
+		if (widget_is_on_current_page (job->tile)) {
+			g_queue_delete_link (priv->pending, node);
+
+			return job;
+		}
+	}
+
+	return g_queue_pop_head (priv->pending);
+}
+
+static gboolean
+dispatch_jobs (gpointer data)
+{
+	ThumbnailLoader        *this = THUMBNAIL_LOADER (data);
+	ThumbnailLoaderPrivate *priv = PRIVATE (this);
+
+	ThumbnailJob *job;
+
+
+	priv->dispatch_id = 0;
+
+	while (priv->n_running < MAX_RUNNING_JOBS && (job = pop_most_urgent_job (this))) {
+		job->running = TRUE;
+		priv->n_running++;
+
+		g_thread_pool_push (priv->pool, job, NULL);
+	}
+
+	return FALSE;
+}
+
+/* runs in a worker thread, must not touch the tile */
+static void
+job_run (gpointer data, gpointer user_data)
+{
+	ThumbnailJob           *job  = data;
+	ThumbnailLoaderPrivate *priv = PRIVATE (user_data);
+
+	GdkPixbuf *thumb = NULL;
+	gchar     *thumb_path;
+
+
+	if (g_atomic_int_get (& job->cancelled))
+		goto exit;
+
+	thumb_path = mate_desktop_thumbnail_factory_lookup (priv->factory, job->uri, job->mtime);
+
+	if (thumb_path) {
+		thumb = gdk_pixbuf_new_from_file_at_size (thumb_path, job->size, job->size, NULL);
+		g_free (thumb_path);
+	}
+	else if (
+		job->mime_type &&
+		! g_atomic_int_get (& job->cancelled) &&
+		mate_desktop_thumbnail_factory_can_thumbnail (
+			priv->factory, job->uri, job->mime_type, job->mtime)
+	) {
+		thumb = mate_desktop_thumbnail_factory_generate_thumbnail (
+			priv->factory, job->uri, job->mime_type);
+
+		if (thumb) {
+			mate_desktop_thumbnail_factory_save_thumbnail (
+				priv->factory, thumb, job->uri, job->mtime);
+
+			job->pixbuf = gdk_pixbuf_scale_simple (
+				thumb, job->size, job->size * gdk_pixbuf_get_height (thumb) /
+					MAX (gdk_pixbuf_get_width (thumb), 1),
+				GDK_INTERP_BILINEAR);
+
+			g_object_unref (thumb);
+			thumb = NULL;
+		}
+		else
+			mate_desktop_thumbnail_factory_create_failed_thumbnail (
+				priv->factory, job->uri, job->mtime);
+	}
+
+	if (thumb)
+		job->pixbuf = thumb;
+
+exit:
+
+	g_idle_add (job_done_cb, job);
+}
+
+static gboolean
+job_done_cb (gpointer data)
+{
+	ThumbnailJob           *job    = data;
+	ThumbnailLoader        *loader = job->loader;
+	ThumbnailLoaderPrivate *priv   = PRIVATE (loader);
+
+
+	priv->n_running--;
+
+	if (job->tile && job->pixbuf && ! g_atomic_int_get (& job->cancelled))
+		gtk_image_set_from_pixbuf (GTK_IMAGE (NAMEPLATE_TILE (job->tile)->image), job->pixbuf);
+
+	job_free (job);
+
+	if (! g_queue_is_empty (priv->pending))
+		queue_dispatch (loader);
+
+	return FALSE;
+}
+
+static void
+job_free (ThumbnailJob *job)
+{
+	if (job->tile)
+		g_signal_handler_disconnect (job->tile, job->destroy_id);
+
+	if (job->pixbuf)
+		g_object_unref (job->pixbuf);
+
+	g_free (job->uri);
+	g_free (job->mime_type);
+	g_free (job);
+}
+
+static void
+tile_destroy_cb (GtkWidget *widget, gpointer user_data)
+{
+	ThumbnailJob           *job  = user_data;
+	ThumbnailLoaderPrivate *priv = PRIVATE (job->loader);
+
+	g_signal_handler_disconnect (job->tile, job->destroy_id);
+
+	job->tile = NULL;
+	g_atomic_int_set (& job->cancelled, 1);
+
+	if (! job->running) {
+		g_queue_remove (priv->pending, job);
+		job_free (job);
+	}
+}
@@ -0,0 +1,54 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __THUMBNAIL_LOADER_H__
+#define __THUMBNAIL_LOADER_H__
+
+#include <time.h>
+#include <gtk/gtk.h>
+#include <libslab/slab.h>
+
+G_BEGIN_DECLS
+
+#define THUMBNAIL_LOADER_TYPE         (thumbnail_loader_get_type ())
+#define THUMBNAIL_LOADER(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), THUMBNAIL_LOADER_TYPE, ThumbnailLoader))
+#define THUMBNAIL_LOADER_CLASS(c)     (G_TYPE_CHECK_CLASS_CAST ((c), THUMBNAIL_LOADER_TYPE, ThumbnailLoaderClass))
+#define IS_THUMBNAIL_LOADER(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), THUMBNAIL_LOADER_TYPE))
+#define IS_THUMBNAIL_LOADER_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE ((c), THUMBNAIL_LOADER_TYPE))
+#define THUMBNAIL_LOADER_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), THUMBNAIL_LOADER_TYPE, ThumbnailLoaderClass))
+
+typedef struct {
+	GObject g_object;
+} ThumbnailLoader;
+
+typedef struct {
+	GObjectClass g_object_class;
+} ThumbnailLoaderClass;
+
+GType thumbnail_loader_get_type (void);
+
+ThumbnailLoader *thumbnail_loader_get_instance (void);
+
+void thumbnail_loader_request (ThumbnailLoader *this, Tile *tile,
+                               const gchar *mime_type, time_t mtime);
+
+G_END_DECLS
+
+#endif
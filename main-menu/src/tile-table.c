@@ -20,10 +20,17 @@
 
 #include "tile-table.h"
 
+#include "bookmark-layer.h"
+#include "launcher.h"
+#include "usage-journal.h"
+#include "io-guard.h"
+#include "stall-watchdog.h"
+
 G_DEFINE_TYPE (TileTable, tile_table, GTK_TYPE_TABLE)
 
 typedef struct {
 	BookmarkAgent   *agent;
+	BookmarkLayer   *layer;
 
 	GList           *tiles;
 	GtkSizeGroup    *icon_size_group;
@@ -33,6 +40,8 @@ typedef struct {
 
 	gint             limit;
 
+	gint             n_items_consumed;
+
 	gboolean         reorderable;
 	gboolean         modifiable;
 
@@ -63,6 +72,13 @@ static void     drag_leave    (GtkWidget *, GdkDragContext *, guint);
 static void     drag_data_rcv (GtkWidget *, GdkDragContext *, gint, gint,
                                GtkSelectionData *, guint, guint);
 
+static void     adopt_tile               (TileTable *, GtkWidget *, gint);
+static gboolean extend_to_limit          (TileTable *);
+static gboolean shrink_to_limit          (TileTable *);
+static void     apply_delta              (TileTable *, BookmarkItem **, const BookmarkDelta *);
+static GtkWidget *take_tile              (TileTable *, gint);
+static void     shift_tiles              (TileTable *, gint, gint);
+static gint     compare_tile_items       (gconstpointer, gconstpointer);
 static void   update_bins                  (TileTable *, GList *);
 static void   insert_into_bin              (TileTable *, Tile *, gint);
 static void   empty_bin                    (TileTable *, gint);
@@ -72,9 +88,10 @@ static void   save_reorder                 (TileTable *, GList *);
 static void   connect_signal_if_not_exists (Tile *, const gchar *, GCallback, gpointer);
 
 static void tile_activated_cb  (Tile *, TileEvent *, gpointer);
+static void tile_action_triggered_cb (Tile *, TileEvent *, TileAction *, gpointer);
 static void tile_drag_begin_cb (GtkWidget *, GdkDragContext *, gpointer);
 static void tile_drag_end_cb   (GtkWidget *, GdkDragContext *, gpointer);
-static void agent_notify_cb    (GObject *, GParamSpec *, gpointer);
+static void items_changed_cb   (BookmarkLayer *, const GArray *, gpointer);
 
 GtkWidget *
 tile_table_new (BookmarkAgent *agent, gint limit, gint n_cols,
@@ -90,6 +107,7 @@ tile_table_new (BookmarkAgent *agent, gint limit, gint n_cols,
 	priv = PRIVATE (this);
 
 	priv->agent       = agent;
+	priv->layer       = bookmark_layer_get_for_agent (agent);
 	priv->limit       = limit;
 	priv->reorderable = reorderable;
 	priv->modifiable  = modifiable;
@@ -100,8 +118,8 @@ tile_table_new (BookmarkAgent *agent, gint limit, gint n_cols,
 	priv->item_func_data   = data_uti;
 
 	g_signal_connect (
-		G_OBJECT (priv->agent), "notify::" BOOKMARK_AGENT_ITEMS_PROP,
-		G_CALLBACK (agent_notify_cb), this);
+		G_OBJECT (priv->layer), "items-changed",
+		G_CALLBACK (items_changed_cb), this);
 
 	return this;
 }
@@ -113,21 +131,25 @@ tile_table_reload (TileTable *this)
 
 	BookmarkItem **items = NULL;
 	GList         *tiles = NULL;
+	GList         *indices = NULL;
 	GtkWidget     *tile;
 	gint           n_tiles;
 
 	GList *node;
+	GList *index;
 	gint   i;
 
-	libslab_checkpoint ("tile_table_reload(): start reloading");
+	CHECKPOINT ("tile_table_reload(): start reloading");
+	io_guard_check ("tile_table_reload()");
 
-	g_object_get (G_OBJECT (priv->agent), BOOKMARK_AGENT_ITEMS_PROP, & items, NULL);
+	items = bookmark_layer_get_items (priv->layer);
 
 	for (i = 0, n_tiles = 0; (priv->limit < 0 || n_tiles < priv->limit) && items && items [i]; ++i) {
 		tile = GTK_WIDGET (priv->create_tile_func (items [i], priv->tile_func_data));
 
 		if (tile) {
-			tiles = g_list_append (tiles, tile);
+			tiles   = g_list_append (tiles, tile);
+			indices = g_list_append (indices, GINT_TO_POINTER (i));
 			++n_tiles;
 		}
 	}
@@ -139,49 +161,64 @@ tile_table_reload (TileTable *this)
 
 	priv->tiles = NULL;
 
-	if (!priv->icon_size_group)
-		priv->icon_size_group = gtk_size_group_new (GTK_SIZE_GROUP_HORIZONTAL);
-
-	for (node = tiles; node; node = node->next) {
-		tile = GTK_WIDGET (node->data);
-
-		g_object_set_data (G_OBJECT (node->data), "tile-table", this);
+	/* a later change of the limit continues from here */
+	priv->n_items_consumed = i;
 
-		connect_signal_if_not_exists (
-			TILE (tile), "tile-activated", G_CALLBACK (tile_activated_cb), NULL);
-		connect_signal_if_not_exists (
-			TILE (tile), "drag-begin", G_CALLBACK (tile_drag_begin_cb), this);
-		connect_signal_if_not_exists (
-			TILE (tile), "drag-end", G_CALLBACK (tile_drag_end_cb), this);
-
-		priv->tiles = g_list_append (priv->tiles, tile);
-
-		if (IS_NAMEPLATE_TILE (tile))
-			gtk_size_group_add_widget (priv->icon_size_group, NAMEPLATE_TILE (tile)->image);
-	}
+	for (node = tiles, index = indices; node; node = node->next, index = index->next)
+		adopt_tile (this, GTK_WIDGET (node->data), GPOINTER_TO_INT (index->data));
 
 	g_list_free (tiles);
+	g_list_free (indices);
 
 	update_bins (this, priv->tiles);
 
 	g_object_notify (G_OBJECT (this), TILE_TABLE_TILES_PROP);
 
-	libslab_checkpoint ("tile_table_reload(): end reloading");
+	CHECKPOINT ("tile_table_reload(): end reloading");
 }
 
 void
 tile_table_add_uri (TileTable *this, const gchar *uri)
+{
+	const gchar *uris [2];
+
+
+	uris [0] = uri;
+	uris [1] = NULL;
+
+	tile_table_add_uris (this, uris);
+}
+
+/* Adds all of uris in one go, as a single batch for the layer, so the table
+ * changes and the batch is saved once rather than once per URI.
+ */
+void
+tile_table_add_uris (TileTable *this, const gchar * const *uris)
 {
 	TileTablePrivate *priv = PRIVATE (this);
 
-	BookmarkItem *item;
+	BookmarkItem **items;
+	gint           n_uris;
+	gint           i;
+	gint           n;
 
 
-	if (priv->create_item_func) {
-		item = priv->create_item_func (uri, priv->item_func_data);
-		bookmark_agent_add_item (priv->agent, item);
-		bookmark_item_free (item);
-	}
+	if (! (priv->create_item_func && uris && uris [0]))
+		return;
+
+	n_uris = g_strv_length ((gchar **) uris);
+	items  = g_new0 (BookmarkItem *, n_uris + 1);
+
+	for (i = 0, n = 0; i < n_uris; ++i)
+		if ((items [n] = priv->create_item_func (uris [i], priv->item_func_data)))
+			++n;
+
+	bookmark_layer_add_items (priv->layer, items);
+
+	for (i = 0; i < n; ++i)
+		bookmark_item_free (items [i]);
+
+	g_free (items);
 }
 
 static void
@@ -243,6 +280,7 @@ tile_table_init (TileTable *this)
 	TileTablePrivate *priv = PRIVATE (this);
 
 	priv->agent               = NULL;
+	priv->layer               = NULL;
 
 	priv->tiles               = NULL;
 
@@ -251,6 +289,8 @@ tile_table_init (TileTable *this)
 
 	priv->limit               = -1;
 
+	priv->n_items_consumed    = 0;
+
 	priv->reorderable         = FALSE;
 	priv->modifiable          = FALSE;
 
@@ -305,7 +345,11 @@ set_property (GObject *g_obj, guint prop_id, const GValue *value, GParamSpec *ps
 
 			if (limit != priv->limit) {
 				priv->limit = limit;
-				update_bins (this, priv->tiles);
+
+				if (extend_to_limit (this) || shrink_to_limit (this)) {
+					update_bins (this, priv->tiles);
+					g_object_notify (G_OBJECT (this), TILE_TABLE_TILES_PROP);
+				}
 			}
 
 			break;
@@ -433,7 +477,6 @@ drag_data_rcv (GtkWidget *widget, GdkDragContext *context, gint x, gint y,
 	GList *tiles_new;
 
 	gchar **uris;
-	gint    i;
 
 
 	src_tile = gtk_drag_get_source_widget (context);
@@ -456,8 +499,7 @@ drag_data_rcv (GtkWidget *widget, GdkDragContext *context, gint x, gint y,
 	else {
 		uris = gtk_selection_data_get_uris (selection);
 
-		for (i = 0; uris && uris [i]; ++i)
-			tile_table_add_uri (this, uris [i]);
+		tile_table_add_uris (this, (const gchar * const *) uris);
 
 		g_strfreev (uris);
 	}
@@ -465,6 +507,199 @@ drag_data_rcv (GtkWidget *widget, GdkDragContext *context, gint x, gint y,
 	gtk_drag_finish (context, TRUE, FALSE, (guint32) time);
 }
 
+/* Takes a freshly created tile for the item at item_index into the table */
+static void
+adopt_tile (TileTable *this, GtkWidget *tile, gint item_index)
+{
+	TileTablePrivate *priv = PRIVATE (this);
+
+	if (!priv->icon_size_group)
+		priv->icon_size_group = gtk_size_group_new (GTK_SIZE_GROUP_HORIZONTAL);
+
+	g_object_set_data (G_OBJECT (tile), "tile-table", this);
+	g_object_set_data (G_OBJECT (tile), "tile-table-item", GINT_TO_POINTER (item_index));
+
+	connect_signal_if_not_exists (
+		TILE (tile), "tile-activated", G_CALLBACK (tile_activated_cb), NULL);
+	connect_signal_if_not_exists (
+		TILE (tile), "drag-begin", G_CALLBACK (tile_drag_begin_cb), this);
+	connect_signal_if_not_exists (
+		TILE (tile), "drag-end", G_CALLBACK (tile_drag_end_cb), this);
+	connect_signal_if_not_exists (
+		TILE (tile), "tile-action-triggered", G_CALLBACK (tile_action_triggered_cb), this);
+
+	priv->tiles = g_list_append (priv->tiles, tile);
+
+	if (IS_NAMEPLATE_TILE (tile))
+		gtk_size_group_add_widget (priv->icon_size_group, NAMEPLATE_TILE (tile)->image);
+}
+
+/* Creates tiles for the items that the last reload did not get to, picking up
+ * at the first item it left unconsumed, until the limit is reached.  Returns
+ * TRUE if any tile was added; the caller updates the bins.
+ */
+static gboolean
+extend_to_limit (TileTable *this)
+{
+	TileTablePrivate *priv = PRIVATE (this);
+
+	BookmarkItem **items;
+	GtkWidget     *tile;
+	gint           n_tiles;
+	gint           n_tiles_old;
+
+	gint i;
+
+
+	items = bookmark_layer_get_items (priv->layer);
+
+	n_tiles = n_tiles_old = g_list_length (priv->tiles);
+
+	for (i = priv->n_items_consumed; (priv->limit < 0 || n_tiles < priv->limit) && items && items [i]; ++i) {
+		tile = GTK_WIDGET (priv->create_tile_func (items [i], priv->tile_func_data));
+
+		if (tile) {
+			adopt_tile (this, tile, i);
+			++n_tiles;
+		}
+	}
+
+	priv->n_items_consumed = i;
+
+	return n_tiles != n_tiles_old;
+}
+
+/* Releases the tiles past the limit and rewinds the consumed items to the
+ * first of them, so that growing the limit again re-creates exactly those.
+ * Returns TRUE if any tile was released; the caller updates the bins.
+ */
+static gboolean
+shrink_to_limit (TileTable *this)
+{
+	TileTablePrivate *priv = PRIVATE (this);
+
+	GList *excess;
+	GList *node;
+
+
+	if (priv->limit < 0 || ! (excess = g_list_nth (priv->tiles, priv->limit)))
+		return FALSE;
+
+	if (excess->prev)
+		excess->prev->next = NULL;
+	else
+		priv->tiles = NULL;
+
+	excess->prev = NULL;
+
+	priv->n_items_consumed = GPOINTER_TO_INT (
+		g_object_get_data (G_OBJECT (excess->data), "tile-table-item"));
+
+	for (node = excess; node; node = node->next)
+		gtk_widget_destroy (GTK_WIDGET (node->data));
+
+	g_list_free (excess);
+
+	return TRUE;
+}
+
+/* Applies one step of the layer's edit script.  Tiles remember the index of
+ * their item, and only items before priv->n_items_consumed can have a tile,
+ * so a step that lands past that point leaves the tiles alone.
+ */
+static void
+apply_delta (TileTable *this, BookmarkItem **items, const BookmarkDelta *delta)
+{
+	TileTablePrivate *priv = PRIVATE (this);
+
+	GtkWidget *tile = NULL;
+
+
+	if (delta->type != BOOKMARK_DELTA_INSERTED)
+		tile = take_tile (this, delta->from);
+
+	if (delta->type == BOOKMARK_DELTA_REMOVED || delta->to >= priv->n_items_consumed) {
+		if (tile)
+			gtk_widget_destroy (tile);
+
+		return;
+	}
+
+	shift_tiles (this, delta->to, 1);
+	priv->n_items_consumed++;
+
+	if (tile) {
+		g_object_set_data (G_OBJECT (tile), "tile-table-item", GINT_TO_POINTER (delta->to));
+		priv->tiles = g_list_append (priv->tiles, tile);
+
+		return;
+	}
+
+	if (! (items && items [delta->to]))
+		return;
+
+	tile = GTK_WIDGET (priv->create_tile_func (items [delta->to], priv->tile_func_data));
+
+	if (tile)
+		adopt_tile (this, tile, delta->to);
+}
+
+/* Removes the item at index from the consumed items, and hands back its tile
+ * (if it has one) after taking it off the list.
+ */
+static GtkWidget *
+take_tile (TileTable *this, gint index)
+{
+	TileTablePrivate *priv = PRIVATE (this);
+
+	GtkWidget *tile = NULL;
+	GList     *node;
+
+
+	if (index >= priv->n_items_consumed)
+		return NULL;
+
+	for (node = priv->tiles; node; node = node->next) {
+		if (GPOINTER_TO_INT (g_object_get_data (G_OBJECT (node->data), "tile-table-item")) == index) {
+			tile = GTK_WIDGET (node->data);
+			priv->tiles = g_list_delete_link (priv->tiles, node);
+
+			break;
+		}
+	}
+
+	shift_tiles (this, index, -1);
+	priv->n_items_consumed--;
+
+	return tile;
+}
+
+/* Adds delta to the item index of every tile at or after index */
+static void
+shift_tiles (TileTable *this, gint index, gint delta)
+{
+	TileTablePrivate *priv = PRIVATE (this);
+
+	GList *node;
+	gint   item;
+
+
+	for (node = priv->tiles; node; node = node->next) {
+		item = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (node->data), "tile-table-item"));
+
+		if (item >= index)
+			g_object_set_data (G_OBJECT (node->data), "tile-table-item", GINT_TO_POINTER (item + delta));
+	}
+}
+
+static gint
+compare_tile_items (gconstpointer a, gconstpointer b)
+{
+	return
+		GPOINTER_TO_INT (g_object_get_data (G_OBJECT (a), "tile-table-item")) -
+		GPOINTER_TO_INT (g_object_get_data (G_OBJECT (b), "tile-table-item"));
+}
+
 static void
 connect_signal_if_not_exists (Tile *tile, const gchar *signal, GCallback cb, gpointer user_data)
 {
@@ -522,11 +757,15 @@ update_bins (TileTable *this, GList *tiles)
 	gint   i;
 
 
-	if (! tiles)
-		return;
-
 	g_object_get (G_OBJECT (this), "n-columns", & n_cols, NULL);
 
+	/* drop the bins and rows left from the last tiles */
+	if (! tiles) {
+		resize_table (this, 0, n_cols);
+
+		return;
+	}
+
 	n_tiles = g_list_length (tiles);
 
 	n_rows = (n_tiles + n_cols - 1) / n_cols;
@@ -647,7 +886,8 @@ resize_table (TileTable *this, guint n_rows_new, guint n_cols_new)
 	priv->bins   = bins_new;
 	priv->n_bins = n_bins_new;
 
-	gtk_table_resize (GTK_TABLE (this), n_rows_new, n_cols_new);
+	/* a GtkTable keeps at least one row */
+	gtk_table_resize (GTK_TABLE (this), MAX (n_rows_new, 1), n_cols_new);
 }
 
 static void
@@ -684,18 +924,14 @@ save_reorder (TileTable *this, GList *tiles_new)
 		}
 	}
 
+	/* the layer answers with the moves, which reorder priv->tiles */
 	if (! equal) {
-		g_list_free (priv->tiles);
-		priv->tiles = g_list_copy (tiles_new);
-		update_bins (this, priv->tiles);
-
 		uris = g_new0 (gchar *, n_items + 1);
 
-		for (node_u = priv->tiles, i = 0; node_u && i < n_items; node_u = node_u->next, ++i)
+		for (node_u = tiles_new, i = 0; node_u && i < n_items; node_u = node_u->next, ++i)
 			uris [i] = g_strdup (TILE (node_u->data)->uri);
 
-		bookmark_agent_reorder_items (priv->agent, (const gchar **) uris);
-		g_object_notify (G_OBJECT (this), TILE_TABLE_TILES_PROP);
+		bookmark_layer_reorder_items (priv->layer, (const gchar **) uris);
 
 		g_strfreev (uris);
 	}
@@ -707,9 +943,42 @@ tile_activated_cb (Tile *tile, TileEvent *event, gpointer user_data)
 	if (event->type == TILE_EVENT_ACTIVATED_DOUBLE_CLICK)
 		return;
 
+	/* applications start through the launcher, which hides the menu first;
+	 * it declines what the tile's own action handles better */
+	if (IS_APPLICATION_TILE (tile) && launcher_launch (launcher_get_instance (), tile->uri, event->time))
+		return;
+
+	/* the launcher journals its own launches */
+	if (IS_APPLICATION_TILE (tile))
+		usage_journal_record (usage_journal_get_instance (), tile->uri);
+
 	tile_trigger_action_with_time (tile, tile->default_action, event->time);
 }
 
+/* The tile's own actions go to the agent, which has not seen what the layer
+ * holds back yet: removing an item dropped a moment ago would do nothing, and
+ * the next compaction would undo any other change.  Taking a tile off an
+ * edited list goes through the layer instead; anything else finds the agent
+ * brought up to date first.  Runs before the action, which is the signal's
+ * class handler.
+ */
+static void
+tile_action_triggered_cb (Tile *tile, TileEvent *event, TileAction *action, gpointer user_data)
+{
+	TileTablePrivate *priv = PRIVATE (user_data);
+
+	const gchar *uris [] = { tile->uri, NULL };
+
+
+	if (TILE_ACTION_CHECK_FLAG (action, TILE_ACTION_UPDATES_MAIN_MENU) && bookmark_layer_has_journal (priv->layer)) {
+		g_signal_stop_emission_by_name (tile, "tile-action-triggered");
+
+		bookmark_layer_remove_items (priv->layer, uris);
+	}
+	else
+		bookmark_layer_commit (priv->layer);
+}
+
 static void
 tile_drag_begin_cb (GtkWidget *widget, GdkDragContext *context, gpointer user_data)
 {
@@ -729,7 +998,35 @@ tile_drag_end_cb (GtkWidget *widget, GdkDragContext *context, gpointer user_data
 }
 
 static void
-agent_notify_cb (GObject *g_obj, GParamSpec *pspec, gpointer user_data)
+items_changed_cb (BookmarkLayer *layer, const GArray *deltas, gpointer user_data)
 {
-	tile_table_reload (TILE_TABLE (user_data));
+	TileTable        *this = TILE_TABLE (user_data);
+	TileTablePrivate *priv = PRIVATE    (this);
+
+	BookmarkItem **items;
+	gint           i;
+
+
+	if (! deltas) {
+		tile_table_reload (this);
+
+		return;
+	}
+
+	CHECKPOINT ("tile table: applying item deltas");
+
+	items = bookmark_layer_get_items (layer);
+
+	for (i = 0; i < deltas->len; ++i)
+		apply_delta (this, items, & g_array_index (deltas, BookmarkDelta, i));
+
+	priv->tiles = g_list_sort (priv->tiles, compare_tile_items);
+
+	if (! shrink_to_limit (this))
+		extend_to_limit (this);
+
+	if (priv->tiles)
+		update_bins (this, priv->tiles);
+
+	g_object_notify (G_OBJECT (this), TILE_TABLE_TILES_PROP);
 }
@@ -57,6 +57,7 @@ GtkWidget *tile_table_new     (BookmarkAgent *agent, gint limit, gint n_cols,
                                URIToItemFunc uti, gpointer data_uti);
 void       tile_table_reload  (TileTable *this);
 void       tile_table_add_uri (TileTable *this, const gchar *uri);
+void       tile_table_add_uris (TileTable *this, const gchar * const *uris);
 
 G_END_DECLS
 
@@ -0,0 +1,884 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#include "usage-journal.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <gio/gio.h>
+#include <gio/gdesktopappinfo.h>
+
+#include "app-index.h"
+#include "io-guard.h"
+#include "stall-watchdog.h"
+
+/* The applications started from the menu, kept by the menu itself, so that
+ * the recent applications no longer depend on recently-used.xbel: a file
+ * every program rewrites all the time, mostly for documents, and which had to
+ * be parsed whole to find the few applications in it.
+ *
+ * JOURNAL_FILE_NAME, in the user's data directory, starts with JOURNAL_MAGIC
+ * and is followed by records of RECORD_HEADER_LENGTH bytes, all little
+ * endian:
+ *
+ *     guint16 key length, guint16 uses, guint32 time of the last use
+ *
+ * each followed by the key: the desktop file id of the application, or the
+ * uri of its desktop file if it is not installed in an applications
+ * directory.  A launch appends one record with a single use, with O_APPEND so
+ * that several menus can share the file.  As the file only grows, a refresh
+ * reads no more than what was appended since the last one.  Once it holds
+ * COMPACT_SLACK records more than it has keys, it is rewritten from a low
+ * priority idle with one record per key, dropping those unused for
+ * MAX_AGE_DAYS and all but the MAX_ENTRIES most recent.  Appends hold a shared
+ * flock () on LOCK_FILE_NAME next to the journal, and a rewrite an exclusive
+ * one while it reads what was appended last and replaces the file, so no
+ * record of another menu is lost to it.  The menu that finds no journal
+ * creates it, magic first, under the exclusive lock.
+ *
+ * usage_journal_get_store () presents the journal as a GBookmarkFile like the
+ * recently-used store, one desktop entry per application with its uses and
+ * the time of the last, for the bookmark agent and Frecency.  Until the
+ * journal exists, usage_journal_needs_import () says so, and the applications
+ * in the recently-used store are imported once.
+ */
+
+#define JOURNAL_DIR_NAME     "gnome-main-menu"
+#define JOURNAL_FILE_NAME    "app-usage"
+#define JOURNAL_MAGIC        "MMAPPUJ1"
+#define JOURNAL_MAGIC_LENGTH 8
+#define LOCK_FILE_NAME       "app-usage.lock"
+
+#define RECORD_HEADER_LENGTH 8
+#define MAX_KEY_LENGTH       1024
+
+#define COMPACT_SLACK        256
+#define MAX_ENTRIES          200
+#define MAX_AGE_DAYS         180
+
+#define MONITOR_RATE_LIMIT_MILLISECONDS 2000
+
+#define DESKTOP_MIME_TYPE    "application/x-desktop"
+#define STORE_APP_NAME       "gnome-main-menu"
+#define STORE_APP_EXEC       "main-menu"
+
+G_DEFINE_TYPE (UsageJournal, usage_journal, G_TYPE_OBJECT)
+
+typedef struct {
+	guint  count;
+	time_t stamp;
+} UsageEntry;
+
+typedef struct {
+	gchar         *path;
+	gchar         *lock_path;
+	GHashTable    *entries;
+	GHashTable    *uris;
+	GBookmarkFile *store;
+
+	dev_t          dev;
+	ino_t          ino;
+	goffset        offset;
+	guint          n_records;
+	gboolean       missing;
+	gboolean       damaged;
+
+	GByteArray    *pending;
+	guint          flush_id;
+	guint          compact_id;
+
+	GFileMonitor  *monitor;
+	AppIndex      *index;
+} UsageJournalPrivate;
+
+enum {
+	CHANGED,
+	LAST_SIGNAL
+};
+
+static guint usage_journal_signals [LAST_SIGNAL] = { 0 };
+
+#define PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), USAGE_JOURNAL_TYPE, UsageJournalPrivate))
+
+static void         usage_journal_finalize (GObject *);
+static gchar       *get_key                (const gchar *);
+static const gchar *get_uri                (UsageJournal *, const gchar *);
+static void         refresh                (UsageJournal *);
+static void         read_records           (UsageJournal *);
+static gint         lock_journal           (UsageJournal *, gint);
+static void         unlock_journal         (gint);
+static void         reset                  (UsageJournal *);
+static void         add_use                (UsageJournal *, gchar *, guint, time_t);
+static void         compact                (UsageJournal *);
+static gboolean     compact_cb             (gpointer);
+static void         append_record          (GByteArray *, const gchar *, guint, time_t);
+static void         drop_store             (UsageJournal *);
+static gint         compare_last_use       (gconstpointer, gconstpointer, gpointer);
+static gboolean     flush_cb               (gpointer);
+static void         write_pending          (UsageJournal *);
+static gint         create_journal         (UsageJournal *, gint);
+static void         journal_changed_cb     (GFileMonitor *, GFile *, GFile *, GFileMonitorEvent, gpointer);
+static void         index_changed_cb       (AppIndex *, gpointer);
+
+static UsageJournal *instance = NULL;
+
+UsageJournal *
+usage_journal_get_instance (void)
+{
+	if (! instance)
+		instance = g_object_new (USAGE_JOURNAL_TYPE, NULL);
+
+	return instance;
+}
+
+/* Notes a launch of desktop_entry, a desktop file id, path or uri.  The record
+ * is written from idle, after the launch itself.
+ */
+void
+usage_journal_record (UsageJournal *this, const gchar *desktop_entry)
+{
+	UsageJournalPrivate *priv = PRIVATE (this);
+
+	gchar *key;
+
+
+	if (! desktop_entry || ! (key = get_key (desktop_entry)))
+		return;
+
+	if (key [0] && strlen (key) <= MAX_KEY_LENGTH) {
+		append_record (priv->pending, key, 1, time (NULL));
+
+		if (! priv->flush_id)
+			priv->flush_id = g_idle_add_full (G_PRIORITY_LOW, flush_cb, this, NULL);
+	}
+
+	g_free (key);
+}
+
+/* Returns the journal as a store of desktop entries, after reading what was
+ * appended since the last call.  The store belongs to the journal and stays
+ * valid until the next call.
+ */
+GBookmarkFile *
+usage_journal_get_store (UsageJournal *this)
+{
+	UsageJournalPrivate *priv = PRIVATE (this);
+
+	UsageEntry     *entry;
+	const gchar    *uri;
+	GHashTableIter  iter;
+	gpointer        key;
+	gpointer        value;
+
+
+	refresh (this);
+
+	if (priv->store)
+		return priv->store;
+
+	CHECKPOINT ("usage_journal_get_store(): building store");
+
+	priv->store = g_bookmark_file_new ();
+
+	g_hash_table_iter_init (& iter, priv->entries);
+
+	while (g_hash_table_iter_next (& iter, & key, & value)) {
+		entry = value;
+
+		if (! (uri = get_uri (this, key)))
+			continue;
+
+		g_bookmark_file_set_mime_type (priv->store, uri, DESKTOP_MIME_TYPE);
+		g_bookmark_file_set_app_info (
+			priv->store, uri, STORE_APP_NAME, STORE_APP_EXEC, entry->count, entry->stamp, NULL);
+		g_bookmark_file_set_visited  (priv->store, uri, entry->stamp);
+		g_bookmark_file_set_modified (priv->store, uri, entry->stamp);
+	}
+
+	return priv->store;
+}
+
+/* Returns TRUE if there is no journal yet, see usage_journal_import () */
+gboolean
+usage_journal_needs_import (UsageJournal *this)
+{
+	refresh (this);
+
+	return PRIVATE (this)->missing;
+}
+
+/* Starts the journal with the desktop entries of store, normally the
+ * recently-used store, with the number and the time of their uses.
+ */
+void
+usage_journal_import (UsageJournal *this, GBookmarkFile *store)
+{
+	gchar  **uris;
+	gchar  **apps;
+	gchar   *mime_type;
+	gchar   *key;
+	guint    count;
+	guint    app_count;
+	time_t   stamp;
+	time_t   app_stamp;
+
+	gint i;
+	gint j;
+
+
+	uris = g_bookmark_file_get_uris (store, NULL);
+
+	for (i = 0; uris && uris [i]; ++i) {
+		mime_type = g_bookmark_file_get_mime_type (store, uris [i], NULL);
+
+		if (! mime_type || strcmp (mime_type, DESKTOP_MIME_TYPE) || ! (key = get_key (uris [i]))) {
+			g_free (mime_type);
+
+			continue;
+		}
+
+		g_free (mime_type);
+
+		apps  = g_bookmark_file_get_applications (store, uris [i], NULL, NULL);
+		count = 0;
+		stamp = g_bookmark_file_get_visited (store, uris [i], NULL);
+
+		for (j = 0; apps && apps [j]; ++j) {
+			if (g_bookmark_file_get_app_info (store, uris [i], apps [j], NULL, & app_count, & app_stamp, NULL)) {
+				count += app_count;
+				stamp  = MAX (stamp, app_stamp);
+			}
+		}
+
+		g_strfreev (apps);
+
+		if (strlen (key) <= MAX_KEY_LENGTH)
+			add_use (this, key, MAX (count, 1), stamp);
+		else
+			g_free (key);
+	}
+
+	g_strfreev (uris);
+
+	compact (this);
+}
+
+static void
+usage_journal_class_init (UsageJournalClass *this_class)
+{
+	GObjectClass *g_obj_class = G_OBJECT_CLASS (this_class);
+
+	g_obj_class->finalize = usage_journal_finalize;
+
+	usage_journal_signals [CHANGED] = g_signal_new (
+		"changed", G_TYPE_FROM_CLASS (this_class),
+		G_SIGNAL_RUN_LAST, G_STRUCT_OFFSET (UsageJournalClass, changed),
+		NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+	g_type_class_add_private (this_class, sizeof (UsageJournalPrivate));
+}
+
+static void
+usage_journal_init (UsageJournal *this)
+{
+	UsageJournalPrivate *priv = PRIVATE (this);
+
+	GFile *file;
+
+
+	priv->path      = g_build_filename (
+		g_get_user_data_dir (), JOURNAL_DIR_NAME, JOURNAL_FILE_NAME, NULL);
+	priv->lock_path = g_build_filename (
+		g_get_user_data_dir (), JOURNAL_DIR_NAME, LOCK_FILE_NAME, NULL);
+	priv->entries   = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	priv->uris      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	priv->store     = NULL;
+
+	priv->dev       = 0;
+	priv->ino       = 0;
+	priv->offset    = 0;
+	priv->n_records = 0;
+	priv->missing   = FALSE;
+	priv->damaged   = FALSE;
+
+	priv->pending    = g_byte_array_new ();
+	priv->flush_id   = 0;
+	priv->compact_id = 0;
+
+	/* for the records of other menus */
+	file = g_file_new_for_path (priv->path);
+	priv->monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, NULL);
+	g_object_unref (file);
+
+	if (priv->monitor) {
+		g_file_monitor_set_rate_limit (priv->monitor, MONITOR_RATE_LIMIT_MILLISECONDS);
+
+		g_signal_connect (
+			G_OBJECT (priv->monitor), "changed",
+			G_CALLBACK (journal_changed_cb), this);
+	}
+
+	priv->index = g_object_ref (app_index_get_instance ());
+
+	g_signal_connect (
+		G_OBJECT (priv->index), "changed",
+		G_CALLBACK (index_changed_cb), this);
+}
+
+static void
+usage_journal_finalize (GObject *g_obj)
+{
+	UsageJournalPrivate *priv = PRIVATE (g_obj);
+
+	if (priv->flush_id) {
+		g_source_remove (priv->flush_id);
+		write_pending (USAGE_JOURNAL (g_obj));
+	}
+
+	/* the next run compacts it */
+	if (priv->compact_id)
+		g_source_remove (priv->compact_id);
+
+	if (priv->monitor) {
+		g_file_monitor_cancel (priv->monitor);
+		g_object_unref (priv->monitor);
+	}
+
+	g_signal_handlers_disconnect_by_func (priv->index, index_changed_cb, g_obj);
+	g_object_unref (priv->index);
+
+	drop_store (USAGE_JOURNAL (g_obj));
+
+	g_hash_table_destroy (priv->entries);
+	g_hash_table_destroy (priv->uris);
+	g_byte_array_free (priv->pending, TRUE);
+	g_free (priv->path);
+	g_free (priv->lock_path);
+
+	G_OBJECT_CLASS (usage_journal_parent_class)->finalize (g_obj);
+}
+
+/* Returns the key desktop_entry is journaled under: its desktop file id if it
+ * lies in one of the applications directories, else its uri.
+ */
+static gchar *
+get_key (const gchar *desktop_entry)
+{
+	const gchar * const *data_dirs;
+	gchar               *path = NULL;
+	gchar               *dir;
+	gchar               *key  = NULL;
+	gsize                length;
+
+	gint i;
+
+
+	if (g_str_has_prefix (desktop_entry, "file://"))
+		path = g_filename_from_uri (desktop_entry, NULL, NULL);
+	else if (g_path_is_absolute (desktop_entry))
+		path = g_strdup (desktop_entry);
+	else
+		return g_strdup (desktop_entry);
+
+	if (! path)
+		return NULL;
+
+	data_dirs = g_get_system_data_dirs ();
+
+	for (i = -1; ! key && (i < 0 || data_dirs [i]); ++i) {
+		dir    = g_build_filename (i < 0 ? g_get_user_data_dir () : data_dirs [i], "applications", NULL);
+		length = strlen (dir);
+
+		/* see the Desktop Entry Specification for ids in subdirectories */
+		if (g_str_has_prefix (path, dir) && path [length] == G_DIR_SEPARATOR && path [length + 1]) {
+			key = g_strdup (path + length + 1);
+			g_strdelimit (key, G_DIR_SEPARATOR_S, '-');
+		}
+
+		g_free (dir);
+	}
+
+	if (! key)
+		key = g_filename_to_uri (path, NULL, NULL);
+
+	g_free (path);
+
+	return key;
+}
+
+/* Returns the uri of the desktop file behind key, or NULL if it is gone */
+static const gchar *
+get_uri (UsageJournal *this, const gchar *key)
+{
+	UsageJournalPrivate *priv = PRIVATE (this);
+
+	const gchar * const *data_dirs;
+	GDesktopAppInfo     *info;
+	gchar               *path;
+	gchar               *uri = NULL;
+
+	gint i;
+
+
+	if (strstr (key, "://"))
+		return key;
+
+	if (g_hash_table_lookup_extended (priv->uris, key, NULL, (gpointer *) & uri))
+		return uri;
+
+	data_dirs = g_get_system_data_dirs ();
+
+	for (i = -1; ! uri && (i < 0 || data_dirs [i]); ++i) {
+		path = g_build_filename (i < 0 ? g_get_user_data_dir () : data_dirs [i], "applications", key, NULL);
+
+		if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+			uri = g_filename_to_uri (path, NULL, NULL);
+
+		g_free (path);
+	}
+
+	/* ids of entries in subdirectories */
+	if (! uri && (info = g_desktop_app_info_new (key))) {
+		if (g_desktop_app_info_get_filename (info))
+			uri = g_filename_to_uri (g_desktop_app_info_get_filename (info), NULL, NULL);
+
+		g_object_unref (info);
+	}
+
+	g_hash_table_insert (priv->uris, g_strdup (key), uri);
+
+	return uri;
+}
+
+/* Reads the records appended since the last refresh, or all of them if the
+ * file was replaced in the meantime, and schedules a compaction if due; its
+ * synced write and exclusive lock stay off the path of the caller.
+ */
+static void
+refresh (UsageJournal *this)
+{
+	UsageJournalPrivate *priv = PRIVATE (this);
+
+
+	io_guard_check ("usage journal refresh");
+
+	read_records (this);
+
+	if (
+		! priv->compact_id &&
+		(priv->damaged || priv->n_records > g_hash_table_size (priv->entries) + COMPACT_SLACK)
+	)
+		priv->compact_id = g_idle_add_full (G_PRIORITY_LOW, compact_cb, this, NULL);
+}
+
+static void
+read_records (UsageJournal *this)
+{
+	UsageJournalPrivate *priv = PRIVATE (this);
+
+	struct stat  info;
+	gchar       *buffer;
+	gsize        length;
+	gsize        position = 0;
+	guint16      key_length;
+	guint16      count;
+	guint32      stamp;
+	gint         fd;
+
+
+	if ((fd = open (priv->path, O_RDONLY | O_CLOEXEC)) < 0) {
+		if (errno == ENOENT && ! priv->missing) {
+			reset (this);
+			priv->missing = TRUE;
+		}
+
+		return;
+	}
+
+	priv->missing = FALSE;
+
+	if (fstat (fd, & info)) {
+		close (fd);
+
+		return;
+	}
+
+	/* compacted, possibly by another menu */
+	if (info.st_dev != priv->dev || info.st_ino != priv->ino || info.st_size < priv->offset) {
+		reset (this);
+
+		priv->dev = info.st_dev;
+		priv->ino = info.st_ino;
+	}
+
+	if (info.st_size == priv->offset) {
+		close (fd);
+
+		return;
+	}
+
+	length = info.st_size - priv->offset;
+	buffer = g_malloc (length);
+
+	if (pread (fd, buffer, length, priv->offset) != (gssize) length) {
+		g_free (buffer);
+		close (fd);
+
+		return;
+	}
+
+	close (fd);
+
+	if (priv->offset == 0) {
+		if (length < JOURNAL_MAGIC_LENGTH || memcmp (buffer, JOURNAL_MAGIC, JOURNAL_MAGIC_LENGTH))
+			priv->damaged = TRUE;
+
+		position = JOURNAL_MAGIC_LENGTH;
+	}
+
+	while (! priv->damaged && position + RECORD_HEADER_LENGTH <= length) {
+		memcpy (& key_length, buffer + position,     2);
+		memcpy (& count,      buffer + position + 2, 2);
+		memcpy (& stamp,      buffer + position + 4, 4);
+
+		key_length = GUINT16_FROM_LE (key_length);
+		count      = GUINT16_FROM_LE (count);
+		stamp      = GUINT32_FROM_LE (stamp);
+
+		if (key_length == 0 || key_length > MAX_KEY_LENGTH || count == 0)
+			priv->damaged = TRUE;
+
+		/* the rest of an append yet to come, or a torn one */
+		else if (position + RECORD_HEADER_LENGTH + key_length > length)
+			break;
+
+		else {
+			add_use (this,
+				g_strndup (buffer + position + RECORD_HEADER_LENGTH, key_length), count, stamp);
+
+			position += RECORD_HEADER_LENGTH + key_length;
+			priv->n_records++;
+		}
+	}
+
+	g_free (buffer);
+
+	/* a damaged journal is rewritten from the records read so far */
+	priv->offset = priv->damaged ? info.st_size : priv->offset + position;
+
+	drop_store (this);
+}
+
+/* Returns a descriptor holding the journal lock, shared or exclusive as
+ * operation says, or -1 if the lock file cannot be used, in which case the
+ * caller goes on without it.
+ */
+static gint
+lock_journal (UsageJournal *this, gint operation)
+{
+	UsageJournalPrivate *priv = PRIVATE (this);
+
+	gint fd;
+
+
+	if ((fd = open (priv->lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600)) < 0)
+		return -1;
+
+	while (flock (fd, operation)) {
+		if (errno != EINTR) {
+			close (fd);
+
+			return -1;
+		}
+	}
+
+	return fd;
+}
+
+static void
+unlock_journal (gint fd)
+{
+	/* closing the last descriptor releases the lock */
+	if (fd >= 0)
+		close (fd);
+}
+
+static void
+reset (UsageJournal *this)
+{
+	UsageJournalPrivate *priv = PRIVATE (this);
+
+	g_hash_table_remove_all (priv->entries);
+
+	priv->dev       = 0;
+	priv->ino       = 0;
+	priv->offset    = 0;
+	priv->n_records = 0;
+	priv->damaged   = FALSE;
+
+	drop_store (this);
+}
+
+/* takes key */
+static void
+add_use (UsageJournal *this, gchar *key, guint count, time_t stamp)
+{
+	UsageJournalPrivate *priv = PRIVATE (this);
+
+	UsageEntry *entry;
+
+
+	if ((entry = g_hash_table_lookup (priv->entries, key)))
+		g_free (key);
+	else {
+		entry = g_new0 (UsageEntry, 1);
+		g_hash_table_insert (priv->entries, key, entry);
+	}
+
+	entry->count += count;
+	entry->stamp  = MAX (entry->stamp, stamp);
+}
+
+/* Rewrites the journal with one record per key, after reading what other
+ * menus appended since the last refresh.
+ */
+static void
+compact (UsageJournal *this)
+{
+	UsageJournalPrivate *priv = PRIVATE (this);
+
+	GByteArray  *data;
+	GList       *keys;
+	GList       *node;
+	UsageEntry  *entry;
+	struct stat  info;
+	gchar       *dir;
+	time_t       oldest;
+	guint        n_records = 0;
+	gint         lock_fd;
+
+
+	CHECKPOINT ("usage journal: compacting %s", priv->path);
+
+	dir = g_path_get_dirname (priv->path);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+
+	/* no append can land in the file being replaced while this is held */
+	lock_fd = lock_journal (this, LOCK_EX);
+
+	read_records (this);
+
+	oldest = time (NULL) - MAX_AGE_DAYS * 24 * 60 * 60;
+
+	keys = g_list_sort_with_data (
+		g_hash_table_get_keys (priv->entries), compare_last_use, priv->entries);
+
+	data = g_byte_array_new ();
+	g_byte_array_append (data, (const guint8 *) JOURNAL_MAGIC, JOURNAL_MAGIC_LENGTH);
+
+	for (node = keys; node; node = node->next) {
+		entry = g_hash_table_lookup (priv->entries, node->data);
+
+		if (n_records < MAX_ENTRIES && entry->stamp >= oldest) {
+			append_record (data, node->data, MIN (entry->count, G_MAXUINT16), entry->stamp);
+			n_records++;
+		}
+		else
+			g_hash_table_remove (priv->entries, node->data);
+	}
+
+	g_list_free (keys);
+
+	if (g_file_set_contents (priv->path, (const gchar *) data->data, data->len, NULL) && ! stat (priv->path, & info)) {
+		priv->dev       = info.st_dev;
+		priv->ino       = info.st_ino;
+		priv->offset    = data->len;
+		priv->n_records = n_records;
+		priv->missing   = FALSE;
+		priv->damaged   = FALSE;
+	}
+
+	unlock_journal (lock_fd);
+
+	g_byte_array_free (data, TRUE);
+
+	drop_store (this);
+}
+
+static gboolean
+compact_cb (gpointer data)
+{
+	PRIVATE (data)->compact_id = 0;
+
+	compact (USAGE_JOURNAL (data));
+
+	/* the records other menus appended meanwhile came in with it */
+	g_signal_emit (data, usage_journal_signals [CHANGED], 0);
+
+	return FALSE;
+}
+
+static void
+append_record (GByteArray *data, const gchar *key, guint count, time_t stamp)
+{
+	guint16 key_length;
+	guint16 uses;
+	guint32 last_use;
+
+
+	key_length = GUINT16_TO_LE (strlen (key));
+	uses       = GUINT16_TO_LE (count);
+	last_use   = GUINT32_TO_LE (stamp);
+
+	g_byte_array_append (data, (const guint8 *) & key_length, 2);
+	g_byte_array_append (data, (const guint8 *) & uses,       2);
+	g_byte_array_append (data, (const guint8 *) & last_use,   4);
+	g_byte_array_append (data, (const guint8 *) key, strlen (key));
+}
+
+static void
+drop_store (UsageJournal *this)
+{
+	UsageJournalPrivate *priv = PRIVATE (this);
+
+	if (priv->store) {
+		g_bookmark_file_free (priv->store);
+		priv->store = NULL;
+	}
+}
+
+/* most recently used first */
+static gint
+compare_last_use (gconstpointer a, gconstpointer b, gpointer entries)
+{
+	UsageEntry *entry_a = g_hash_table_lookup (entries, a);
+	UsageEntry *entry_b = g_hash_table_lookup (entries, b);
+
+
+	if (entry_a->stamp == entry_b->stamp)
+		return 0;
+
+	return entry_a->stamp > entry_b->stamp ? -1 : 1;
+}
+
+static gboolean
+flush_cb (gpointer data)
+{
+	PRIVATE (data)->flush_id = 0;
+
+	write_pending (USAGE_JOURNAL (data));
+
+	g_signal_emit (data, usage_journal_signals [CHANGED], 0);
+
+	return FALSE;
+}
+
+static void
+write_pending (UsageJournal *this)
+{
+	UsageJournalPrivate *priv = PRIVATE (this);
+
+	gchar *dir;
+	gint   fd;
+	gint   lock_fd;
+
+
+	dir = g_path_get_dirname (priv->path);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+
+	lock_fd = lock_journal (this, LOCK_SH);
+
+	fd = open (priv->path, O_WRONLY | O_APPEND | O_CLOEXEC);
+
+	if (fd < 0 && errno == ENOENT)
+		fd = create_journal (this, lock_fd);
+
+	if (fd >= 0) {
+		if (write (fd, priv->pending->data, priv->pending->len) != (gssize) priv->pending->len)
+			g_warning ("could not write to %s", priv->path);
+
+		close (fd);
+	}
+
+	unlock_journal (lock_fd);
+
+	g_byte_array_set_size (priv->pending, 0);
+}
+
+/* Creates the journal with just the magic and opens it for appending.  Two
+ * menus may both find it missing, so lock_fd, the shared lock, is traded for
+ * the exclusive one first: no record can land ahead of the magic, and only
+ * the first menu writes it.
+ */
+static gint
+create_journal (UsageJournal *this, gint lock_fd)
+{
+	UsageJournalPrivate *priv = PRIVATE (this);
+
+	gint fd;
+
+
+	if (lock_fd >= 0)
+		while (flock (lock_fd, LOCK_EX) && errno == EINTR)
+			;
+
+	fd = open (priv->path, O_WRONLY | O_APPEND | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+
+	if (fd >= 0) {
+		if (write (fd, JOURNAL_MAGIC, JOURNAL_MAGIC_LENGTH) != JOURNAL_MAGIC_LENGTH)
+			g_warning ("could not write to %s", priv->path);
+	}
+	else if (errno == EEXIST)
+		fd = open (priv->path, O_WRONLY | O_APPEND | O_CLOEXEC);
+
+	return fd;
+}
+
+static void
+journal_changed_cb (GFileMonitor *monitor, GFile *file, GFile *other_file,
+                    GFileMonitorEvent event_type, gpointer user_data)
+{
+	if (
+		event_type == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT ||
+		event_type == G_FILE_MONITOR_EVENT_CREATED ||
+		event_type == G_FILE_MONITOR_EVENT_DELETED
+	)
+		g_signal_emit (user_data, usage_journal_signals [CHANGED], 0);
+}
+
+/* applications were installed, removed or changed */
+static void
+index_changed_cb (AppIndex *index, gpointer user_data)
+{
+	UsageJournalPrivate *priv = PRIVATE (user_data);
+
+	g_hash_table_remove_all (priv->uris);
+
+	drop_store (USAGE_JOURNAL (user_data));
+
+	g_signal_emit (user_data, usage_journal_signals [CHANGED], 0);
+}
@@ -0,0 +1,56 @@
+/*
+ * This file is part of the Main Menu.
+ *
+ * Copyright (c) 2006, 2007 Novell, Inc.
+ *
+ * The Main Menu is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * The Main Menu is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the Main Menu; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef __USAGE_JOURNAL_H__
+#define __USAGE_JOURNAL_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define USAGE_JOURNAL_TYPE         (usage_journal_get_type ())
+#define USAGE_JOURNAL(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), USAGE_JOURNAL_TYPE, UsageJournal))
+#define USAGE_JOURNAL_CLASS(c)     (G_TYPE_CHECK_CLASS_CAST ((c), USAGE_JOURNAL_TYPE, UsageJournalClass))
+#define IS_USAGE_JOURNAL(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), USAGE_JOURNAL_TYPE))
+#define IS_USAGE_JOURNAL_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE ((c), USAGE_JOURNAL_TYPE))
+#define USAGE_JOURNAL_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), USAGE_JOURNAL_TYPE, UsageJournalClass))
+
+typedef struct {
+	GObject g_object;
+} UsageJournal;
+
+typedef struct {
+	GObjectClass g_object_class;
+
+	void (* changed) (UsageJournal *);
+} UsageJournalClass;
+
+GType usage_journal_get_type (void);
+
+UsageJournal  *usage_journal_get_instance (void);
+void           usage_journal_record       (UsageJournal *this, const gchar *desktop_entry);
+GBookmarkFile *usage_journal_get_store    (UsageJournal *this);
+gboolean       usage_journal_needs_import (UsageJournal *this);
+void           usage_journal_import       (UsageJournal *this, GBookmarkFile *store);
+
+G_END_DECLS
+
+#endif